@@ -0,0 +1,401 @@
+#ifdef NEO_BENCH
+
+/*
+ * Headless benchmark harness: drives EditorProcessKeypress/EditorRefreshScreen
+ * against an in-memory terminal. Build and run with
+ *
+ *     cc -O2 -DNEO_BENCH *.c -o neo-bench
+ *     ./neo-bench [--lines N] [--size ROWSxCOLUMNS] [type|paste|search|scroll|clipboard|cursors|save ...]
+ *     ./neo-bench --replay SESSION [--realtime] FILE
+ *
+ * Sessions are recorded with `neo --record SESSION FILE`; replay edits a copy of FILE.
+ */
+
+#include "editor.h"
+#include "record.h"
+#include "syntax.h"
+
+typedef struct
+{
+    char*             input;
+    size_t            inputSize;
+    size_t            inputCapacity;
+    size_t            inputPosition;
+    size_t*           keyStarts;
+    size_t            numberofKeys;
+    size_t            nextKey;
+    uint64_t          keyStartTime;
+    size_t            bytesWritten;
+    LatencySamples    latency;
+
+} BenchTerminal;
+
+static ssize_t benchRead(void* context, char* data, size_t size)
+{
+    BenchTerminal* terminal = context;
+    if (terminal->inputPosition >= terminal->inputSize)
+    {
+        // a script that runs out inside a prompt cancels it instead of waiting for keys that never come
+        *data = '\x1b';
+        return 1;
+    }
+
+    if (terminal->nextKey < terminal->numberofKeys && terminal->inputPosition == terminal->keyStarts[terminal->nextKey])
+    {
+        uint64_t now = MonotonicNanoseconds();
+        if (terminal->nextKey > 0)
+            LatencySamplesAdd(&terminal->latency, now - terminal->keyStartTime);
+        terminal->keyStartTime = now;
+        terminal->nextKey++;
+    }
+
+    size_t end = (terminal->nextKey < terminal->numberofKeys) ? terminal->keyStarts[terminal->nextKey] : terminal->inputSize;
+    if (size > end - terminal->inputPosition)
+        size = end - terminal->inputPosition;
+
+    memcpy(data, &terminal->input[terminal->inputPosition], size);
+    terminal->inputPosition += size;
+    return size;
+}
+
+static ssize_t benchWrite(void* context, const char* data, size_t size)
+{
+    BenchTerminal* terminal = context;
+    (void)data;
+    terminal->bytesWritten += size;
+    return size;
+}
+
+static void benchAddKey(BenchTerminal* terminal, const char* key, size_t size)
+{
+    if (terminal->inputSize + size > terminal->inputCapacity)
+    {
+        terminal->inputCapacity = (terminal->inputSize + size) * 2;
+        terminal->input = realloc(terminal->input, terminal->inputCapacity);
+        terminal->keyStarts = realloc(terminal->keyStarts, sizeof(size_t) * terminal->inputCapacity);
+        if (terminal->input == NULL || terminal->keyStarts == NULL)
+            die("realloc");
+    }
+
+    terminal->keyStarts[terminal->numberofKeys] = terminal->inputSize;
+    terminal->numberofKeys++;
+    memcpy(&terminal->input[terminal->inputSize], key, size);
+    terminal->inputSize += size;
+}
+
+static void benchAddString(BenchTerminal* terminal, const char* string)
+{
+    for (size_t i = 0; string[i] != '\0'; i++)
+        benchAddKey(terminal, &string[i], 1);
+}
+
+static void benchAddRepeated(BenchTerminal* terminal, const char* key, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        benchAddKey(terminal, key, strlen(key));
+}
+
+/******* workloads ********/
+
+static void generateFile(const char* path, size_t lines)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+        die("fopen");
+
+    for (size_t i = 0; i < lines; i++)
+    {
+        switch (i % 12)
+        {
+            case 0:  fprintf(file, "/* function %zu: block comment\n", i); break;
+            case 1:  fprintf(file, " * spanning several lines with ünïcödé and 日本語\n"); break;
+            case 2:  fprintf(file, " */\n"); break;
+            case 3:  fprintf(file, "static int function%zu(int argument, char* text)\n", i); break;
+            case 4:  fprintf(file, "{\n"); break;
+            case 5:  fprintf(file, "\tsize_t count = %zu;\n", i * 7); break;
+            case 6:  fprintf(file, "\tprintf(\"value: %%d and text %%s\\n\", count, text);\n"); break;
+            case 7:  fprintf(file, "\tfor (int j = 0; j < argument; j++)\n"); break;
+            case 8:  fprintf(file, "\t\tcount += j * 3.5; // trailing comment\n"); break;
+            case 9:  fprintf(file, "\treturn (int)count;\n"); break;
+            case 10: fprintf(file, "}\n"); break;
+            default: fprintf(file, "\n"); break;
+        }
+    }
+
+    fprintf(file, "int needle = 1;\n");
+    fclose(file);
+}
+
+static void buildScenario(BenchTerminal* terminal, const char* scenario)
+{
+    if (!strcmp(scenario, "type"))
+    {
+        for (int i = 0; i < 2000; i++)
+        {
+            if (i % 60 == 59)
+                benchAddKey(terminal, "\r", 1);
+            else if (i % 17 == 16)
+                benchAddKey(terminal, "\x7f", 1);
+            else
+                benchAddKey(terminal, &"abcdefghijklmnopqrstuvwxyz (){};"[i % 32], 1);
+        }
+    }
+    else if (!strcmp(scenario, "paste"))
+    {
+        for (int i = 0; i < 300; i++)
+        {
+            benchAddString(terminal, "\tpasted_line(i, \"some text\", 42); // comment");
+            benchAddKey(terminal, "\r", 1);
+        }
+    }
+    else if (!strcmp(scenario, "search"))
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            benchAddKey(terminal, "\x06", 1);
+            benchAddString(terminal, (i % 2) ? "needle" : "function1");
+            benchAddRepeated(terminal, "\x1b[B", 3);
+            benchAddKey(terminal, "\r", 1);
+        }
+    }
+    else if (!strcmp(scenario, "scroll"))
+    {
+        benchAddRepeated(terminal, "\x1b[6~", 300);
+        benchAddRepeated(terminal, "\x1b[5~", 300);
+        benchAddRepeated(terminal, "\x1b[B", 500);
+        benchAddRepeated(terminal, "\x1b[C", 200);
+    }
+    else if (!strcmp(scenario, "clipboard"))
+    {
+        benchAddKey(terminal, "\x01", 1);
+        benchAddKey(terminal, "\x03", 1);
+        benchAddRepeated(terminal, "\x1b[6~", 3);
+        for (int i = 0; i < 5; i++)
+        {
+            benchAddKey(terminal, "\x16", 1);
+            benchAddKey(terminal, "x", 1);
+        }
+    }
+    else if (!strcmp(scenario, "cursors"))
+    {
+        benchAddKey(terminal, "\x01", 1);
+        benchAddKey(terminal, "\x04", 1);
+        benchAddString(terminal, "cursor");
+        benchAddRepeated(terminal, "\x1b[D", 3);
+        benchAddRepeated(terminal, "\x7f", 3);
+        benchAddKey(terminal, "\x1b", 1);
+    }
+    else if (!strcmp(scenario, "save"))
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            benchAddKey(terminal, "x", 1);
+            benchAddKey(terminal, "\x13", 1);
+        }
+    }
+}
+
+static void runScenario(const char* scenario, const char* path, short unsigned int rows, short unsigned int columns)
+{
+    BenchTerminal terminal = { 0 };
+    buildScenario(&terminal, scenario);
+    if (terminal.numberofKeys == 0)
+    {
+        fprintf(stderr, "unknown scenario: %s\n", scenario);
+        return;
+    }
+
+    TerminalBackend backend = { benchRead, benchWrite, &terminal };
+    TerminalSetBackend(&backend);
+
+    EditorConfiguration config;
+    EditorInitHeadless(&config, rows, columns);
+
+    uint64_t openStart = MonotonicNanoseconds();
+    EditorOpenFile(&config, path, HLDB);
+    EditorWaitForLoad(&config);
+    config.cursorY = config.textBuffer.numberofTextRows / 2;
+    EditorRefreshScreen(&config);
+    uint64_t openTime = MonotonicNanoseconds() - openStart;
+
+    terminal.bytesWritten = 0;
+    while (terminal.inputPosition < terminal.inputSize)
+    {
+        EditorProcessKeypress(&config, HLDB);
+        EditorRefreshScreen(&config);
+    }
+    LatencySamplesAdd(&terminal.latency, MonotonicNanoseconds() - terminal.keyStartTime);
+
+    printf("%-8s %7zu %9.1f %9.1f %9.1f %9.1f %10.1f %10.1f %12zu %9.0f\n",
+           scenario, terminal.latency.count,
+           openTime / 1e6,
+           LatencySamplesPercentile(&terminal.latency, 50) / 1e3,
+           LatencySamplesPercentile(&terminal.latency, 90) / 1e3,
+           LatencySamplesPercentile(&terminal.latency, 99) / 1e3,
+           LatencySamplesPercentile(&terminal.latency, 100) / 1e3,
+           LatencySamplesTotal(&terminal.latency) / 1e6,
+           terminal.bytesWritten, (double)terminal.bytesWritten / terminal.latency.count);
+
+    TerminalSetBackend(NULL);
+    EditorFree(&config);
+    LatencySamplesFree(&terminal.latency);
+    free(terminal.input);
+    free(terminal.keyStarts);
+}
+
+/******* recorded sessions ********/
+
+static int copyFile(const char* source, char* path)
+{
+    const char* extension = strrchr(source, '.');
+    if (extension == NULL || strchr(extension, '/') != NULL)
+        extension = "";
+
+    snprintf(path, PATH_MAX, "/tmp/neo-replay-XXXXXX%s", extension);
+    int output = mkstemps(path, strlen(extension));
+    if (output == -1)
+        return -1;
+
+    int input = open(source, O_RDONLY);
+    if (input == -1)
+    {
+        close(output);
+        unlink(path);
+        return -1;
+    }
+
+    char buffer[65536];
+    ssize_t readSize;
+    while ((readSize = read(input, buffer, sizeof(buffer))) > 0)
+        if (write(output, buffer, readSize) != readSize)
+            readSize = -1;
+
+    close(input);
+    close(output);
+    return (readSize == -1) ? -1 : 0;
+}
+
+static int runReplay(const char* sessionPath, const char* filename, bool isRealTime)
+{
+    KeyReplay replay = KEY_REPLAY_INIT;
+    if (ReplayLoad(&replay, sessionPath) == -1)
+    {
+        fprintf(stderr, "cannot load session: %s\n", sessionPath);
+        return 1;
+    }
+
+    char path[PATH_MAX];
+    if (copyFile(filename, path) == -1)
+    {
+        fprintf(stderr, "cannot copy %s\n", filename);
+        ReplayFree(&replay);
+        return 1;
+    }
+
+    replay.isRealTime = isRealTime;
+    TerminalBackend backend = ReplayBackend(&replay);
+    TerminalSetBackend(&backend);
+
+    EditorConfiguration config;
+    EditorInitHeadless(&config, replay.screenRows, replay.screenColumns);
+    EditorOpenFile(&config, path, HLDB);
+    EditorWaitForLoad(&config);
+
+    LatencySamples frames = LATENCY_SAMPLES_INIT;
+    uint64_t replayStart = MonotonicNanoseconds();
+    EditorRefreshScreen(&config);
+
+    while (!ReplayIsFinished(&replay))
+    {
+        uint64_t frameStart = MonotonicNanoseconds();
+        uint64_t slept = replay.sleptTime;
+
+        EditorProcessKeypress(&config, HLDB);
+        EditorRefreshScreen(&config);
+
+        LatencySamplesAdd(&frames, MonotonicNanoseconds() - frameStart - (replay.sleptTime - slept));
+    }
+
+    uint64_t replayTime = MonotonicNanoseconds() - replayStart;
+    TerminalSetBackend(NULL);
+
+    printf("session  %s (%hux%hu, %s)\n", sessionPath, replay.screenRows, replay.screenColumns, isRealTime ? "real time" : "fast");
+    printf("frames   %zu in %.1f ms wall, %.1f ms busy\n", frames.count, replayTime / 1e6, LatencySamplesTotal(&frames) / 1e6);
+    printf("latency  p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+           LatencySamplesPercentile(&frames, 50) / 1e3, LatencySamplesPercentile(&frames, 90) / 1e3,
+           LatencySamplesPercentile(&frames, 99) / 1e3, LatencySamplesPercentile(&frames, 100) / 1e3);
+    printf("output   %zu bytes\n", replay.bytesWritten);
+    printf("buffer   %zu rows, hash %016llx\n", config.textBuffer.numberofTextRows, (unsigned long long)TextBufferHash(&config.textBuffer));
+    LatencySamplesPrintHistogram(&frames, stdout);
+
+    EditorFree(&config);
+    LatencySamplesFree(&frames);
+    ReplayFree(&replay);
+    unlink(path);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    size_t lines = 100000;
+    short unsigned int rows = 50, columns = 160;
+    const char* scenarios[16];
+    int numberofScenarios = 0;
+    const char* sessionPath = NULL;
+    bool isRealTime = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+            sessionPath = argv[++i];
+        else if (!strcmp(argv[i], "--realtime"))
+            isRealTime = true;
+        else if (!strcmp(argv[i], "--lines") && i + 1 < argc)
+            lines = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc)
+            sscanf(argv[++i], "%hux%hu", &rows, &columns);
+        else if (numberofScenarios < 16)
+            scenarios[numberofScenarios++] = argv[i];
+    }
+
+    if (sessionPath != NULL)
+    {
+        if (numberofScenarios != 1)
+        {
+            fprintf(stderr, "usage: %s --replay SESSION [--realtime] FILE\n", argv[0]);
+            return 1;
+        }
+
+        return runReplay(sessionPath, scenarios[0], isRealTime);
+    }
+
+    if (numberofScenarios == 0)
+    {
+        const char* defaults[] = { "type", "paste", "search", "scroll", "clipboard", "save" };
+        for (int i = 0; i < 6; i++)
+            scenarios[numberofScenarios++] = defaults[i];
+    }
+
+    char path[] = "/tmp/neo-bench-XXXXXX.c";
+    int file = mkstemps(path, 2);
+    if (file == -1)
+        die("mkstemps");
+    close(file);
+
+    generateFile(path, lines);
+
+    printf("%zu lines, %hux%hu terminal\n", lines, rows, columns);
+    printf("%-8s %7s %9s %9s %9s %9s %10s %10s %12s %9s\n",
+           "scenario", "keys", "open ms", "p50 us", "p90 us", "p99 us", "max us", "total ms", "bytes out", "bytes/key");
+
+    for (int i = 0; i < numberofScenarios; i++)
+    {
+        generateFile(path, lines);
+        runScenario(scenarios[i], path, rows, columns);
+    }
+
+    unlink(path);
+    return 0;
+}
+
+#endif // NEO_BENCH
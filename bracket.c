@@ -0,0 +1,498 @@
+#include "bracket.h"
+
+/******* treap over the bracket summary of each row ********/
+
+// rows are the in-order sequence of the nodes, so rows are inserted and deleted by splitting and merging in O(log n)
+
+static BracketSummary bracketCombine(BracketSummary left, BracketSummary right)
+{
+    BracketSummary result;
+    result.closes = left.closes + ((right.closes > left.opens) ? right.closes - left.opens : 0);
+    result.opens = right.opens + ((left.opens > right.closes) ? left.opens - right.closes : 0);
+    return result;
+}
+
+static uint32_t bracketRandom(BracketIndex* brackets)
+{
+    uint32_t x = brackets->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    brackets->seed = x;
+    return x;
+}
+
+// the empty node at index 0 has size zero and empty summaries, so it combines as nothing
+static void bracketPull(BracketIndex* brackets, size_t node)
+{
+    BracketNode* nodes = brackets->nodes;
+    BracketNode* current = &nodes[node];
+
+    current->size = nodes[current->left].size + 1 + nodes[current->right].size;
+    for (int kind = 0; kind < TEXT_BRACKET_KINDS; kind++)
+    {
+        BracketSummary own = { current->opens[kind], current->closes[kind] };
+        current->total[kind] = bracketCombine(bracketCombine(nodes[current->left].total[kind], own), nodes[current->right].total[kind]);
+    }
+}
+
+static void bracketReserve(BracketIndex* brackets, size_t count)
+{
+    if (brackets->numberofNodes + count <= brackets->capacity)
+        return;
+
+    size_t capacity = (brackets->capacity > 0) ? brackets->capacity : 1024;
+    while (capacity < brackets->numberofNodes + count)
+        capacity *= 2;
+
+    BracketNode* temp = realloc(brackets->nodes, sizeof(BracketNode) * capacity);
+    if (temp == NULL)
+        die("realloc");
+
+    brackets->nodes = temp;
+    brackets->capacity = capacity;
+}
+
+static bool bracketSetRow(BracketNode* node, TextRow* row)
+{
+    if (!memcmp(node->opens, row->bracketOpens, sizeof(node->opens)) && !memcmp(node->closes, row->bracketCloses, sizeof(node->closes)))
+        return false;
+
+    memcpy(node->opens, row->bracketOpens, sizeof(node->opens));
+    memcpy(node->closes, row->bracketCloses, sizeof(node->closes));
+    return true;
+}
+
+static size_t bracketNewNode(BracketIndex* brackets, TextRow* row)
+{
+    size_t node = brackets->freeNode;
+    if (node != BRACKET_NODE_NONE)
+        brackets->freeNode = brackets->nodes[node].left;
+    else
+    {
+        bracketReserve(brackets, 1);
+        node = brackets->numberofNodes++;
+    }
+
+    BracketNode* current = &brackets->nodes[node];
+    memset(current->opens, 0, sizeof(current->opens));
+    memset(current->closes, 0, sizeof(current->closes));
+    bracketSetRow(current, row);
+    current->left = BRACKET_NODE_NONE;
+    current->right = BRACKET_NODE_NONE;
+    current->priority = bracketRandom(brackets);
+    bracketPull(brackets, node);
+    return node;
+}
+
+static void bracketRelease(BracketIndex* brackets, size_t node)
+{
+    if (node == BRACKET_NODE_NONE)
+        return;
+
+    bracketRelease(brackets, brackets->nodes[node].left);
+    bracketRelease(brackets, brackets->nodes[node].right);
+    brackets->nodes[node].left = brackets->freeNode;
+    brackets->freeNode = node;
+}
+
+// the first count rows under node go left, the rest right
+static void bracketSplit(BracketIndex* brackets, size_t node, size_t count, size_t* left, size_t* right)
+{
+    if (node == BRACKET_NODE_NONE)
+    {
+        *left = BRACKET_NODE_NONE;
+        *right = BRACKET_NODE_NONE;
+        return;
+    }
+
+    size_t leftSize = brackets->nodes[brackets->nodes[node].left].size;
+    if (count <= leftSize)
+    {
+        size_t rest;
+        bracketSplit(brackets, brackets->nodes[node].left, count, left, &rest);
+        brackets->nodes[node].left = rest;
+        *right = node;
+    }
+    else
+    {
+        size_t rest;
+        bracketSplit(brackets, brackets->nodes[node].right, count - leftSize - 1, &rest, right);
+        brackets->nodes[node].right = rest;
+        *left = node;
+    }
+
+    bracketPull(brackets, node);
+}
+
+static size_t bracketMerge(BracketIndex* brackets, size_t left, size_t right)
+{
+    if (left == BRACKET_NODE_NONE)
+        return right;
+    if (right == BRACKET_NODE_NONE)
+        return left;
+
+    if (brackets->nodes[left].priority > brackets->nodes[right].priority)
+    {
+        size_t merged = bracketMerge(brackets, brackets->nodes[left].right, right);
+        brackets->nodes[left].right = merged;
+        bracketPull(brackets, left);
+        return left;
+    }
+
+    size_t merged = bracketMerge(brackets, left, brackets->nodes[right].left);
+    brackets->nodes[right].left = merged;
+    bracketPull(brackets, right);
+    return right;
+}
+
+// builds the treap of count rows in one pass, a node's subtree is final once it leaves the right spine
+static size_t bracketBuild(BracketIndex* brackets, TextBuffer* tbuf, size_t first, size_t count)
+{
+    if (count == 0)
+        return BRACKET_NODE_NONE;
+
+    bracketReserve(brackets, count);
+    size_t spineCapacity = 64;
+    size_t* spine = malloc(sizeof(size_t) * spineCapacity);
+    if (spine == NULL)
+        die("malloc");
+
+    size_t depth = 0, root = BRACKET_NODE_NONE;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (depth == spineCapacity)
+        {
+            spineCapacity *= 2;
+            size_t* temp = realloc(spine, sizeof(size_t) * spineCapacity);
+            if (temp == NULL)
+                die("realloc");
+            spine = temp;
+        }
+
+        size_t node = bracketNewNode(brackets, &tbuf->textRow[first + i]);
+        size_t last = BRACKET_NODE_NONE;
+
+        while (depth > 0 && brackets->nodes[spine[depth - 1]].priority < brackets->nodes[node].priority)
+        {
+            last = spine[--depth];
+            bracketPull(brackets, last);
+        }
+
+        brackets->nodes[node].left = last;
+        if (depth > 0)
+            brackets->nodes[spine[depth - 1]].right = node;
+        else
+            root = node;
+        spine[depth++] = node;
+    }
+
+    while (depth > 0)
+        bracketPull(brackets, spine[--depth]);
+
+    free(spine);
+    return root;
+}
+
+// refreshes rows start to end under node from tbuf in one walk, only paths above a changed row are recombined
+static bool bracketUpdate(BracketIndex* brackets, TextBuffer* tbuf, size_t node, size_t offset, size_t start, size_t end)
+{
+    if (node == BRACKET_NODE_NONE || offset >= end || offset + brackets->nodes[node].size <= start)
+        return false;
+
+    size_t index = offset + brackets->nodes[brackets->nodes[node].left].size;
+    bool isChanged = bracketUpdate(brackets, tbuf, brackets->nodes[node].left, offset, start, end);
+
+    if (index >= start && index < end)
+        isChanged |= bracketSetRow(&brackets->nodes[node], &tbuf->textRow[index]);
+
+    isChanged |= bracketUpdate(brackets, tbuf, brackets->nodes[node].right, index + 1, start, end);
+
+    if (isChanged)
+        bracketPull(brackets, node);
+
+    return isChanged;
+}
+
+void    BracketIndexFree(BracketIndex* brackets)
+{
+    free(brackets->nodes);
+    brackets->nodes = NULL;
+    brackets->numberofNodes = 0;
+    brackets->capacity = 0;
+    brackets->freeNode = BRACKET_NODE_NONE;
+    brackets->root = BRACKET_NODE_NONE;
+    brackets->numberofRows = 0;
+    brackets->isStale = true;
+}
+
+void    BracketIndexInvalidate(BracketIndex* brackets)
+{
+    brackets->isStale = true;
+}
+
+void    BracketIndexSync(BracketIndex* brackets, TextBuffer* tbuf)
+{
+    if (!brackets->isStale && brackets->numberofRows == tbuf->numberofTextRows)
+        return;
+
+    // node 0 stays the empty node
+    brackets->numberofNodes = 0;
+    brackets->freeNode = BRACKET_NODE_NONE;
+    bracketReserve(brackets, tbuf->numberofTextRows + 1);
+    memset(&brackets->nodes[0], 0, sizeof(BracketNode));
+    brackets->numberofNodes = 1;
+
+    brackets->root = bracketBuild(brackets, tbuf, 0, tbuf->numberofTextRows);
+    brackets->numberofRows = tbuf->numberofTextRows;
+    brackets->isStale = false;
+}
+
+void    BracketIndexUpdateRow(BracketIndex* brackets, TextBuffer* tbuf, size_t index)
+{
+    if (brackets->isStale || index >= brackets->numberofRows || index >= tbuf->numberofTextRows)
+        return;
+
+    bracketUpdate(brackets, tbuf, brackets->root, 0, index, index + 1);
+}
+
+// rows index to index + count are new in tbuf
+void    BracketIndexInsertRows(BracketIndex* brackets, TextBuffer* tbuf, size_t index, size_t count)
+{
+    if (brackets->isStale || index > brackets->numberofRows || brackets->numberofRows + count != tbuf->numberofTextRows)
+    {
+        brackets->isStale = true;
+        return;
+    }
+
+    size_t inserted = bracketBuild(brackets, tbuf, index, count);
+    size_t left, right;
+    bracketSplit(brackets, brackets->root, index, &left, &right);
+    brackets->root = bracketMerge(brackets, bracketMerge(brackets, left, inserted), right);
+    brackets->numberofRows += count;
+}
+
+void    BracketIndexDeleteRows(BracketIndex* brackets, size_t index, size_t count)
+{
+    if (brackets->isStale || index + count > brackets->numberofRows)
+    {
+        brackets->isStale = true;
+        return;
+    }
+
+    size_t left, middle, right;
+    bracketSplit(brackets, brackets->root, index, &left, &middle);
+    bracketSplit(brackets, middle, count, &middle, &right);
+    bracketRelease(brackets, middle);
+    brackets->root = bracketMerge(brackets, left, right);
+    brackets->numberofRows -= count;
+}
+
+// summaries are only trusted before the syntax state frontier; rows it passes are refreshed here
+void    BracketIndexEnsureRows(BracketIndex* brackets, TextBuffer* tbuf, size_t start, size_t end)
+{
+    size_t frontier = tbuf->stateFrontier;
+    TextBufferEnsureSyntax(tbuf, start, end);
+
+    if (!brackets->isStale && frontier < tbuf->stateFrontier && tbuf->stateFrontier <= brackets->numberofRows)
+        bracketUpdate(brackets, tbuf, brackets->root, 0, frontier, tbuf->stateFrontier);
+}
+
+/******* searching ********/
+
+// only brackets of the given kind move the depth, so "(]" is not a pair
+static size_t bracketScanForward(TextRow* row, size_t from, int kind, size_t* depth)
+{
+    for (size_t i = from; i < row->renderSize; i++)
+    {
+        int bracketKind;
+        int direction = TextRowBracketDirection(row, i, &bracketKind);
+        if (direction == 0 || bracketKind != kind)
+            continue;
+
+        if (direction > 0)
+            (*depth)++;
+        else if (--(*depth) == 0)
+            return i;
+    }
+
+    return SIZE_MAX;
+}
+
+static size_t bracketScanBackward(TextRow* row, size_t before, int kind, size_t* depth)
+{
+    if (before > row->renderSize)
+        before = row->renderSize;
+
+    for (size_t i = before; i > 0; i--)
+    {
+        int bracketKind;
+        int direction = TextRowBracketDirection(row, i - 1, &bracketKind);
+        if (direction == 0 || bracketKind != kind)
+            continue;
+
+        if (direction < 0)
+            (*depth)++;
+        else if (--(*depth) == 0)
+            return i - 1;
+    }
+
+    return SIZE_MAX;
+}
+
+// first row at or after 'from' holding the closer that brings depth to zero, offset is the first row under node
+static size_t bracketSearchForward(BracketIndex* brackets, size_t node, size_t offset, size_t from, int kind, size_t* depth)
+{
+    if (node == BRACKET_NODE_NONE)
+        return SIZE_MAX;
+
+    BracketNode* current = &brackets->nodes[node];
+    if (offset + current->size <= from)
+        return SIZE_MAX;
+
+    if (offset >= from && current->total[kind].closes < *depth)
+    {
+        *depth = *depth - current->total[kind].closes + current->total[kind].opens;
+        return SIZE_MAX;
+    }
+
+    size_t row = bracketSearchForward(brackets, current->left, offset, from, kind, depth);
+    if (row != SIZE_MAX)
+        return row;
+
+    size_t index = offset + brackets->nodes[current->left].size;
+    if (index >= from)
+    {
+        if (current->closes[kind] >= *depth)
+            return index;
+        *depth = *depth - current->closes[kind] + current->opens[kind];
+    }
+
+    return bracketSearchForward(brackets, current->right, index + 1, from, kind, depth);
+}
+
+// last row before 'before' holding the opener that brings depth to zero
+static size_t bracketSearchBackward(BracketIndex* brackets, size_t node, size_t offset, size_t before, int kind, size_t* depth)
+{
+    if (node == BRACKET_NODE_NONE)
+        return SIZE_MAX;
+
+    BracketNode* current = &brackets->nodes[node];
+    if (offset >= before)
+        return SIZE_MAX;
+
+    if (offset + current->size <= before && current->total[kind].opens < *depth)
+    {
+        *depth = *depth - current->total[kind].opens + current->total[kind].closes;
+        return SIZE_MAX;
+    }
+
+    size_t index = offset + brackets->nodes[current->left].size;
+    size_t row = bracketSearchBackward(brackets, current->right, index + 1, before, kind, depth);
+    if (row != SIZE_MAX)
+        return row;
+
+    if (index < before)
+    {
+        if (current->opens[kind] >= *depth)
+            return index;
+        *depth = *depth - current->opens[kind] + current->closes[kind];
+    }
+
+    return bracketSearchBackward(brackets, current->left, offset, before, kind, depth);
+}
+
+static bool bracketFindOpener(BracketIndex* brackets, TextBuffer* tbuf, size_t renderX, size_t y, int kind, size_t* openX, size_t* openY)
+{
+    size_t depth = 1;
+    size_t x = bracketScanBackward(&tbuf->textRow[y], renderX, kind, &depth);
+    if (x == SIZE_MAX)
+    {
+        BracketIndexSync(brackets, tbuf);
+        y = bracketSearchBackward(brackets, brackets->root, 0, y, kind, &depth);
+        if (y == SIZE_MAX)
+            return false;
+
+        BracketIndexEnsureRows(brackets, tbuf, y, y + 1);
+        x = bracketScanBackward(&tbuf->textRow[y], SIZE_MAX, kind, &depth);
+    }
+
+    *openX = x;
+    *openY = y;
+    return x != SIZE_MAX;
+}
+
+bool    BracketIndexFindMatch(BracketIndex* brackets, TextBuffer* tbuf, size_t renderX, size_t y, size_t* matchX, size_t* matchY)
+{
+    if (y >= tbuf->numberofTextRows)
+        return false;
+
+    BracketIndexEnsureRows(brackets, tbuf, y, y + 1);
+
+    int kind;
+    int direction = TextRowBracketDirection(&tbuf->textRow[y], renderX, &kind);
+    if (direction < 0)
+        return bracketFindOpener(brackets, tbuf, renderX, y, kind, matchX, matchY);
+    if (direction == 0)
+        return false;
+
+    size_t depth = 1;
+    size_t x = bracketScanForward(&tbuf->textRow[y], renderX + 1, kind, &depth);
+    if (x == SIZE_MAX)
+    {
+        BracketIndexSync(brackets, tbuf);
+
+        // an answer past the frontier may rest on stale rows, so widen the frontier and search again
+        size_t from = y + 1;
+        size_t step = BRACKET_FRONTIER_STEP;
+        size_t remaining;
+        while (true)
+        {
+            remaining = depth;
+            y = bracketSearchForward(brackets, brackets->root, 0, from, kind, &remaining);
+            if ((y != SIZE_MAX && y < tbuf->stateFrontier) || tbuf->stateFrontier >= tbuf->numberofTextRows)
+                break;
+
+            size_t end = tbuf->stateFrontier + step;
+            BracketIndexEnsureRows(brackets, tbuf, end, end);
+            step *= 2;
+        }
+
+        if (y == SIZE_MAX)
+            return false;
+
+        depth = remaining;
+        BracketIndexEnsureRows(brackets, tbuf, y, y + 1);
+        x = bracketScanForward(&tbuf->textRow[y], 0, kind, &depth);
+    }
+
+    *matchX = x;
+    *matchY = y;
+    return x != SIZE_MAX;
+}
+
+// the closest unmatched opener of any kind before the cursor
+bool    BracketIndexFindEnclosing(BracketIndex* brackets, TextBuffer* tbuf, size_t renderX, size_t y, size_t* openX, size_t* openY)
+{
+    if (y >= tbuf->numberofTextRows)
+        return false;
+
+    BracketIndexEnsureRows(brackets, tbuf, y, y + 1);
+
+    bool isFound = false;
+    for (int kind = 0; kind < TEXT_BRACKET_KINDS; kind++)
+    {
+        size_t x, row;
+        if (!bracketFindOpener(brackets, tbuf, renderX, y, kind, &x, &row))
+            continue;
+
+        if (!isFound || row > *openY || (row == *openY && x > *openX))
+        {
+            *openX = x;
+            *openY = row;
+            isFound = true;
+        }
+    }
+
+    return isFound;
+}
@@ -0,0 +1,63 @@
+#ifndef BRACKET_H
+#define BRACKET_H
+
+#include "buffer.h"
+
+/******* bracket matching: balanced tree over the unmatched brackets of each row ********/
+
+#define BRACKET_FRONTIER_STEP    4096
+#define BRACKET_NODE_NONE        0
+
+typedef struct
+{
+    size_t    opens;
+    size_t    closes;
+
+} BracketSummary;
+
+typedef struct
+{
+    BracketSummary    total[TEXT_BRACKET_KINDS];
+    unsigned int      opens[TEXT_BRACKET_KINDS];
+    unsigned int      closes[TEXT_BRACKET_KINDS];
+    size_t            left;
+    size_t            right;
+    size_t            size;
+    uint32_t          priority;
+
+} BracketNode;
+
+typedef struct
+{
+    BracketNode*    nodes;
+    size_t          numberofNodes;
+    size_t          capacity;
+    size_t          freeNode;
+    size_t          root;
+    size_t          numberofRows;
+    uint32_t        seed;
+    bool            isStale;
+
+} BracketIndex;
+
+#define BRACKET_INDEX_INIT { NULL, 0, 0, BRACKET_NODE_NONE, BRACKET_NODE_NONE, 0, 2463534242u, true }
+
+void    BracketIndexFree(BracketIndex* brackets);
+
+void    BracketIndexInvalidate(BracketIndex* brackets);
+
+void    BracketIndexSync(BracketIndex* brackets, TextBuffer* tbuf);
+
+void    BracketIndexUpdateRow(BracketIndex* brackets, TextBuffer* tbuf, size_t index);
+
+void    BracketIndexInsertRows(BracketIndex* brackets, TextBuffer* tbuf, size_t index, size_t count);
+
+void    BracketIndexDeleteRows(BracketIndex* brackets, size_t index, size_t count);
+
+void    BracketIndexEnsureRows(BracketIndex* brackets, TextBuffer* tbuf, size_t start, size_t end);
+
+bool    BracketIndexFindMatch(BracketIndex* brackets, TextBuffer* tbuf, size_t renderX, size_t y, size_t* matchX, size_t* matchY);
+
+bool    BracketIndexFindEnclosing(BracketIndex* brackets, TextBuffer* tbuf, size_t renderX, size_t y, size_t* openX, size_t* openY);
+
+#endif // BRACKET_H
@@ -8,6 +8,7 @@ void ScreenBufferAppend(ScreenBuffer* sbuf, const char* string, size_t size)
     if (temp == NULL)
         die("realloc");
 
+    profile.allocations++;
     memcpy(&temp[sbuf->size], string, size);
 
     sbuf->string = temp;
@@ -55,6 +56,10 @@ char* getSyntaxColor(int highlight)
             return "38:5:21";
             break;
 
+        case HIGHLIGHT_PREPROCESSOR:
+            return "38:5:135";
+            break;
+
         case HIGHLIGHT_MATCH:
             return "38:5:51";
             break;
@@ -67,6 +72,74 @@ char* getSyntaxColor(int highlight)
 
 /******* text row operations ********/
 
+static size_t TextPositionGet(TextPosition* position, int key)
+{
+    switch (key)
+    {
+        case POSITION_TEXT:
+            return position->text;
+
+        case POSITION_RENDER:
+            return position->render;
+
+        default:
+            return position->column;
+    }
+}
+
+static int characterWidth(size_t length, unsigned int codepoint)
+{
+    if (length == 1)
+        return 1;
+
+    return Utf8CharWidth(codepoint);
+}
+
+static void TextRowStep(TextRow* row, TextPosition* position)
+{
+    if (row->text[position->text] == '\t')
+    {
+        size_t spaces = TAB_STOP - position->column % TAB_STOP;
+        position->text++;
+        position->render += spaces;
+        position->column += spaces;
+        return;
+    }
+
+    unsigned int codepoint;
+    size_t length = Utf8Decode(&row->text[position->text], row->textSize - position->text, &codepoint);
+
+    position->column += characterWidth(length, codepoint);
+    position->text += length;
+    position->render += length;
+}
+
+static bool TextRowStepBack(TextRow* row, TextPosition* position)
+{
+    if (position->text == 0)
+        return false;
+
+    size_t start = position->text - 1;
+    while (start > 0 && position->text - start < 4 && Utf8IsContinuation(row->text[start]))
+        start--;
+
+    unsigned int codepoint;
+    size_t length = Utf8Decode(&row->text[start], row->textSize - start, &codepoint);
+    if (start + length != position->text)
+    {
+        start = position->text - 1;
+        length = 1;
+    }
+
+    if (row->text[start] == '\t')
+        return false;
+
+    position->column -= characterWidth(length, codepoint);
+    position->text -= length;
+    position->render -= length;
+    return true;
+}
+
 void    TextRowUpdateRender(TextRow* row)
 {
     unsigned int tabs = 0;
@@ -83,175 +156,500 @@ void    TextRowUpdateRender(TextRow* row)
     else
         die("malloc");
 
-    size_t index = 0;
-    for (size_t j = 0; j < row->textSize; j++)
+    profile.allocations++;
+
+    free(row->checkpoints);
+    row->checkpoints = NULL;
+    row->numberofCheckpoints = 0;
+
+    if (row->textSize >= TEXT_CHECKPOINT_STRIDE)
     {
-        if (row->text[j] == '\t')
-        {
-            row->render[index] = ' ';
-            index++;
-            while (index % TAB_STOP != 0)
-            {
-                row->render[index] = ' ';
-                index++;
-            }
-        }
+        row->checkpoints = malloc(sizeof(TextPosition) * (row->textSize / TEXT_CHECKPOINT_STRIDE));
+        if (row->checkpoints == NULL)
+            die("malloc");
+
+        profile.allocations++;
+    }
+
+    TextPosition position = { 0, 0, 0 };
+    while (position.text < row->textSize)
+    {
+        size_t index = position.text;
+        size_t renderIndex = position.render;
+        TextRowStep(row, &position);
+
+        if (row->text[index] == '\t')
+            memset(&row->render[renderIndex], ' ', position.render - renderIndex);
         else
+            memcpy(&row->render[renderIndex], &row->text[index], position.text - index);
+
+        if (position.text >= (row->numberofCheckpoints + 1) * TEXT_CHECKPOINT_STRIDE && position.text < row->textSize)
         {
-            row->render[index] = row->text[j];
-            index++;
+            row->checkpoints[row->numberofCheckpoints] = position;
+            row->numberofCheckpoints++;
         }
     }
 
-    row->render[index] = '\0';
-    row->renderSize = index;
+    row->render[position.render] = '\0';
+    row->renderSize = position.render;
+    row->renderWidth = position.column;
+    row->position = (TextPosition){ 0, 0, 0 };
+    row->isScanned = false;
 }
 
-void    TextRowUpdateSyntax(TextRow* row, Syntax* syn)
+// a row whose cache was dropped is rendered again the first time it is looked at, its text and comment state did not change
+void    TextRowEnsureRender(TextRow* row)
 {
-    row->highlight = realloc(row->highlight, row->renderSize);
-    memset(row->highlight, HIGHLIGHT_NORMAL, row->renderSize);
-
-    if (syn == NULL)
+    if (row->render != NULL)
         return;
 
-    char** keywords = syn->keywords;
-    char** types = syn->types;
+    bool isScanned = row->isScanned;
+    TextRowUpdateRender(row);
+    row->isScanned = isScanned;
+}
 
-    size_t commentLength = syn->singleLineCommentStarter ? strlen(syn->singleLineCommentStarter) : 0;
+// () is kind 0, [] kind 1 and {} kind 2; openers face +1 and closers -1
+static int textBracketKind(char character, int* direction)
+{
+    switch (character)
+    {
+        case '(':
+        case ')':
+            *direction = (character == '(') ? 1 : -1;
+            return 0;
 
-    size_t mcslen = syn->multilineCommentStart ? strlen(syn->multilineCommentStart) : 0;
-    size_t mcelen = syn->multilineCommentEnd ? strlen(syn->multilineCommentEnd) : 0;
+        case '[':
+        case ']':
+            *direction = (character == '[') ? 1 : -1;
+            return 1;
 
-    bool previousSeparator = true;
-    bool inString = false;
-    bool inComment = (row->index > 0 && (row - 1)->openComment);
+        case '{':
+        case '}':
+            *direction = (character == '{') ? 1 : -1;
+            return 2;
+
+        default:
+            return -1;
+    }
+}
+
+// each kind keeps its own depth, so a closer only cancels an opener of the same kind
+static void textRowCountBracket(TextRow* row, int kind, int direction)
+{
+    if (direction > 0)
+        row->bracketOpens[kind]++;
+    else if (row->bracketOpens[kind] > 0)
+        row->bracketOpens[kind]--;
+    else
+        row->bracketCloses[kind]++;
+}
+
+static void textRowUpdateBrackets(TextRow* row)
+{
+    memset(row->bracketOpens, 0, sizeof(row->bracketOpens));
+    memset(row->bracketCloses, 0, sizeof(row->bracketCloses));
 
     for (size_t i = 0; i < row->renderSize; i++)
     {
-        char currentChar = row->render[i];
-        unsigned char previousHighlight = (i > 0) ? row->highlight[i - 1] : HIGHLIGHT_NORMAL;
+        int kind;
+        int direction = TextRowBracketDirection(row, i, &kind);
+        if (direction != 0)
+            textRowCountBracket(row, kind, direction);
+    }
+}
+
+size_t  TextRowFindHighlight(TextRow* row, size_t renderX)
+{
+    // first span that ends after renderX
+    size_t low = 0, high = row->numberofHighlights;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (row->highlights[middle].start + row->highlights[middle].length <= renderX)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+HighlightClass TextRowGetHighlight(TextRow* row, size_t renderX)
+{
+    size_t span = TextRowFindHighlight(row, renderX);
+    if (span < row->numberofHighlights && row->highlights[span].start <= renderX)
+        return row->highlights[span].type;
+
+    return HIGHLIGHT_NORMAL;
+}
 
-        if (commentLength && !inString && !inComment)
+int     TextRowBracketDirection(TextRow* row, size_t renderX, int* kind)
+{
+    if (renderX >= row->renderSize)
+        return 0;
+
+    int direction;
+    int bracketKind = textBracketKind(row->render[renderX], &direction);
+    if (bracketKind == -1)
+        return 0;
+
+    if (kind != NULL)
+        *kind = bracketKind;
+
+    HighlightClass highlight = TextRowGetHighlight(row, renderX);
+    if (highlight == HIGHLIGHT_STRING || highlight == HIGHLIGHT_CHARACTER || highlight == HIGHLIGHT_COMMENT)
+        return 0;
+
+    return direction;
+}
+
+static size_t textScanQuoted(const char* text, size_t size, size_t index)
+{
+    char quote = text[index];
+    for (index++; index < size; index++)
+    {
+        if (text[index] == '\\' && index + 1 < size)
+            index++;
+        else if (text[index] == quote)
+            return index + 1;
+    }
+
+    return size;
+}
+
+// the first row has no row before it and keeps the state it was given, which only a window into a file sets
+static bool textRowIncomingComment(TextRow* row)
+{
+    return (row->index > 0) ? (row - 1)->openComment : row->incomingComment;
+}
+
+// same comment and string rules as TextRowUpdateSyntax, without building highlight spans; brackets are counted when a row is given
+static bool textScanState(Syntax* syn, const char* text, size_t size, bool inComment, TextRow* row)
+{
+    if (syn != NULL && syn->lexer == NULL)
+        LexerCompile(syn);
+
+    SyntaxLexer* lexer = (syn != NULL) ? syn->lexer : NULL;
+
+    size_t i = 0;
+    while (i < size)
+    {
+        if (inComment)
         {
-            if (!strncmp(&row->render[i], syn->singleLineCommentStarter, commentLength))
-            {
-                memset(&row->highlight[i], HIGHLIGHT_COMMENT, row->renderSize - i);
-                break;
-            }
+            const char* end = memmem(&text[i], size - i, syn->multilineCommentEnd, lexer->multilineEndLength);
+            inComment = (end == NULL);
+            i = (end != NULL) ? (size_t)(end - text) + lexer->multilineEndLength : size;
+            continue;
         }
 
-        if (mcslen && mcelen && !inString)
+        unsigned char character = text[i];
+        if (lexer != NULL && (lexer->charFlags[character] & LEXER_CHAR_SPECIAL))
         {
-            if (inComment)
+            if (lexer->commentLength && size - i >= lexer->commentLength && !strncmp(&text[i], syn->singleLineCommentStarter, lexer->commentLength))
+                break;
+
+            if (lexer->multilineStartLength && lexer->multilineEndLength && size - i >= lexer->multilineStartLength &&
+                !strncmp(&text[i], syn->multilineCommentStart, lexer->multilineStartLength))
             {
-                row->highlight[i] = HIGHLIGHT_COMMENT;
-                if (!strncmp(&row->render[i], syn->multilineCommentEnd, mcelen))
-                {
-                    memset(&row->highlight[i], HIGHLIGHT_COMMENT, mcelen);
-                    i += mcelen - 1;
-                    inComment = false;
-                    previousSeparator = true;
-                    continue;
-                }
-                else
-                    continue;
+                i += lexer->multilineStartLength;
+                inComment = true;
+                continue;
             }
-            else if (!strncmp(&row->render[i], syn->multilineCommentStart, mcslen))
+
+            if ((character == '"' && (lexer->flag & HIGHLIGHT_STRING)) || (character == '\'' && (lexer->flag & HIGHLIGHT_CHARACTER)))
             {
-                memset(&row->highlight[i], HIGHLIGHT_COMMENT, mcslen);
-                i += mcslen - 1;
-                inComment = true;
+                i = textScanQuoted(text, size, i);
                 continue;
             }
         }
 
-        if (syn->flag & HIGHLIGHT_STRING)
+        int direction, kind;
+        if (row != NULL && (kind = textBracketKind(character, &direction)) != -1)
+            textRowCountBracket(row, kind, direction);
+
+        i++;
+    }
+
+    return inComment;
+}
+
+static void textRowUpdateState(TextRow* row, Syntax* syn)
+{
+    bool inComment = (syn != NULL && textRowIncomingComment(row));
+    row->incomingComment = inComment;
+    row->isHighlighted = false;
+    row->isScanned = true;
+    memset(row->bracketOpens, 0, sizeof(row->bracketOpens));
+    memset(row->bracketCloses, 0, sizeof(row->bracketCloses));
+
+    // tabs only widen the render, so the text gives the same state without rendering the row
+    row->openComment = textScanState(syn, row->text, row->textSize, inComment, row);
+}
+
+bool    TextScanCommentState(Syntax* syn, const char* text, size_t size, bool inComment)
+{
+    return textScanState(syn, text, size, inComment, NULL);
+}
+
+static void textRowAddHighlight(TextRow* row, size_t start, size_t length, HighlightClass type)
+{
+    while (length > 0)
+    {
+        HighlightSpan* last = (row->numberofHighlights > 0) ? &row->highlights[row->numberofHighlights - 1] : NULL;
+        if (last != NULL && last->type == type && last->start + last->length == start && last->length < UINT16_MAX)
+        {
+            size_t extra = (length < (size_t)(UINT16_MAX - last->length)) ? length : (size_t)(UINT16_MAX - last->length);
+            last->length += extra;
+            start += extra;
+            length -= extra;
+            continue;
+        }
+
+        if (row->numberofHighlights == row->highlightCapacity)
         {
-            if (inString)
+            row->highlightCapacity = (row->highlightCapacity > 0) ? row->highlightCapacity * 2 : 2;
+            HighlightSpan* temp = realloc(row->highlights, sizeof(HighlightSpan) * row->highlightCapacity);
+            if (temp == NULL)
+                die("realloc");
+
+            row->highlights = temp;
+            profile.allocations++;
+        }
+
+        row->highlights[row->numberofHighlights++] = (HighlightSpan){ start, 0, type };
+    }
+}
+
+bool    TextRowUpdateSyntax(TextRow* row, Syntax* syn)
+{
+    row->numberofHighlights = 0;
+    row->isHighlighted = true;
+    row->isScanned = true;
+
+    if (syn == NULL)
+    {
+        free(row->highlights);
+        row->highlights = NULL;
+        row->highlightCapacity = 0;
+
+        bool isChanged = row->openComment;
+        row->incomingComment = false;
+        row->openComment = false;
+        textRowUpdateBrackets(row);
+        return isChanged;
+    }
+
+    uint64_t profileStart = ProfileStart();
+    profile.rowsHighlighted++;
+
+    if (syn->lexer == NULL)
+        LexerCompile(syn);
+
+    SyntaxLexer* lexer = syn->lexer;
+    const char* render = row->render;
+    size_t size = row->renderSize;
+
+    size_t firstCharacter = 0;
+    while (firstCharacter < size && isspace((unsigned char)render[firstCharacter]))
+        firstCharacter++;
+
+    bool previousSeparator = true;
+    bool inComment = textRowIncomingComment(row);
+    row->incomingComment = inComment;
+
+    size_t i = 0;
+    while (i < size)
+    {
+        if (inComment)
+        {
+            const char* end = memmem(&render[i], size - i, syn->multilineCommentEnd, lexer->multilineEndLength);
+            size_t stop = (end != NULL) ? (size_t)(end - render) + lexer->multilineEndLength : size;
+            textRowAddHighlight(row, i, stop - i, HIGHLIGHT_COMMENT);
+            inComment = (end == NULL);
+            previousSeparator = true;
+            i = stop;
+            continue;
+        }
+
+        unsigned char character = render[i];
+        unsigned char flags = lexer->charFlags[character];
+
+        if (flags & LEXER_CHAR_SPECIAL)
+        {
+            size_t stop = i;
+            HighlightClass type = HIGHLIGHT_NORMAL;
+
+            if (lexer->commentLength && !strncmp(&render[i], syn->singleLineCommentStarter, lexer->commentLength))
             {
-                row->highlight[i] = HIGHLIGHT_STRING;
-                previousSeparator = true;
-                if (currentChar == '"')
-                    inString = false;
+                textRowAddHighlight(row, i, size - i, HIGHLIGHT_COMMENT);
+                break;
+            }
+            else if (lexer->multilineStartLength && lexer->multilineEndLength &&
+                     !strncmp(&render[i], syn->multilineCommentStart, lexer->multilineStartLength))
+            {
+                textRowAddHighlight(row, i, lexer->multilineStartLength, HIGHLIGHT_COMMENT);
+                i += lexer->multilineStartLength;
+                inComment = true;
                 continue;
             }
-            else
+            else if (character == '"' && (lexer->flag & HIGHLIGHT_STRING))
             {
-                if (currentChar == '"')
-                {
-                    inString = true;
-                    row->highlight[i] = HIGHLIGHT_STRING;
-                    continue;
-                }
+                stop = textScanQuoted(row->render, row->renderSize, i);
+                type = HIGHLIGHT_STRING;
             }
-        }
-
-        if (syn->flag & HIGHLIGHT_NUMBER)
-        {
-            if (isdigit(currentChar) && (previousSeparator || previousHighlight == HIGHLIGHT_NUMBER) || (currentChar == '.' && previousHighlight == HIGHLIGHT_NUMBER))
+            else if (character == '\'' && (lexer->flag & HIGHLIGHT_CHARACTER))
             {
-                row->highlight[i] = HIGHLIGHT_NUMBER;
-                previousSeparator = false;
-                continue;
+                stop = textScanQuoted(row->render, row->renderSize, i);
+                type = HIGHLIGHT_CHARACTER;
             }
-        }
-
-        if (previousSeparator)
-        {
-            int j;
-            for (j = 0; keywords[j] != NULL; j++)
+            else if (character == '#' && i == firstCharacter && (lexer->flag & HIGHLIGHT_PREPROCESSOR))
             {
-                int keywordLength = strlen(keywords[j]);
-
-                if (!strncmp(&row->render[i], keywords[j], keywordLength) && isSeparator(row->render[i + keywordLength]))
-                {
-                    memset(&row->highlight[i], HIGHLIGHT_KEYWORD, keywordLength);
-                    i += keywordLength - 1;
-                    break;
-                }
+                for (stop = i + 1; stop < size && render[stop] == ' '; stop++);
+                for (; stop < size && (lexer->charFlags[(unsigned char)render[stop]] & LEXER_CHAR_WORD); stop++);
+                type = HIGHLIGHT_PREPROCESSOR;
             }
 
-            if (keywords[j] != NULL)
+            if (type != HIGHLIGHT_NORMAL)
             {
-                previousSeparator = false;
+                textRowAddHighlight(row, i, stop - i, type);
+                previousSeparator = true;
+                i = stop;
                 continue;
             }
+        }
 
-            int k;
-            for (k = 0; types[k] != NULL; k++)
+        if ((flags & LEXER_CHAR_DIGIT) && previousSeparator && (lexer->flag & HIGHLIGHT_NUMBER))
+        {
+            size_t stop = i + 1;
+            while (stop < size && ((lexer->charFlags[(unsigned char)render[stop]] & LEXER_CHAR_WORD) || render[stop] == '.'))
+                stop++;
+
+            textRowAddHighlight(row, i, stop - i, HIGHLIGHT_NUMBER);
+            previousSeparator = false;
+            i = stop;
+            continue;
+        }
+
+        if (previousSeparator)
+        {
+            // longest keyword or type in the trie that ends right before a separator
+            uint32_t state = 0;
+            size_t length = 0;
+            HighlightClass type = HIGHLIGHT_NORMAL;
+
+            for (size_t j = i; j < size; j++)
             {
-                int typesLength = strlen(types[k]);
+                state = lexer->transitions[state * lexer->numberofClasses + lexer->wordClass[(unsigned char)render[j]]];
+                if (state == 0)
+                    break;
 
-                if (!strncmp(&row->render[i], types[k], typesLength) && isSeparator(row->render[i + typesLength]))
+                if (lexer->accept[state] != HIGHLIGHT_NORMAL && (j + 1 == size || (lexer->charFlags[(unsigned char)render[j + 1]] & LEXER_CHAR_SEPARATOR)))
                 {
-                    memset(&row->highlight[i], HIGHLIGHT_TYPE, typesLength);
-                    i += typesLength - 1;
-                    break;
+                    length = j + 1 - i;
+                    type = lexer->accept[state];
                 }
             }
 
-            if (types[k] != NULL)
+            if (length > 0)
             {
+                textRowAddHighlight(row, i, length, type);
                 previousSeparator = false;
+                i += length;
                 continue;
             }
         }
 
-        previousSeparator = isSeparator(currentChar);
+        previousSeparator = (flags & LEXER_CHAR_SEPARATOR) != 0;
+        i++;
     }
 
+    textRowUpdateBrackets(row);
+
     bool isChanged = (row->openComment != inComment);
     row->openComment = inComment;
-    if (isChanged && ((row + 1) != NULL) && (row + 1)->index == row->index + 1)
-        TextRowUpdateSyntax(row + 1, syn);
+    ProfileStop(PROFILE_SYNTAX, profileStart);
+    return isChanged;
 }
 
 void    TextRowFree(TextRow* row)
 {
+    free(row->checkpoints);
     free(row->render);
-    free(row->text);
-    free(row->highlight);
+    free(row->highlights);
+
+    TextSpan span = { row->text, row->textSize, row->textShares };
+    if (span.shares != NULL)
+        TextSpanRelease(&span);
+    else
+        free(row->text);
+}
+
+/******* shared row text ********/
+
+// every edit to a row's text passes through here, so the row stops matching its place in the file
+void    TextRowMakeWritable(TextRow* row)
+{
+    row->origin = -1;
+
+    if (row->textShares == NULL)
+        return;
+
+    if (*row->textShares > 1)
+    {
+        char* text = malloc(row->textSize + 1);
+        if (text == NULL)
+            die("malloc");
+
+        memcpy(text, row->text, row->textSize);
+        text[row->textSize] = '\0';
+        (*row->textShares)--;
+        row->text = text;
+        profile.allocations++;
+    }
+    else
+        free(row->textShares);
+
+    row->textShares = NULL;
+}
+
+TextSpan TextRowShare(TextRow* row)
+{
+    if (row->textShares == NULL)
+    {
+        row->textShares = malloc(sizeof(unsigned int));
+        if (row->textShares == NULL)
+            die("malloc");
+
+        *row->textShares = 1;
+    }
+
+    (*row->textShares)++;
+    return (TextSpan){ row->text, row->textSize, row->textShares };
+}
+
+TextSpan TextSpanCopy(const char* text, size_t size)
+{
+    TextSpan span = { malloc(size + 1), size, malloc(sizeof(unsigned int)) };
+    if (span.text == NULL || span.shares == NULL)
+        die("malloc");
+
+    memcpy(span.text, text, size);
+    span.text[size] = '\0';
+    *span.shares = 1;
+    return span;
+}
+
+void    TextSpanRelease(TextSpan* span)
+{
+    if (span->shares != NULL && --(*span->shares) == 0)
+    {
+        free(span->text);
+        free(span->shares);
+    }
+
+    span->text = NULL;
+    span->shares = NULL;
+    span->size = 0;
 }
 
 void    TextRowInsertChar(TextRow* row, size_t index, short int input, Syntax* syn)
@@ -259,12 +657,14 @@ void    TextRowInsertChar(TextRow* row, size_t index, short int input, Syntax* s
     if (index > row->textSize)
         index = row->textSize;
 
+    TextRowMakeWritable(row);
     char* temp = realloc(row->text, row->textSize + 2);
     if (temp != NULL)
         row->text = temp;
     else
         die("realloc");
 
+    profile.allocations++;
     memmove(&row->text[index + 1], &row->text[index], row->textSize - index + 1);
 
     row->textSize++;
@@ -275,12 +675,14 @@ void    TextRowInsertChar(TextRow* row, size_t index, short int input, Syntax* s
 
 void    TextRowAppendString(TextRow* row, char* str, size_t size, Syntax* syn)
 {
+    TextRowMakeWritable(row);
     char* temp = realloc(row->text, row->textSize + size + 1);
     if (temp != NULL)
         row->text = temp;
     else
         die("realloc");
 
+    profile.allocations++;
     memcpy(&row->text[row->textSize], str, size);
 
     row->textSize += size;
@@ -290,43 +692,153 @@ void    TextRowAppendString(TextRow* row, char* str, size_t size, Syntax* syn)
 }
 
 void    TextRowDeleteChar(TextRow* row, size_t index, Syntax* syn)
+{
+    TextRowDeleteRange(row, index, 1, syn);
+}
+
+void    TextRowDeleteRange(TextRow* row, size_t index, size_t size, Syntax* syn)
 {
     if (index >= row->textSize)
         return;
 
-    memmove(&row->text[index], &row->text[index + 1], row->textSize - index);
+    if (size > row->textSize - index)
+        size = row->textSize - index;
+
+    TextRowMakeWritable(row);
+    memmove(&row->text[index], &row->text[index + size], row->textSize - index - size + 1);
 
-    row->textSize--;
+    row->textSize -= size;
     TextRowUpdateRender(row);
     TextRowUpdateSyntax(row, syn);
 }
 
-size_t  TextRowGetRenderX(TextRow* row, size_t cursorX)
+void    TextRowReplaceRanges(TextRow* row, TextRange* ranges, size_t count, const char* insert, size_t insertSize, Syntax* syn)
 {
-    size_t rx = 0;
-    for (size_t i = 0; i < cursorX; i++)
+    // ranges are sorted and disjoint, the row is rebuilt and re-highlighted once for all of them
+    size_t newSize = row->textSize;
+    for (size_t i = 0; i < count; i++)
+        newSize += insertSize - (ranges[i].end - ranges[i].start);
+
+    char* text = malloc(newSize + 1);
+    if (text == NULL)
+        die("malloc");
+
+    profile.allocations++;
+
+    size_t source = 0, destination = 0;
+    for (size_t i = 0; i < count; i++)
     {
-        if (row->text[i] == '\t')
-            rx += (TAB_STOP - 1) - (rx % TAB_STOP);
-        rx++;
+        memcpy(&text[destination], &row->text[source], ranges[i].start - source);
+        destination += ranges[i].start - source;
+        memcpy(&text[destination], insert, insertSize);
+        destination += insertSize;
+        source = ranges[i].end;
+    }
+
+    memcpy(&text[destination], &row->text[source], row->textSize - source);
+    text[newSize] = '\0';
+
+    TextSpan span = { row->text, row->textSize, row->textShares };
+    if (span.shares != NULL)
+        TextSpanRelease(&span);
+    else
+        free(row->text);
+
+    row->text = text;
+    row->textSize = newSize;
+    row->textShares = NULL;
+    row->origin = -1;
+    TextRowUpdateRender(row);
+    TextRowUpdateSyntax(row, syn);
+}
+
+static TextPosition TextRowFindCheckpoint(TextRow* row, int key, size_t value)
+{
+    size_t low = 0, high = row->numberofCheckpoints;
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (TextPositionGet(&row->checkpoints[middle], key) <= value)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return (low == 0) ? (TextPosition){ 0, 0, 0 } : row->checkpoints[low - 1];
+}
+
+TextPosition TextRowSeek(TextRow* row, int key, size_t value)
+{
+    TextPosition position = row->position;
+    size_t current = TextPositionGet(&position, key);
+
+    if (current > value + TEXT_CHECKPOINT_STRIDE || current + TEXT_CHECKPOINT_STRIDE < value)
+        position = TextRowFindCheckpoint(row, key, value);
+
+    while (TextPositionGet(&position, key) > value)
+    {
+        if (!TextRowStepBack(row, &position))
+        {
+            position = TextRowFindCheckpoint(row, key, value);
+            break;
+        }
+    }
+
+    while (position.text < row->textSize)
+    {
+        TextPosition next = position;
+        TextRowStep(row, &next);
+        if (TextPositionGet(&next, key) > value)
+            break;
+        position = next;
     }
 
-    return rx;
+    row->position = position;
+    return position;
+}
+
+size_t  TextRowGetRenderX(TextRow* row, size_t cursorX)
+{
+    return TextRowSeek(row, POSITION_TEXT, cursorX).column;
 }
 
 size_t  TextRowGetCursorX(TextRow* row, size_t renderX)
 {
-    size_t cx, rx = 0;
+    return TextRowSeek(row, POSITION_COLUMN, renderX).text;
+}
 
-    for (cx = 0; cx < row->textSize; cx++)
+size_t  TextRowNextChar(TextRow* row, size_t index)
+{
+    if (index >= row->textSize)
+        return row->textSize;
+
+    unsigned int codepoint;
+    index += Utf8Decode(&row->text[index], row->textSize - index, &codepoint);
+
+    while (index < row->textSize)
     {
-        if (row->text[cx] == '\t')
-            rx += (TAB_STOP - 1) - (rx % TAB_STOP);
-        rx++;
+        size_t length = Utf8Decode(&row->text[index], row->textSize - index, &codepoint);
+        if (length == 1 || Utf8CharWidth(codepoint) != 0)
+            break;
+        index += length;
+    }
 
-        if (rx > renderX)
-            return cx;
+    return index;
+}
+
+size_t  TextRowPreviousChar(TextRow* row, size_t index)
+{
+    while (index > 0)
+    {
+        index = TextRowSeek(row, POSITION_TEXT, index - 1).text;
+
+        unsigned int codepoint;
+        size_t length = Utf8Decode(&row->text[index], row->textSize - index, &codepoint);
+        if (length == 1 || Utf8CharWidth(codepoint) != 0)
+            break;
     }
+
+    return index;
 }
 
 /******* text buffer operations ********/
@@ -348,20 +860,31 @@ void    TextBufferInsertTextRow(TextBuffer* tbuf, size_t index, const char* str,
         tbuf->textRow[j].index++;
 
     tbuf->textRow[index].index = index;
+    tbuf->textRow[index].origin = -1;
 
     tbuf->textRow[index].textSize = size;
+    tbuf->textRow[index].textShares = NULL;
     tbuf->textRow[index].text = malloc(size + 1);
+    profile.allocations += 2;
     memcpy(tbuf->textRow[index].text, str, size);
     tbuf->textRow[index].text[size] = '\0';
 
     tbuf->textRow[index].renderSize = 0;
+    tbuf->textRow[index].renderWidth = 0;
     tbuf->textRow[index].render = NULL;
-    tbuf->textRow[index].highlight = NULL;
+    tbuf->textRow[index].checkpoints = NULL;
+    tbuf->textRow[index].numberofCheckpoints = 0;
+    tbuf->textRow[index].highlights = NULL;
+    tbuf->textRow[index].numberofHighlights = 0;
+    tbuf->textRow[index].highlightCapacity = 0;
+    tbuf->textRow[index].isHighlighted = false;
+    tbuf->textRow[index].isScanned = false;
+    tbuf->textRow[index].incomingComment = false;
     tbuf->textRow[index].openComment = false;
     TextRowUpdateRender(&tbuf->textRow[index]);
-    TextRowUpdateSyntax(&tbuf->textRow[index], tbuf->syntax);
 
     tbuf->numberofTextRows++;
+    TextBufferUpdateSyntax(tbuf, index);
 }
 
 void    TextBufferDeleteTextRow(TextBuffer* tbuf, size_t index)
@@ -377,6 +900,205 @@ void    TextBufferDeleteTextRow(TextBuffer* tbuf, size_t index)
         tbuf->textRow[j].index--;
 
     tbuf->numberofTextRows--;
+    if (index == 0 && tbuf->numberofTextRows > 0)
+        tbuf->textRow[0].incomingComment = false;
+
+    TextBufferUpdateSyntax(tbuf, index);
+}
+
+void    TextBufferInsertSpans(TextBuffer* tbuf, size_t index, TextSpan* spans, size_t count)
+{
+    if (index > tbuf->numberofTextRows || count == 0)
+        return;
+
+    TextRow* temp = realloc(tbuf->textRow, sizeof(TextRow) * (tbuf->numberofTextRows + count));
+    if (temp == NULL)
+        die("realloc");
+
+    tbuf->textRow = temp;
+    memmove(&tbuf->textRow[index + count], &tbuf->textRow[index], sizeof(TextRow) * (tbuf->numberofTextRows - index));
+
+    for (size_t j = index + count; j < tbuf->numberofTextRows + count; j++)
+        tbuf->textRow[j].index += count;
+
+    for (size_t j = 0; j < count; j++)
+    {
+        TextRow* row = &tbuf->textRow[index + j];
+        (*spans[j].shares)++;
+
+        *row = (TextRow){ 0 };
+        row->text = spans[j].text;
+        row->textSize = spans[j].size;
+        row->textShares = spans[j].shares;
+        row->index = index + j;
+        row->origin = -1;
+    }
+
+    // pasted rows are rendered like dropped ones, the first time something looks at them
+    tbuf->numberofTextRows += count;
+    tbuf->isCacheDropped = true;
+    TextBufferUpdateSyntax(tbuf, index);
+}
+
+void    TextBufferDeleteTextRows(TextBuffer* tbuf, size_t index, size_t count)
+{
+    if (index >= tbuf->numberofTextRows)
+        return;
+
+    if (count > tbuf->numberofTextRows - index)
+        count = tbuf->numberofTextRows - index;
+
+    for (size_t j = index; j < index + count; j++)
+        TextRowFree(&tbuf->textRow[j]);
+
+    memmove(&tbuf->textRow[index], &tbuf->textRow[index + count], sizeof(TextRow) * (tbuf->numberofTextRows - index - count));
+
+    tbuf->numberofTextRows -= count;
+    for (size_t j = index; j < tbuf->numberofTextRows; j++)
+        tbuf->textRow[j].index -= count;
+
+    if (index == 0 && tbuf->numberofTextRows > 0)
+        tbuf->textRow[0].incomingComment = false;
+
+    TextBufferUpdateSyntax(tbuf, index);
+}
+
+void    TextBufferDeleteRange(TextBuffer* tbuf, size_t startX, size_t startY, size_t endX, size_t endY)
+{
+    if (startY >= tbuf->numberofTextRows)
+        return;
+
+    if (endY >= tbuf->numberofTextRows)
+    {
+        endY = tbuf->numberofTextRows - 1;
+        endX = tbuf->textRow[endY].textSize;
+    }
+
+    TextRow* first = &tbuf->textRow[startY];
+    if (startX > first->textSize)
+        startX = first->textSize;
+
+    if (startY == endY)
+    {
+        if (endX > startX)
+            TextRowDeleteRange(first, startX, endX - startX, tbuf->syntax);
+        TextBufferUpdateSyntax(tbuf, startY + 1);
+        return;
+    }
+
+    TextRow* last = &tbuf->textRow[endY];
+    if (endX > last->textSize)
+        endX = last->textSize;
+
+    TextRowMakeWritable(first);
+    first->textSize = startX;
+    first->text[startX] = '\0';
+    TextRowAppendString(first, &last->text[endX], last->textSize - endX, tbuf->syntax);
+
+    TextBufferDeleteTextRows(tbuf, startY + 1, endY - startY);
+}
+
+/******* lazy highlighting ********/
+
+// rows before stateFrontier have a known openComment; everything else is re-derived on demand
+// a scanned row keeps its openComment and bracket counts until its text or its incoming comment state changes
+
+void    TextBufferUpdateSyntax(TextBuffer* tbuf, size_t index)
+{
+    if (index < tbuf->numberofTextRows)
+    {
+        tbuf->textRow[index].isHighlighted = false;
+        tbuf->textRow[index].isScanned = false;
+    }
+
+    if (tbuf->stateFrontier > index)
+        tbuf->stateFrontier = index;
+}
+
+void    TextBufferResetSyntax(TextBuffer* tbuf)
+{
+    for (size_t i = 0; i < tbuf->numberofTextRows; i++)
+    {
+        tbuf->textRow[i].isHighlighted = false;
+        tbuf->textRow[i].isScanned = false;
+    }
+
+    tbuf->stateFrontier = 0;
+}
+
+void    TextBufferUpdateState(TextBuffer* tbuf, size_t end)
+{
+    if (end > tbuf->numberofTextRows)
+        end = tbuf->numberofTextRows;
+
+    for (; tbuf->stateFrontier < end; tbuf->stateFrontier++)
+    {
+        TextRow* row = &tbuf->textRow[tbuf->stateFrontier];
+        bool incoming = textRowIncomingComment(row);
+
+        if (!row->isScanned || row->incomingComment != incoming)
+            textRowUpdateState(row, tbuf->syntax);
+    }
+}
+
+void    TextBufferEnsureSyntax(TextBuffer* tbuf, size_t start, size_t end)
+{
+    if (end > tbuf->numberofTextRows)
+        end = tbuf->numberofTextRows;
+
+    TextBufferUpdateState(tbuf, start);
+
+    for (size_t i = start; i < end; i++)
+    {
+        TextRow* row = &tbuf->textRow[i];
+        bool incoming = textRowIncomingComment(row);
+        TextRowEnsureRender(row);
+
+        if (!row->isHighlighted || row->incomingComment != incoming)
+            TextRowUpdateSyntax(row, tbuf->syntax);
+
+        if (tbuf->stateFrontier == i)
+            tbuf->stateFrontier = i + 1;
+    }
+}
+
+void    TextBufferAppendData(TextBuffer* tbuf, const char* data, size_t size, bool* lineOpen)
+{
+    const char* start = data;
+    const char* end = data + size;
+
+    while (start < end)
+    {
+        const char* newline = memchr(start, '\n', end - start);
+        size_t length = (newline != NULL) ? (size_t)(newline - start) : (size_t)(end - start);
+
+        if (newline != NULL)
+        {
+            while (length > 0 && start[length - 1] == '\r')
+                length--;
+        }
+
+        if (*lineOpen && tbuf->numberofTextRows > 0)
+        {
+            TextRow* row = &tbuf->textRow[tbuf->numberofTextRows - 1];
+            if (length > 0)
+                TextRowAppendString(row, (char*)start, length, tbuf->syntax);
+
+            if (newline != NULL && row->textSize > 0 && row->text[row->textSize - 1] == '\r')
+            {
+                TextRowMakeWritable(row);
+                row->textSize--;
+                row->text[row->textSize] = '\0';
+                TextRowUpdateRender(row);
+                TextRowUpdateSyntax(row, tbuf->syntax);
+            }
+        }
+        else
+            TextBufferInsertTextRow(tbuf, tbuf->numberofTextRows, start, length);
+
+        *lineOpen = (newline == NULL);
+        start = (newline != NULL) ? newline + 1 : end;
+    }
 }
 
 char*   TextBufferToString(TextBuffer* tbuf, size_t* bufferSize)
@@ -390,14 +1112,98 @@ char*   TextBufferToString(TextBuffer* tbuf, size_t* bufferSize)
     if((buffer = malloc(totalSize)) == NULL)
         die("malloc");
 
+    char* end = buffer;
     for (size_t i = 0; i < tbuf->numberofTextRows; i++)
     {
-        memcpy(buffer, tbuf->textRow[i].text, tbuf->textRow[i].textSize);
+        memcpy(end, tbuf->textRow[i].text, tbuf->textRow[i].textSize);
 
-        buffer += tbuf->textRow[i].textSize;
-        *buffer = '\n';
-        buffer++;
+        end += tbuf->textRow[i].textSize;
+        *end = '\n';
+        end++;
     }
 
     return buffer;
 }
+
+// rows now sit in the file where TextBufferToString would put them
+void    TextBufferMarkSaved(TextBuffer* tbuf)
+{
+    off_t position = 0;
+    for (size_t i = 0; i < tbuf->numberofTextRows; i++)
+    {
+        tbuf->textRow[i].origin = position;
+        position += tbuf->textRow[i].textSize + 1;
+    }
+}
+
+void    TextBufferFree(TextBuffer* tbuf)
+{
+    for (size_t i = 0; i < tbuf->numberofTextRows; i++)
+        TextRowFree(&tbuf->textRow[i]);
+
+    free(tbuf->textRow);
+    tbuf->textRow = NULL;
+    tbuf->numberofTextRows = 0;
+    tbuf->stateFrontier = 0;
+    tbuf->isCacheDropped = false;
+}
+
+size_t  TextBufferCacheSize(TextBuffer* tbuf)
+{
+    size_t size = 0;
+    for (size_t i = 0; i < tbuf->numberofTextRows; i++)
+        size += tbuf->textRow[i].renderSize + sizeof(HighlightSpan) * tbuf->textRow[i].highlightCapacity +
+                sizeof(TextPosition) * tbuf->textRow[i].numberofCheckpoints;
+
+    return size;
+}
+
+void    TextBufferDropCache(TextBuffer* tbuf)
+{
+    // openComment is kept so rows can be re-highlighted independently later
+    for (size_t i = 0; i < tbuf->numberofTextRows; i++)
+    {
+        TextRow* row = &tbuf->textRow[i];
+        free(row->render);
+        free(row->highlights);
+        free(row->checkpoints);
+        row->render = NULL;
+        row->highlights = NULL;
+        row->numberofHighlights = 0;
+        row->highlightCapacity = 0;
+        row->isHighlighted = false;
+        row->checkpoints = NULL;
+        row->renderSize = 0;
+        row->numberofCheckpoints = 0;
+        row->position = (TextPosition){ 0, 0, 0 };
+    }
+
+    tbuf->isCacheDropped = true;
+}
+
+// rows in view are rendered again as they are drawn, this brings back the rest before something reads every row
+void    TextBufferRestoreCache(TextBuffer* tbuf)
+{
+    if (!tbuf->isCacheDropped)
+        return;
+
+    for (size_t i = 0; i < tbuf->numberofTextRows; i++)
+        TextRowEnsureRender(&tbuf->textRow[i]);
+
+    tbuf->isCacheDropped = false;
+}
+
+uint64_t    TextBufferHash(TextBuffer* tbuf)
+{
+    // 64-bit FNV-1a over the same bytes TextBufferToString produces
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < tbuf->numberofTextRows; i++)
+    {
+        for (size_t j = 0; j < tbuf->textRow[i].textSize; j++)
+            hash = (hash ^ (unsigned char)tbuf->textRow[i].text[j]) * 1099511628211ULL;
+
+        hash = (hash ^ '\n') * 1099511628211ULL;
+    }
+
+    return hash;
+}
@@ -3,6 +3,9 @@
 
 #include "dependencies.h"
 #include "terminal.h"
+#include "profile.h"
+#include "utf8.h"
+#include "lexer.h"
 
 /******* screen buffer structure to write to terminal from ********/
 
@@ -30,23 +33,38 @@ enum HighlightFlag
     HIGHLIGHT_CHARACTER       =    8,
     HIGHLIGHT_COMMENT         =    16,
     HIGHLIGHT_KEYWORD         =    32,
-    HIGHLIGHT_SELECTION       =    64,
+    HIGHLIGHT_PREPROCESSOR    =    64,
     HIGHLIGHT_TYPE            =    128,
-    HIGHLIGHT_PREPROCESSOR    =    256,
+    HIGHLIGHT_SELECTION       =    256,
     HIGHLIGHT_SEPARATOR       =    512,
     HIGHLIGHT_ALL             =    1024
 };
 
+typedef unsigned short HighlightClass;
+
+// a run of render bytes sharing one highlight class, rows store only the non-normal runs
+// and longer runs are split so a span stays eight bytes
 typedef struct
 {
-    char*    fileType;
-    char**   fileMatch;
-    char**   keywords;
-    char**   types;
-    char*    singleLineCommentStarter;
-    char*    multilineCommentStart;
-    char*    multilineCommentEnd;
-    int      flag;
+    uint32_t          start;
+    uint16_t          length;
+    HighlightClass    type;
+
+} HighlightSpan;
+
+#define HIGHLIGHT_SPAN_NONE { 0, 0, HIGHLIGHT_NORMAL }
+
+typedef struct
+{
+    char*          fileType;
+    char**         fileMatch;
+    char**         keywords;
+    char**         types;
+    char*          singleLineCommentStarter;
+    char*          multilineCommentStart;
+    char*          multilineCommentEnd;
+    int            flag;
+    SyntaxLexer*   lexer;
 
 } Syntax;
 
@@ -54,36 +72,114 @@ char*   getSyntaxColor(int highlight);
 
 bool    isSeparator(int character);
 
+void    LexerCompile(Syntax* syn);
+
+Syntax* LexerLoadSyntaxes(Syntax builtins[]);
+
+void    LexerFreeSyntaxes(Syntax* syntaxes, Syntax builtins[]);
+
 /******* text row struct to organize and operate of each row of text in a file ********/
 
+#define TEXT_CHECKPOINT_STRIDE 256
+#define TEXT_BRACKET_KINDS     3
+
+enum TextPositionKey
+{
+    POSITION_TEXT,
+    POSITION_RENDER,
+    POSITION_COLUMN
+};
+
+typedef struct
+{
+    size_t    text;
+    size_t    render;
+    size_t    column;
+
+} TextPosition;
+
 typedef struct
 {
     char*             text;
     size_t            textSize;
+    unsigned int*     textShares;
     char*             render;
     size_t            renderSize;
-    unsigned char*    highlight;
+    size_t            renderWidth;
+    HighlightSpan*    highlights;
+    size_t            numberofHighlights;
+    size_t            highlightCapacity;
     size_t            index;
+    off_t             origin;
+    bool              isHighlighted;
+    bool              isScanned;
+    bool              incomingComment;
     bool              openComment;
+    unsigned int      bracketOpens[TEXT_BRACKET_KINDS];
+    unsigned int      bracketCloses[TEXT_BRACKET_KINDS];
+    TextPosition      position;
+    TextPosition*     checkpoints;
+    size_t            numberofCheckpoints;
 
 } TextRow;
 
+typedef struct
+{
+    char*            text;
+    size_t           size;
+    unsigned int*    shares;
+
+} TextSpan;
+
+typedef struct
+{
+    size_t    start;
+    size_t    end;
+
+} TextRange;
+
 void    TextRowUpdateRender(TextRow* row);
 
-void    TextRowUpdateSyntax(TextRow* row, Syntax* syn);
+void    TextRowEnsureRender(TextRow* row);
+
+bool    TextRowUpdateSyntax(TextRow* row, Syntax* syn);
+
+size_t  TextRowFindHighlight(TextRow* row, size_t renderX);
+
+HighlightClass TextRowGetHighlight(TextRow* row, size_t renderX);
+
+int     TextRowBracketDirection(TextRow* row, size_t renderX, int* kind);
 
 void    TextRowFree(TextRow* row);
 
+void    TextRowMakeWritable(TextRow* row);
+
+TextSpan TextRowShare(TextRow* row);
+
+TextSpan TextSpanCopy(const char* text, size_t size);
+
+void    TextSpanRelease(TextSpan* span);
+
 void    TextRowInsertChar(TextRow* row, size_t index, short int input, Syntax* syn);
 
 void    TextRowAppendString(TextRow* row, char* str, size_t size, Syntax* syn);
 
 void    TextRowDeleteChar(TextRow* row, size_t index, Syntax* syn);
 
+void    TextRowDeleteRange(TextRow* row, size_t index, size_t size, Syntax* syn);
+
+void    TextRowReplaceRanges(TextRow* row, TextRange* ranges, size_t count, const char* insert, size_t insertSize, Syntax* syn);
+
+TextPosition TextRowSeek(TextRow* row, int key, size_t value);
+
 size_t  TextRowGetRenderX(TextRow* row, size_t cursorX);
 
 size_t  TextRowGetCursorX(TextRow* row, size_t renderX);
 
+size_t  TextRowNextChar(TextRow* row, size_t index);
+
+size_t  TextRowPreviousChar(TextRow* row, size_t index);
+
 /******* text buffer structure to render and edit a file from ********/
 
 typedef struct
@@ -91,6 +187,8 @@ typedef struct
     Syntax*     syntax;
     TextRow*    textRow;
     size_t      numberofTextRows;
+    size_t      stateFrontier;
+    bool        isCacheDropped;
 
 } TextBuffer;
 
@@ -98,6 +196,36 @@ void    TextBufferInsertTextRow(TextBuffer* tbuf, size_t index, const char* str,
 
 void    TextBufferDeleteTextRow(TextBuffer* tbuf,size_t index);
 
+void    TextBufferInsertSpans(TextBuffer* tbuf, size_t index, TextSpan* spans, size_t count);
+
+void    TextBufferDeleteTextRows(TextBuffer* tbuf, size_t index, size_t count);
+
+void    TextBufferDeleteRange(TextBuffer* tbuf, size_t startX, size_t startY, size_t endX, size_t endY);
+
+void    TextBufferUpdateSyntax(TextBuffer* tbuf, size_t index);
+
+void    TextBufferResetSyntax(TextBuffer* tbuf);
+
+void    TextBufferUpdateState(TextBuffer* tbuf, size_t end);
+
+bool    TextScanCommentState(Syntax* syn, const char* text, size_t size, bool inComment);
+
+void    TextBufferEnsureSyntax(TextBuffer* tbuf, size_t start, size_t end);
+
+void    TextBufferAppendData(TextBuffer* tbuf, const char* data, size_t size, bool* lineOpen);
+
 char*   TextBufferToString(TextBuffer* tbuf, size_t* bufferSize);
 
+void    TextBufferMarkSaved(TextBuffer* tbuf);
+
+void    TextBufferFree(TextBuffer* tbuf);
+
+size_t  TextBufferCacheSize(TextBuffer* tbuf);
+
+void    TextBufferDropCache(TextBuffer* tbuf);
+
+void    TextBufferRestoreCache(TextBuffer* tbuf);
+
+uint64_t    TextBufferHash(TextBuffer* tbuf);
+
 #endif // BUFFER_H
@@ -0,0 +1,177 @@
+#include "cache.h"
+
+/******* sidecar location ********/
+
+uint64_t    CacheFingerprint(const char* data, size_t size, uint64_t hash)
+{
+    // 64-bit FNV-1a, chained through hash so a file can be fingerprinted a piece at a time
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+
+    return hash;
+}
+
+static int cacheMakeDirectory(char* directory)
+{
+    for (char* slash = strchr(directory + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/'))
+    {
+        *slash = '\0';
+        int status = mkdir(directory, 0700);
+        *slash = '/';
+
+        if (status == -1 && errno != EEXIST)
+            return -1;
+    }
+
+    return (mkdir(directory, 0700) == -1 && errno != EEXIST) ? -1 : 0;
+}
+
+char*       CacheGetPath(const char* path)
+{
+    // $NEO_CACHE_PATH, then the user's cache directory; sidecars are named after a hash of the absolute path
+    char directory[PATH_MAX];
+
+    const char* environment = getenv("NEO_CACHE_PATH");
+    if (environment != NULL && environment[0] != '\0')
+        snprintf(directory, PATH_MAX, "%s", environment);
+    else if ((environment = getenv("XDG_CACHE_HOME")) != NULL && environment[0] != '\0')
+        snprintf(directory, PATH_MAX, "%s/neo", environment);
+    else if ((environment = getenv("HOME")) != NULL)
+        snprintf(directory, PATH_MAX, "%s/.cache/neo", environment);
+    else
+        return NULL;
+
+    if (cacheMakeDirectory(directory) == -1)
+        return NULL;
+
+    char* cachePath = malloc(PATH_MAX);
+    if (cachePath == NULL)
+        die("malloc");
+
+    uint64_t hash = CacheFingerprint(path, strlen(path), CACHE_FINGERPRINT_INIT);
+    if (snprintf(cachePath, PATH_MAX, "%s/%016llx.idx", directory, (unsigned long long)hash) >= PATH_MAX)
+    {
+        free(cachePath);
+        return NULL;
+    }
+
+    return cachePath;
+}
+
+/******* reading and writing sidecars ********/
+
+// header, then the indexed path padded to the checkpoint alignment, then the checkpoints and one state byte each
+static size_t cacheCheckpointsOffset(size_t pathLength)
+{
+    return (sizeof(CacheHeader) + pathLength + sizeof(off_t) - 1) / sizeof(off_t) * sizeof(off_t);
+}
+
+int         CacheOpen(IndexCache* cache, const char* cachePath, const char* path)
+{
+    int file = open(cachePath, O_RDONLY | O_CLOEXEC);
+    if (file == -1)
+        return -1;
+
+    struct stat info;
+    if (fstat(file, &info) == -1 || (size_t)info.st_size < sizeof(CacheHeader))
+    {
+        close(file);
+        return -1;
+    }
+
+    void* map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (map == MAP_FAILED)
+        return -1;
+
+    CacheHeader* header = map;
+    size_t mapSize = info.st_size;
+    size_t pathLength = strlen(path);
+    size_t offset = cacheCheckpointsOffset(header->pathLength);
+
+    // sizes are checked one at a time so a damaged header cannot overflow the expected length
+    bool isValid = header->magic == CACHE_MAGIC && header->version == CACHE_VERSION &&
+                   header->pathLength == pathLength && offset <= mapSize &&
+                   memcmp((char*)map + sizeof(CacheHeader), path, pathLength) == 0 &&
+                   header->numberofCheckpoints > 0 && header->numberofStates > 0 &&
+                   header->numberofStates <= header->numberofCheckpoints &&
+                   header->numberofCheckpoints <= (mapSize - offset) / sizeof(off_t) &&
+                   mapSize == offset + header->numberofCheckpoints * sizeof(off_t) + header->numberofStates * sizeof(bool);
+
+    if (!isValid)
+    {
+        munmap(map, mapSize);
+        return -1;
+    }
+
+    cache->map = map;
+    cache->mapSize = mapSize;
+    cache->header = header;
+    cache->checkpoints = (const off_t*)((char*)map + offset);
+    cache->states = (const bool*)(cache->checkpoints + header->numberofCheckpoints);
+    return 0;
+}
+
+void        CacheClose(IndexCache* cache)
+{
+    if (cache->map != NULL)
+        munmap(cache->map, cache->mapSize);
+
+    *cache = (IndexCache)INDEX_CACHE_INIT;
+}
+
+static int cacheWriteAll(int file, const void* data, size_t size)
+{
+    const char* bytes = data;
+    while (size > 0)
+    {
+        ssize_t written = write(file, bytes, size);
+        if (written == -1 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return -1;
+
+        bytes += written;
+        size -= written;
+    }
+
+    return 0;
+}
+
+int         CacheWrite(const char* cachePath, CacheHeader* header, const char* path, const off_t* checkpoints, const bool* states)
+{
+    // written beside the old sidecar and renamed over it, a reader never sees half a file
+    char temporaryPath[PATH_MAX];
+    if (snprintf(temporaryPath, PATH_MAX, "%s.%d", cachePath, (int)getpid()) >= PATH_MAX)
+        return -1;
+
+    int file = open(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (file == -1)
+        return -1;
+
+    header->magic = CACHE_MAGIC;
+    header->version = CACHE_VERSION;
+    header->pathLength = strlen(path);
+
+    char padding[sizeof(off_t)] = { 0 };
+    size_t paddingSize = cacheCheckpointsOffset(header->pathLength) - sizeof(CacheHeader) - header->pathLength;
+
+    int status = cacheWriteAll(file, header, sizeof(CacheHeader));
+    if (status == 0)
+        status = cacheWriteAll(file, path, header->pathLength);
+    if (status == 0)
+        status = cacheWriteAll(file, padding, paddingSize);
+    if (status == 0)
+        status = cacheWriteAll(file, checkpoints, sizeof(off_t) * header->numberofCheckpoints);
+    if (status == 0)
+        status = cacheWriteAll(file, states, sizeof(bool) * header->numberofStates);
+
+    if (close(file) == -1)
+        status = -1;
+
+    if (status == 0 && rename(temporaryPath, cachePath) == 0)
+        return 0;
+
+    unlink(temporaryPath);
+    return -1;
+}
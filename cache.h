@@ -0,0 +1,55 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "terminal.h"
+
+/******* sidecar index files kept between sessions ********/
+
+#define CACHE_MAGIC               0x31584449454eULL
+#define CACHE_VERSION             1
+#define CACHE_FINGERPRINT_SIZE    4096
+#define CACHE_FINGERPRINT_INIT    14695981039346656037ULL
+
+typedef struct
+{
+    uint64_t    magic;
+    uint32_t    version;
+    uint32_t    stride;
+    uint64_t    device;
+    uint64_t    inode;
+    uint64_t    fileSize;
+    int64_t     modifiedSeconds;
+    int64_t     modifiedNanoseconds;
+    uint64_t    fingerprint;
+    uint64_t    numberofLines;
+    uint64_t    numberofCheckpoints;
+    uint64_t    numberofStates;
+    uint64_t    stateSyntax;
+    uint32_t    pathLength;
+    uint32_t    lineOpen;
+
+} CacheHeader;
+
+typedef struct
+{
+    void*           map;
+    size_t          mapSize;
+    CacheHeader*    header;
+    const off_t*    checkpoints;
+    const bool*     states;
+
+} IndexCache;
+
+#define INDEX_CACHE_INIT { NULL, 0, NULL, NULL, NULL }
+
+uint64_t    CacheFingerprint(const char* data, size_t size, uint64_t hash);
+
+char*       CacheGetPath(const char* path);
+
+int         CacheOpen(IndexCache* cache, const char* cachePath, const char* path);
+
+void        CacheClose(IndexCache* cache);
+
+int         CacheWrite(const char* cachePath, CacheHeader* header, const char* path, const off_t* checkpoints, const bool* states);
+
+#endif // CACHE_H
@@ -0,0 +1,111 @@
+#include "clipboard.h"
+
+void    ClipboardClear(Clipboard* clipboard)
+{
+    for (size_t i = 0; i < clipboard->numberofSpans; i++)
+        TextSpanRelease(&clipboard->spans[i]);
+
+    free(clipboard->spans);
+    clipboard->spans = NULL;
+    clipboard->numberofSpans = 0;
+}
+
+void    ClipboardCopy(Clipboard* clipboard, TextBuffer* tbuf, size_t startX, size_t startY, size_t endX, size_t endY)
+{
+    ClipboardClear(clipboard);
+    if (startY >= tbuf->numberofTextRows)
+        return;
+
+    if (endY >= tbuf->numberofTextRows)
+    {
+        endY = tbuf->numberofTextRows - 1;
+        endX = tbuf->textRow[endY].textSize;
+    }
+
+    clipboard->numberofSpans = endY - startY + 1;
+    clipboard->spans = malloc(sizeof(TextSpan) * clipboard->numberofSpans);
+    if (clipboard->spans == NULL)
+        die("malloc");
+
+    TextRow* first = &tbuf->textRow[startY];
+    TextRow* last = &tbuf->textRow[endY];
+    if (startX > first->textSize)
+        startX = first->textSize;
+    if (endX > last->textSize)
+        endX = last->textSize;
+
+    if (startY == endY)
+    {
+        clipboard->spans[0] = TextSpanCopy(&first->text[startX], (endX > startX) ? endX - startX : 0);
+        return;
+    }
+
+    // only the partial first and last lines are copied, whole lines in between are shared
+    clipboard->spans[0] = (startX == 0) ? TextRowShare(first) : TextSpanCopy(&first->text[startX], first->textSize - startX);
+    for (size_t i = startY + 1; i < endY; i++)
+        clipboard->spans[i - startY] = TextRowShare(&tbuf->textRow[i]);
+    clipboard->spans[endY - startY] = (endX == last->textSize) ? TextRowShare(last) : TextSpanCopy(last->text, endX);
+}
+
+void    ClipboardPaste(Clipboard* clipboard, TextBuffer* tbuf, size_t* cursorX, size_t* cursorY)
+{
+    if (clipboard->numberofSpans == 0)
+        return;
+
+    if (*cursorY >= tbuf->numberofTextRows)
+    {
+        TextBufferInsertTextRow(tbuf, tbuf->numberofTextRows, "", 0);
+        *cursorY = tbuf->numberofTextRows - 1;
+        *cursorX = 0;
+    }
+
+    TextRow* row = &tbuf->textRow[*cursorY];
+    if (*cursorX > row->textSize)
+        *cursorX = row->textSize;
+
+    TextSpan* first = &clipboard->spans[0];
+    TextSpan* last = &clipboard->spans[clipboard->numberofSpans - 1];
+
+    if (clipboard->numberofSpans == 1)
+    {
+        TextRowMakeWritable(row);
+        char* temp = realloc(row->text, row->textSize + first->size + 1);
+        if (temp == NULL)
+            die("realloc");
+
+        row->text = temp;
+        memmove(&row->text[*cursorX + first->size], &row->text[*cursorX], row->textSize - *cursorX + 1);
+        memcpy(&row->text[*cursorX], first->text, first->size);
+        row->textSize += first->size;
+        TextRowUpdateRender(row);
+        TextBufferUpdateSyntax(tbuf, *cursorY);
+        *cursorX += first->size;
+        return;
+    }
+
+    // the tail of the split line joins the last pasted line
+    size_t tailSize = row->textSize - *cursorX;
+    char* lastLine = malloc(last->size + tailSize);
+    if (lastLine == NULL)
+        die("malloc");
+
+    memcpy(lastLine, last->text, last->size);
+    memcpy(&lastLine[last->size], &row->text[*cursorX], tailSize);
+
+    size_t lastIndex = *cursorY + clipboard->numberofSpans - 1;
+    TextBufferInsertTextRow(tbuf, *cursorY + 1, lastLine, last->size + tailSize);
+    free(lastLine);
+
+    if (clipboard->numberofSpans > 2)
+        TextBufferInsertSpans(tbuf, *cursorY + 1, &clipboard->spans[1], clipboard->numberofSpans - 2);
+
+    row = &tbuf->textRow[*cursorY];
+    TextRowMakeWritable(row);
+    row->textSize = *cursorX;
+    row->text[row->textSize] = '\0';
+    TextRowAppendString(row, first->text, first->size, tbuf->syntax);
+    TextBufferUpdateSyntax(tbuf, *cursorY);
+
+    *cursorY = lastIndex;
+    *cursorX = last->size;
+}
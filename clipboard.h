@@ -0,0 +1,23 @@
+#ifndef CLIPBOARD_H
+#define CLIPBOARD_H
+
+#include "buffer.h"
+
+/******* internal clipboard sharing text with the rows it was copied from ********/
+
+typedef struct
+{
+    TextSpan*    spans;
+    size_t       numberofSpans;
+
+} Clipboard;
+
+#define CLIPBOARD_INIT { NULL, 0 }
+
+void    ClipboardClear(Clipboard* clipboard);
+
+void    ClipboardCopy(Clipboard* clipboard, TextBuffer* tbuf, size_t startX, size_t startY, size_t endX, size_t endY);
+
+void    ClipboardPaste(Clipboard* clipboard, TextBuffer* tbuf, size_t* cursorX, size_t* cursorY);
+
+#endif // CLIPBOARD_H
@@ -0,0 +1,543 @@
+#include "disk.h"
+
+DiskQueue disk = { -1, -1, NULL, 0, NULL, 0, NULL, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, NULL };
+
+/******* io_uring through raw system calls ********/
+
+static void diskRingRelease()
+{
+    if (disk.entries != NULL)
+        munmap(disk.entries, disk.entriesSize);
+    if (disk.completionMap != NULL && disk.completionMap != disk.submissionMap)
+        munmap(disk.completionMap, disk.completionMapSize);
+    if (disk.submissionMap != NULL)
+        munmap(disk.submissionMap, disk.submissionMapSize);
+    if (disk.notify != -1)
+        close(disk.notify);
+    if (disk.ring != -1)
+        close(disk.ring);
+
+    disk.entries = NULL;
+    disk.completionMap = NULL;
+    disk.submissionMap = NULL;
+    disk.notify = -1;
+    disk.ring = -1;
+}
+
+static void* diskRingMap(size_t size, off_t offset)
+{
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, disk.ring, offset);
+    return (map == MAP_FAILED) ? NULL : map;
+}
+
+static int diskRingSetup()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    disk.ring = syscall(__NR_io_uring_setup, DISK_RING_ENTRIES, &params);
+    if (disk.ring == -1)
+        return -1;
+
+    // plain reads and writes and a completion queue that never drops arrived with 5.6
+    if (!(params.features & IORING_FEAT_NODROP) || !(params.features & IORING_FEAT_RW_CUR_POS))
+    {
+        diskRingRelease();
+        return -1;
+    }
+
+    disk.submissionMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    disk.completionMapSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    bool isSingleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (isSingleMap && disk.completionMapSize > disk.submissionMapSize)
+        disk.submissionMapSize = disk.completionMapSize;
+
+    disk.submissionMap = diskRingMap(disk.submissionMapSize, IORING_OFF_SQ_RING);
+    disk.completionMap = isSingleMap ? disk.submissionMap : diskRingMap(disk.completionMapSize, IORING_OFF_CQ_RING);
+    disk.entriesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    disk.entries = diskRingMap(disk.entriesSize, IORING_OFF_SQES);
+
+    if (disk.submissionMap == NULL || disk.completionMap == NULL || disk.entries == NULL)
+    {
+        diskRingRelease();
+        return -1;
+    }
+
+    char* submission = disk.submissionMap;
+    disk.submissionTail = (unsigned*)(submission + params.sq_off.tail);
+    disk.submissionMask = (unsigned*)(submission + params.sq_off.ring_mask);
+    disk.submissionArray = (unsigned*)(submission + params.sq_off.array);
+
+    char* completion = disk.completionMap;
+    disk.completionHead = (unsigned*)(completion + params.cq_off.head);
+    disk.completionTail = (unsigned*)(completion + params.cq_off.tail);
+    disk.completionMask = (unsigned*)(completion + params.cq_off.ring_mask);
+    disk.completions = (struct io_uring_cqe*)(completion + params.cq_off.cqes);
+
+    // completions raise an eventfd, so the main loop waits on them next to the keyboard
+    disk.notify = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (disk.notify == -1 || syscall(__NR_io_uring_register, disk.ring, IORING_REGISTER_EVENTFD, &disk.notify, 1) == -1)
+    {
+        diskRingRelease();
+        return -1;
+    }
+
+    return 0;
+}
+
+static void diskRingSubmit(DiskOperation* operation)
+{
+    unsigned tail = *disk.submissionTail;
+    unsigned index = tail & *disk.submissionMask;
+
+    struct io_uring_sqe* entry = &disk.entries[index];
+    memset(entry, 0, sizeof(struct io_uring_sqe));
+
+    entry->opcode = (operation->type == DISK_READ) ? IORING_OP_READ : (operation->type == DISK_WRITE) ? IORING_OP_WRITE : IORING_OP_FSYNC;
+    entry->fd = operation->file;
+    entry->addr = (uint64_t)(uintptr_t)operation->buffer;
+    entry->len = operation->size;
+    entry->off = operation->position;
+    entry->user_data = (uint64_t)(uintptr_t)operation;
+
+    disk.submissionArray[index] = index;
+    atomic_store_explicit((_Atomic unsigned*)disk.submissionTail, tail + 1, memory_order_release);
+
+    while (syscall(__NR_io_uring_enter, disk.ring, 1, 0, 0, NULL, 0) == -1)
+    {
+        // a completion queue that overflowed takes no new entries until some are reaped
+        if (errno == EBUSY)
+            DiskDispatch();
+        else if (errno != EINTR && errno != EAGAIN)
+            die("io_uring_enter");
+    }
+}
+
+/******* pool fallback ********/
+
+static void diskRunOperation(void* argument, PoolToken* token)
+{
+    (void)token;
+    DiskOperation* operation = argument;
+
+    ssize_t result;
+    do
+    {
+        if (operation->type == DISK_READ)
+            result = pread(operation->file, operation->buffer, operation->size, operation->position);
+        else if (operation->type == DISK_WRITE)
+            result = pwrite(operation->file, operation->buffer, operation->size, operation->position);
+        else
+            result = fsync(operation->file);
+    }
+    while (result == -1 && errno == EINTR);
+
+    operation->result = (result == -1) ? -errno : result;
+}
+
+static void diskCompleteOperation(void* argument, PoolToken* token);
+
+/******* requests ********/
+
+static DiskPatch* diskFindPatch(DiskRequest* request, size_t offset)
+{
+    size_t low = 0, high = request->numberofPatches;
+    while (high - low > 1)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (request->patches[middle].start <= offset)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    return &request->patches[low];
+}
+
+static void diskSubmit(DiskRequest* request, int type, size_t offset, size_t size)
+{
+    DiskOperation* operation = malloc(sizeof(DiskOperation));
+    if (operation == NULL)
+        die("malloc");
+
+    off_t position = offset;
+    if (request->patches != NULL && type != DISK_SYNC)
+    {
+        DiskPatch* patch = diskFindPatch(request, offset);
+        position = patch->position + (offset - patch->start);
+    }
+
+    // an fsync entry must carry no buffer or the ring rejects it
+    char* buffer = (type == DISK_SYNC) ? NULL : &request->data[offset];
+    *operation = (DiskOperation){ request, type, request->file, buffer, size, offset, position, 0 };
+    request->inFlight++;
+
+    if (disk.ring != -1)
+        diskRingSubmit(operation);
+    else
+        PoolSubmit(POOL_PRIORITY_VIEWPORT, diskRunOperation, diskCompleteOperation, operation, NULL);
+}
+
+static void diskFinish(DiskRequest* request)
+{
+    close(request->file);
+    disk.numberofRequests--;
+
+    DiskRequest** link = &disk.requests;
+    while (*link != request)
+        link = &(*link)->next;
+    *link = request->next;
+
+    // a rewrite only replaces the file once all of it is synced, otherwise the old file stays as it was
+    if (request->temporaryPath != NULL)
+    {
+        if (request->error == 0 && rename(request->temporaryPath, request->targetPath) == -1)
+            request->error = errno;
+        if (request->error != 0)
+            unlink(request->temporaryPath);
+    }
+
+    request->complete(request);
+    if (request->type == DISK_WRITE)
+        free(request->data);
+    free(request->patches);
+    free(request->temporaryPath);
+    free(request->targetPath);
+    free(request->path);
+    free(request);
+}
+
+// keeps up to DISK_QUEUE_DEPTH chunks in flight and ends a write with an fsync once every chunk is down
+static void diskPump(DiskRequest* request)
+{
+    request->isPumping = true;
+    while (request->error == 0 && request->queued < request->size && request->inFlight < DISK_QUEUE_DEPTH)
+    {
+        size_t size = request->size - request->queued;
+        if (request->patches != NULL)
+        {
+            DiskPatch* patch = diskFindPatch(request, request->queued);
+            size = patch->start + patch->size - request->queued;
+        }
+
+        if (size > DISK_CHUNK_SIZE)
+            size = DISK_CHUNK_SIZE;
+
+        diskSubmit(request, request->type, request->queued, size);
+        request->queued += size;
+    }
+    request->isPumping = false;
+
+    if (request->inFlight > 0 || (request->error == 0 && request->queued < request->size))
+        return;
+
+    if (request->type == DISK_WRITE && request->error == 0 && !request->isSynced)
+    {
+        request->isSynced = true;
+        diskSubmit(request, DISK_SYNC, 0, 0);
+        return;
+    }
+
+    diskFinish(request);
+}
+
+static void diskOperationDone(DiskOperation* operation)
+{
+    DiskRequest* request = operation->request;
+    request->inFlight--;
+
+    if (operation->result < 0 && request->error == 0)
+        request->error = -operation->result;
+    else if (operation->result == 0 && operation->type == DISK_READ)
+    {
+        // the file got shorter since it was measured
+        if (operation->offset < request->size)
+            request->size = operation->offset;
+        if (request->queued > request->size)
+            request->queued = request->size;
+    }
+    else if (operation->result == 0 && operation->type == DISK_WRITE)
+    {
+        if (request->error == 0)
+            request->error = EIO;
+    }
+    else if (operation->type != DISK_SYNC && (size_t)operation->result < operation->size && request->error == 0)
+    {
+        // the rest of a short transfer goes back in the queue
+        size_t done = operation->result;
+        diskSubmit(request, operation->type, operation->offset + done, operation->size - done);
+    }
+
+    free(operation);
+
+    if (!request->isPumping)
+        diskPump(request);
+}
+
+static void diskCompleteOperation(void* argument, PoolToken* token)
+{
+    (void)token;
+    diskOperationDone(argument);
+}
+
+static DiskRequest* diskNewRequest(int file, int type, const char* path, char* data, size_t size, DiskCallback complete, void* argument)
+{
+    DiskRequest* request = malloc(sizeof(DiskRequest));
+    if (request == NULL)
+        die("malloc");
+
+    char* temp = strdup(path);
+    if (temp == NULL)
+        die("strdup");
+
+    *request = (DiskRequest){ file, type, temp, NULL, NULL, data, size, NULL, 0, 0, 0, 0, false, false, complete, argument, disk.requests };
+    disk.requests = request;
+    disk.numberofRequests++;
+    return request;
+}
+
+/******* waiting for completions ********/
+
+size_t      DiskDispatch()
+{
+    if (disk.ring == -1)
+        return 0;
+
+    uint64_t value;
+    while (read(disk.notify, &value, sizeof(value)) == -1 && errno == EINTR);
+
+    // the head is read again every time, a submission that finds the ring busy dispatches from inside a completion
+    size_t count = 0;
+    unsigned head;
+    while ((head = *disk.completionHead) != atomic_load_explicit((_Atomic unsigned*)disk.completionTail, memory_order_acquire))
+    {
+        struct io_uring_cqe* completion = &disk.completions[head & *disk.completionMask];
+        DiskOperation* operation = (DiskOperation*)(uintptr_t)completion->user_data;
+        operation->result = completion->res;
+
+        atomic_store_explicit((_Atomic unsigned*)disk.completionHead, head + 1, memory_order_release);
+
+        diskOperationDone(operation);
+        count++;
+    }
+
+    return count;
+}
+
+void        DiskWait()
+{
+    struct pollfd descriptor = { (disk.ring != -1) ? disk.notify : pool.notify, POLLIN, 0 };
+    if (poll(&descriptor, 1, -1) == -1 && errno != EINTR)
+        die("poll");
+
+    if (disk.ring != -1)
+        DiskDispatch();
+    else
+        PoolDispatch();
+}
+
+/******* queue lifetime ********/
+
+int         DiskStart()
+{
+    // without a ring every operation becomes a pool task
+    return diskRingSetup();
+}
+
+void        DiskStop()
+{
+    // a save still in flight is finished before the editor goes away
+    while (disk.numberofRequests > 0)
+        DiskWait();
+
+    diskRingRelease();
+}
+
+/******* reading and writing whole files ********/
+
+// pipes and files that report no size are read the plain way
+static char* diskReadStream(int file, size_t* size)
+{
+    size_t capacity = DISK_CHUNK_SIZE;
+    char* data = malloc(capacity);
+    if (data == NULL)
+        die("malloc");
+
+    ssize_t readSize;
+    *size = 0;
+    while ((readSize = read(file, &data[*size], capacity - *size)) != 0)
+    {
+        if (readSize == -1)
+        {
+            if (errno == EINTR)
+                continue;
+
+            free(data);
+            return NULL;
+        }
+
+        *size += readSize;
+        if (*size == capacity)
+        {
+            capacity *= 2;
+            char* temp = realloc(data, capacity);
+            if (temp == NULL)
+                die("realloc");
+            data = temp;
+        }
+    }
+
+    return data;
+}
+
+int         DiskQueueRead(const char* path, DiskCallback complete, void* argument)
+{
+    int file = open(path, O_RDONLY | O_CLOEXEC);
+    if (file == -1)
+        return -1;
+
+    // the callback owns the data once it runs, a stream is read here and completes right away
+    struct stat info;
+    if (fstat(file, &info) == -1 || !S_ISREG(info.st_mode) || info.st_size == 0)
+    {
+        size_t size;
+        char* data = diskReadStream(file, &size);
+        if (data == NULL)
+        {
+            int error = errno;
+            close(file);
+            errno = error;
+            return -1;
+        }
+
+        DiskRequest* request = diskNewRequest(file, DISK_READ, path, data, size, complete, argument);
+        request->queued = size;
+        diskPump(request);
+        return 0;
+    }
+
+    char* data = malloc(info.st_size);
+    if (data == NULL)
+        die("malloc");
+
+    diskPump(diskNewRequest(file, DISK_READ, path, data, info.st_size, complete, argument));
+    return 0;
+}
+
+int         DiskWriteFile(const char* path, char* data, size_t size, DiskCallback complete, void* argument)
+{
+    // an existing file is rewritten beside itself and renamed over, a symbolic link keeps pointing at the new file
+    char* targetPath = realpath(path, NULL);
+    char* temporaryPath = NULL;
+    struct stat info;
+    int file;
+
+    if (targetPath != NULL && stat(targetPath, &info) == 0 && S_ISREG(info.st_mode))
+    {
+        temporaryPath = malloc(strlen(targetPath) + sizeof(".XXXXXX"));
+        if (temporaryPath == NULL)
+            die("malloc");
+
+        sprintf(temporaryPath, "%s.XXXXXX", targetPath);
+        file = mkostemp(temporaryPath, O_CLOEXEC);
+        if (file != -1)
+        {
+            fchmod(file, info.st_mode & 07777);
+            if (fchown(file, info.st_uid, info.st_gid) == -1)
+                fchmod(file, info.st_mode & 0777);
+        }
+    }
+    else
+        file = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if (file == -1 || ftruncate(file, size) == -1)
+    {
+        int error = errno;
+        if (file != -1)
+        {
+            close(file);
+            if (temporaryPath != NULL)
+                unlink(temporaryPath);
+        }
+
+        free(temporaryPath);
+        free(targetPath);
+        free(data);
+        errno = error;
+        return -1;
+    }
+
+    // the request owns the data from here on and frees it after complete has run
+    DiskRequest* request = diskNewRequest(file, DISK_WRITE, path, data, size, complete, argument);
+    if (temporaryPath != NULL)
+    {
+        request->temporaryPath = temporaryPath;
+        request->targetPath = targetPath;
+    }
+    else
+        free(targetPath);
+
+    diskPump(request);
+    return 0;
+}
+
+int         DiskWritePatches(const char* path, char* data, DiskPatch* patches, size_t numberofPatches, off_t fileSize, DiskCallback complete, void* argument)
+{
+    // patched in place, so unlike DiskWriteFile a failure part way leaves the file mixed
+    int file = open(path, O_WRONLY | O_CLOEXEC);
+    if (file == -1 || ftruncate(file, fileSize) == -1)
+    {
+        int error = errno;
+        if (file != -1)
+            close(file);
+
+        free(data);
+        free(patches);
+        errno = error;
+        return -1;
+    }
+
+    size_t size = (numberofPatches > 0) ? patches[numberofPatches - 1].start + patches[numberofPatches - 1].size : 0;
+    DiskRequest* request = diskNewRequest(file, DISK_WRITE, path, data, size, complete, argument);
+    request->patches = patches;
+    request->numberofPatches = numberofPatches;
+
+    diskPump(request);
+    return 0;
+}
+
+/******* noticing changes made by others ********/
+
+// a file gets one write at a time, a second one could land its older snapshot last
+bool        DiskIsWriting(const char* path)
+{
+    for (DiskRequest* request = disk.requests; request != NULL; request = request->next)
+    {
+        if (request->type == DISK_WRITE && !strcmp(request->path, path))
+            return true;
+    }
+
+    return false;
+}
+
+int         DiskGetFileInfo(const char* path, DiskFileInfo* info)
+{
+    struct stat status;
+    if (stat(path, &status) == -1 || !S_ISREG(status.st_mode))
+    {
+        *info = (DiskFileInfo)DISK_FILE_INFO_INIT;
+        return -1;
+    }
+
+    *info = (DiskFileInfo){ status.st_dev, status.st_ino, status.st_size, status.st_mtim, true };
+    return 0;
+}
+
+bool        DiskFileIsUnchanged(const char* path, DiskFileInfo* info)
+{
+    DiskFileInfo current;
+    return info->isKnown && DiskGetFileInfo(path, &current) == 0 &&
+           current.device == info->device && current.inode == info->inode && current.size == info->size &&
+           current.modified.tv_sec == info->modified.tv_sec && current.modified.tv_nsec == info->modified.tv_nsec;
+}
@@ -0,0 +1,121 @@
+#ifndef DISK_H
+#define DISK_H
+
+#include "pool.h"
+
+/******* queued file reads and writes ********/
+
+#define DISK_RING_ENTRIES    128
+#define DISK_QUEUE_DEPTH     32
+#define DISK_CHUNK_SIZE      (1024 * 1024)
+
+enum DiskOperationType
+{
+    DISK_READ = 0,
+    DISK_WRITE,
+    DISK_SYNC
+};
+
+// a run of request data that lands at position in the file instead of at its own offset
+typedef struct
+{
+    size_t    start;
+    size_t    size;
+    off_t     position;
+
+} DiskPatch;
+
+typedef struct
+{
+    dev_t              device;
+    ino_t              inode;
+    off_t              size;
+    struct timespec    modified;
+    bool               isKnown;
+
+} DiskFileInfo;
+
+#define DISK_FILE_INFO_INIT { 0, 0, 0, { 0, 0 }, false }
+
+typedef struct DiskRequest
+{
+    int                     file;
+    int                     type;
+    char*                   path;
+    char*                   targetPath;
+    char*                   temporaryPath;
+    char*                   data;
+    size_t                  size;
+    DiskPatch*              patches;
+    size_t                  numberofPatches;
+    size_t                  queued;
+    size_t                  inFlight;
+    int                     error;
+    bool                    isSynced;
+    bool                    isPumping;
+    void                  (*complete)(struct DiskRequest* request);
+    void*                   argument;
+    struct DiskRequest*     next;
+
+} DiskRequest;
+
+typedef void (*DiskCallback)(DiskRequest* request);
+
+typedef struct
+{
+    DiskRequest*    request;
+    int             type;
+    int             file;
+    char*           buffer;
+    size_t          size;
+    size_t          offset;
+    off_t           position;
+    ssize_t         result;
+
+} DiskOperation;
+
+typedef struct
+{
+    int                     ring;
+    int                     notify;
+    void*                   submissionMap;
+    size_t                  submissionMapSize;
+    void*                   completionMap;
+    size_t                  completionMapSize;
+    struct io_uring_sqe*    entries;
+    size_t                  entriesSize;
+    unsigned*               submissionTail;
+    unsigned*               submissionMask;
+    unsigned*               submissionArray;
+    unsigned*               completionHead;
+    unsigned*               completionTail;
+    unsigned*               completionMask;
+    struct io_uring_cqe*    completions;
+    size_t                  numberofRequests;
+    DiskRequest*            requests;
+
+} DiskQueue;
+
+extern DiskQueue disk;
+
+int         DiskStart();
+
+void        DiskStop();
+
+int         DiskQueueRead(const char* path, DiskCallback complete, void* argument);
+
+int         DiskWriteFile(const char* path, char* data, size_t size, DiskCallback complete, void* argument);
+
+int         DiskWritePatches(const char* path, char* data, DiskPatch* patches, size_t numberofPatches, off_t fileSize, DiskCallback complete, void* argument);
+
+bool        DiskIsWriting(const char* path);
+
+int         DiskGetFileInfo(const char* path, DiskFileInfo* info);
+
+bool        DiskFileIsUnchanged(const char* path, DiskFileInfo* info);
+
+size_t      DiskDispatch();
+
+void        DiskWait();
+
+#endif // DISK_H
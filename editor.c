@@ -7,8 +7,8 @@ void    disableRawMode(EditorConfiguration *config)
     if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &config->originalTermios) == -1)
         die("tcsetattr");
 
-    write(STDOUT_FILENO, "\x1b[2J", 4);
-    write(STDOUT_FILENO, "\x1b[H", 3);
+    TerminalWrite("\x1b[2J", 4);
+    TerminalWrite("\x1b[H", 3);
 }
 
 void    enableRawMode(EditorConfiguration *config)
@@ -28,18 +28,63 @@ void    enableRawMode(EditorConfiguration *config)
         die("tcsetattr");
 }
 
+// the disk queue is stopped first, so no read still lands in a load that goes away here
+static void editorFreeLoad(EditorLoad* load)
+{
+    if (load == NULL)
+        return;
+
+    free(load->data);
+    free(load);
+}
+
 void    EditorKill(EditorConfiguration *config)
+{
+    EditorFree(config);
+    disableRawMode(config);
+    // todo: figure out disableRawMode situation
+}
+
+void    EditorFree(EditorConfiguration *config)
 {
     free(config->filename);
-    for (size_t i = 0; i < config->textBuffer.numberofTextRows; i++)
+    config->filename = NULL;
+    editorFreeLoad(config->load);
+    config->load = NULL;
+    TextBufferFree(&config->textBuffer);
+    ViewerClose(&config->viewer);
+    FollowerStop(&config->follower);
+    StreamStop(config->stream);
+    WrapIndexFree(&config->wrap);
+    BracketIndexFree(&config->brackets);
+    FilterIndexFree(&config->filter);
+
+    for (size_t i = 0; i < config->numberofBuffers; i++)
     {
-        free(config->textBuffer.textRow[i].text);
-        free(config->textBuffer.textRow[i].render);
-        free(config->textBuffer.textRow[i].highlight);
+        EditorBuffer* buffer = &config->buffers[i];
+        if (i == config->currentBuffer)
+            continue;
+
+        free(buffer->filename);
+        editorFreeLoad(buffer->load);
+        TextBufferFree(&buffer->textBuffer);
+        ViewerClose(&buffer->viewer);
+        FollowerStop(&buffer->follower);
+        StreamStop(buffer->stream);
+        WrapIndexFree(&buffer->wrap);
+        BracketIndexFree(&buffer->brackets);
+        FilterIndexFree(&buffer->filter);
     }
-    free(config->textBuffer.textRow);
-    disableRawMode(config);
-    // todo: figure out disableRawMode situation
+
+    free(config->buffers);
+    config->buffers = NULL;
+    config->numberofBuffers = 0;
+    ClipboardClear(&config->clipboard);
+    EditorClearCursors(config);
+
+    if (config->memoryPressure != -1)
+        close(config->memoryPressure);
+    config->memoryPressure = -1;
 }
 
 int     EditorGetCursorPosition(EditorConfiguration *config)
@@ -47,12 +92,12 @@ int     EditorGetCursorPosition(EditorConfiguration *config)
     char buffer[32];
     unsigned int i = 0;
 
-    if (write(STDOUT_FILENO, "\x1b[6n", 4) != 4)
+    if (TerminalWrite("\x1b[6n", 4) != 4)
         return -1;
 
     while (i < sizeof(buffer) - 1)
     {
-        if (read(STDIN_FILENO, &buffer[i], 1) != 1)
+        if (TerminalRead(&buffer[i], 1) != 1)
             break;
         if (buffer[i] == 'R')
             break;
@@ -74,7 +119,7 @@ int     EditorGetWindowSize(EditorConfiguration *config)
 
     if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &window) == -1 || window.ws_col == 0)
     {
-        if (write(STDOUT_FILENO, "\x1b[999C\x1b[999B", 12) != 12)
+        if (TerminalWrite("\x1b[999C\x1b[999B", 12) != 12)
             return -1;
         return EditorGetCursorPosition(config);
     }
@@ -86,26 +131,101 @@ int     EditorGetWindowSize(EditorConfiguration *config)
     }
 }
 
+static volatile sig_atomic_t isResizePending = 0;
+
+// only sets a flag so it is safe in a signal handler, the next refresh reads the new size
+void    EditorNotifyResize()
+{
+    isResizePending = 1;
+}
+
+static void editorApplyResize(EditorConfiguration *config)
+{
+    if (!isResizePending)
+        return;
+
+    isResizePending = 0;
+    if (EditorGetWindowSize(config) == -1)
+        die("EditorGetWindowSize");
+
+    config->screenRows -= 2;
+}
+
+// the kernel raises POLLPRI once tasks stall on memory for long enough within the window, where pressure stall information exists
+static int editorWatchMemoryPressure()
+{
+    int file = open("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (file == -1)
+        return -1;
+
+    if (write(file, EDITOR_MEMORY_PRESSURE, strlen(EDITOR_MEMORY_PRESSURE) + 1) == -1)
+    {
+        close(file);
+        return -1;
+    }
+
+    return file;
+}
+
 void    EditorInit(EditorConfiguration *config)
 {
     enableRawMode(config);
+    EditorInitHeadless(config, 0, 0);
+
+    if (EditorGetWindowSize(config) == -1)
+        die("EditorGetWindowSize");
+
+    config->screenRows -= 2;
+    config->memoryPressure = editorWatchMemoryPressure();
+}
+
+void    EditorInitHeadless(EditorConfiguration *config, short unsigned int screenRows, short unsigned int screenColumns)
+{
+    config->screenRows = (screenRows > 2) ? screenRows - 2 : 0;
+    config->screenColumns = screenColumns;
     config->cursorX = 0;
     config->cursorY = 0;
     config->renderX = 0;
     config->textBuffer.numberofTextRows = 0;
+    config->textBuffer.stateFrontier = 0;
     config->textBuffer.textRow = NULL;
     config->textBuffer.syntax = NULL;
+    config->textBuffer.isCacheDropped = false;
     config->rowOffset = 0;
     config->columnOffset = 0;
     config->filename = NULL;
     config->statusMessage[0] = '\0';
     config->statusMessageTime = 0;
     config->isSaved = true;
-
-    if (EditorGetWindowSize(config) == -1)
-        die("EditorGetWindowSize");
-
-    config->screenRows -= 2;
+    config->isSaving = false;
+    config->load = NULL;
+    config->diskInfo = (DiskFileInfo)DISK_FILE_INFO_INIT;
+    config->viewer = (FileViewer)FILE_VIEWER_INIT;
+    config->follower = (FileFollower)FILE_FOLLOWER_INIT;
+    config->stream = NULL;
+    config->wrap = (WrapIndex)WRAP_INDEX_INIT;
+    config->wrapLineOffset = 0;
+    config->brackets = (BracketIndex)BRACKET_INDEX_INIT;
+    config->filter = (FilterIndex)FILTER_INDEX_INIT;
+    config->searchRow = 0;
+    config->searchHighlight = (HighlightSpan)HIGHLIGHT_SPAN_NONE;
+    RenderInvalidate();
+
+    config->buffers = malloc(sizeof(EditorBuffer));
+    if (config->buffers == NULL)
+        die("malloc");
+
+    config->numberofBuffers = 1;
+    config->currentBuffer = 0;
+    config->bufferClock = 0;
+    config->isSelecting = false;
+    config->selectionX = 0;
+    config->selectionY = 0;
+    config->clipboard = (Clipboard)CLIPBOARD_INIT;
+    config->cursors = NULL;
+    config->numberofCursors = 0;
+    config->cursorCapacity = 0;
+    config->memoryPressure = -1;
 }
 
 void    EditorSetSyntaxHighlight(EditorConfiguration *config, Syntax HLDB[])
@@ -126,9 +246,8 @@ void    EditorSetSyntaxHighlight(EditorConfiguration *config, Syntax HLDB[])
             if ((isExtension && extention && !strcmp(extention, syn->fileMatch[i])) || (!isExtension && strstr(config->filename, syn->fileMatch[i])))
             {
                 config->textBuffer.syntax = syn;
-
-                for(size_t k = 0; k < config->textBuffer.numberofTextRows; k++)
-                    TextRowUpdateSyntax(&config->textBuffer.textRow[k], config->textBuffer.syntax);
+                TextBufferResetSyntax(&config->textBuffer);
+                EditorNotifyRowsChanged(config);
 
                 return;
             }
@@ -138,6 +257,49 @@ void    EditorSetSyntaxHighlight(EditorConfiguration *config, Syntax HLDB[])
 
 /******* handling files to edit ********/
 
+// only records the result, the buffer it belongs to may be out of view or halfway through a command by now
+static void editorLoadDone(DiskRequest* request)
+{
+    EditorLoad* load = request->argument;
+    load->data = request->data;
+    load->size = request->size;
+    load->error = request->error;
+    load->isDone = true;
+}
+
+static void editorFinishLoad(EditorConfiguration *config)
+{
+    EditorLoad* load = config->load;
+    config->load = NULL;
+
+    if (load->error != 0)
+    {
+        EditorSetStatusMessage(config, "Cannot read %s: %s", config->filename, strerror(load->error));
+        editorFreeLoad(load);
+        return;
+    }
+
+    char* data = load->data;
+    char* line = data;
+    char* end = data + load->size;
+    while (line < end)
+    {
+        char* newline = memchr(line, '\n', end - line);
+        char* lineEnd = (newline != NULL) ? newline : end;
+        size_t linelen = lineEnd - line;
+        while (linelen > 0 && line[linelen - 1] == '\r')
+            linelen--;
+
+        // a row that lost its carriage return is saved differently from how it was read, so it has no place on disk
+        TextBufferInsertTextRow(&config->textBuffer, config->textBuffer.numberofTextRows, line, linelen);
+        config->textBuffer.textRow[config->textBuffer.numberofTextRows - 1].origin = (line + linelen == lineEnd) ? line - data : -1;
+        line = (newline != NULL) ? newline + 1 : end;
+    }
+
+    editorFreeLoad(load);
+    EditorNotifyRowsChanged(config);
+}
+
 void    EditorOpenFile(EditorConfiguration *config, const char* filename, Syntax HLDB[])
 {
     free(config->filename);
@@ -150,527 +312,2322 @@ void    EditorOpenFile(EditorConfiguration *config, const char* filename, Syntax
 
     EditorSetSyntaxHighlight(config, HLDB);
 
+    struct stat info;
+    if (stat(filename, &info) == 0 && info.st_size > VIEWER_SIZE_THRESHOLD)
+    {
+        EditorOpenFileViewer(config, filename, HLDB);
+        return;
+    }
 
-    FILE* file = fopen(filename, "r");
-    if (file == NULL)
-        die("fopen");
-
-    char* line = NULL;
-    size_t linecap = 0;
-    ssize_t linelen;
+    // taken before reading, so a change made while the file is read still shows at save time
+    DiskGetFileInfo(filename, &config->diskInfo);
 
-    while ((linelen = getline(&line, &linecap, file)) != -1)
-    {
-        while (linelen > 0 && (line[linelen - 1] == '\n' || line[linelen - 1] == '\r'))
-            linelen--;
+    EditorLoad* load = malloc(sizeof(EditorLoad));
+    if (load == NULL)
+        die("malloc");
 
-        TextBufferInsertTextRow(&config->textBuffer, config->textBuffer.numberofTextRows, line, linelen);
-    }
+    *load = (EditorLoad){ NULL, 0, 0, false };
+    if (DiskQueueRead(filename, editorLoadDone, load) == -1)
+        die("DiskQueueRead");
 
-    free(line);
-    fclose(file);
+    config->load = load;
     config->isSaved = true;
+    config->isSaving = false;
 }
 
-void    EditorSaveToFile(EditorConfiguration *config, Syntax HLDB[])
+void    EditorWaitForLoad(EditorConfiguration *config)
 {
-    if (config->filename == NULL)
+    while (config->load != NULL && !config->load->isDone)
+        DiskWait();
+
+    if (config->load != NULL)
+        editorFinishLoad(config);
+}
+
+void    EditorOpenFileViewer(EditorConfiguration *config, const char* filename, Syntax HLDB[])
+{
+    if (config->filename == NULL || strcmp(config->filename, filename) != 0)
     {
-        config->filename = EditorPromptForInput(config, "Save file as: %s", NULL);
-        if (config->filename ==  NULL)
-        {
-            EditorSetStatusMessage(config, "Save cancelled!");
-            return;
-        }
+        free(config->filename);
+
+        char* temp = strdup(filename);
+        if (temp != NULL)
+            config->filename = temp;
+        else
+            die("strdup");
 
         EditorSetSyntaxHighlight(config, HLDB);
     }
 
-    size_t bufferSize;
-    char* buffer = TextBufferToString(&config->textBuffer, &bufferSize);
+    ViewerClose(&config->viewer);
+    if (ViewerOpen(&config->viewer, filename) == -1)
+        die("ViewerOpen");
+
+    ViewerLoadWindow(&config->viewer, &config->textBuffer, 0);
+    config->cursorX = 0;
+    config->cursorY = 0;
+    config->rowOffset = 0;
+    config->columnOffset = 0;
+    config->isSaved = true;
+    config->isSaving = false;
+    EditorNotifyRowsChanged(config);
+}
 
-    int file = open(config->filename, O_RDWR | O_CREAT, 0644);
+static void editorSaveDone(DiskRequest* request)
+{
+    // saves to one path never overlap, so this was the last one for every buffer showing it
+    EditorConfiguration* config = request->argument;
+    if (config->filename != NULL && !strcmp(config->filename, request->path))
+    {
+        config->isSaving = false;
+        if (FollowerIsActive(&config->follower))
+            FollowerResync(&config->follower);
+        if (request->error == 0)
+            DiskGetFileInfo(request->path, &config->diskInfo);
+        else
+            config->isSaved = false;
+    }
 
-    if (file != -1)
+    for (size_t i = 0; i < config->numberofBuffers; i++)
     {
-        if (ftruncate(file, bufferSize) != -1)
+        EditorBuffer* buffer = &config->buffers[i];
+        if (i != config->currentBuffer && buffer->filename != NULL && !strcmp(buffer->filename, request->path))
         {
-            if (write(file, buffer, bufferSize) != -1)
-            {
-                close(file);
-                free(buffer);
-                config->isSaved = true;
-                EditorSetStatusMessage(config, "%ldB written to disk.", bufferSize);
-                return;
-            }
+            buffer->isSaving = false;
+            if (FollowerIsActive(&buffer->follower))
+                FollowerResync(&buffer->follower);
+            if (request->error == 0)
+                DiskGetFileInfo(request->path, &buffer->diskInfo);
+            else
+                buffer->isSaved = false;
         }
-        close(file);
     }
 
-    free(buffer);
-    EditorSetStatusMessage(config, "Save Failed! Error: %s", strerror(errno)); // for testing only
+    if (request->error != 0)
+        EditorSetStatusMessage(config, "Save Failed! Error: %s", strerror(request->error)); // for testing only
+    else if (request->patches != NULL)
+        EditorSetStatusMessage(config, "%zuB written to disk (patched in place, %zu regions).", request->size, request->numberofPatches);
+    else
+        EditorSetStatusMessage(config, "%zuB written to disk.", request->size);
 }
 
-/******* Editor output ********/
-
-void    EditorScroll(EditorConfiguration *config)
+// rows still where they were read or last saved from are skipped, each run of the others becomes one patch
+static size_t editorCollectPatches(TextBuffer* tbuf, off_t fileSize, char* data, DiskPatch* patches, size_t* numberofPatches, size_t* bufferSize)
 {
-    config->renderX = 0;
-    if (config->cursorY < config->textBuffer.numberofTextRows)
-        config->renderX = TextRowGetRenderX(&config->textBuffer.textRow[config->cursorY], config->cursorX);
+    size_t position = 0, written = 0, count = 0;
+    bool isInPatch = false;
 
-    if (config->cursorY < config->rowOffset)
-        config->rowOffset = config->cursorY;
+    for (size_t i = 0; i < tbuf->numberofTextRows; i++)
+    {
+        TextRow* row = &tbuf->textRow[i];
+        size_t rowSize = row->textSize + 1;
 
-    if (config->cursorY >= config->rowOffset + config->screenRows)
-        config->rowOffset = config->cursorY - config->screenRows + 1;
+        // the last row of a file without a final newline is rewritten to gain one
+        if (row->origin == (off_t)position && (off_t)(position + rowSize) <= fileSize)
+        {
+            isInPatch = false;
+            position += rowSize;
+            continue;
+        }
 
-    if (config->renderX < config->columnOffset)
-        config->columnOffset = config->renderX;
+        if (!isInPatch)
+        {
+            if (patches != NULL)
+                patches[count] = (DiskPatch){ written, 0, position };
+            count++;
+            isInPatch = true;
+        }
 
-    if (config->renderX >= config->columnOffset + config->screenColumns)
-        config->columnOffset = config->renderX - config->screenColumns + 1;
-}
+        if (data != NULL)
+        {
+            memcpy(&data[written], row->text, row->textSize);
+            data[written + row->textSize] = '\n';
+            patches[count - 1].size += rowSize;
+        }
 
-void    EditorSetStatusMessage(EditorConfiguration *config, const char* fstring, ...)
-{
-    va_list arg;
-    va_start(arg, fstring);
-    vsnprintf(config->statusMessage, sizeof(config->statusMessage), fstring, arg);
-    va_end(arg);
-    config->statusMessageTime = time(NULL);
+        written += rowSize;
+        position += rowSize;
+    }
+
+    *numberofPatches = count;
+    *bufferSize = position;
+    return written;
 }
 
-void    EditorDrawRows(EditorConfiguration *config, ScreenBuffer* sbuf)
+void    EditorSaveToFile(EditorConfiguration *config, Syntax HLDB[])
 {
-    for (int i = 0; i < config->screenRows; i++)
+    if (ViewerIsActive(&config->viewer))
     {
-        size_t fileRow = i + config->rowOffset;
-        if (fileRow >= config->textBuffer.numberofTextRows)
+        EditorSetStatusMessage(config, "Read-only view: file is too large to edit.");
+        return;
+    }
+
+    if (config->filename == NULL)
+    {
+        config->filename = EditorPromptForInput(config, "Save file as: %s", NULL);
+        if (config->filename ==  NULL)
         {
-            if (config->textBuffer.numberofTextRows == 0 && i == config->screenRows / 3)
-            {
-                char welcome[50];
-                int welcomelen = snprintf(welcome, sizeof(welcome), "Neo Text Editor -- version %s", NEO_VERSION);
+            EditorSetStatusMessage(config, "Save cancelled!");
+            return;
+        }
 
-                if (welcomelen > config->screenColumns)
-                    welcomelen = config->screenColumns;
+        EditorSetSyntaxHighlight(config, HLDB);
+    }
 
-                int padding = (config->screenColumns - welcomelen) / 2;
-                if (padding > 0)
-                {
-                    ScreenBufferAppend(sbuf, ">", 1);
-                    padding--;
-                }
-                while (padding)
-                {
-                    ScreenBufferAppend(sbuf, " ", 1);
-                    padding--;
-                }
+    if (DiskIsWriting(config->filename))
+    {
+        EditorSetStatusMessage(config, "Save in progress, try again once it is written.");
+        return;
+    }
 
-                ScreenBufferAppend(sbuf, welcome, welcomelen);
-            }
-            else
-                ScreenBufferAppend(sbuf, ">", 1);
-        }
-        else
-        {
-            ssize_t len = config->textBuffer.textRow[fileRow].renderSize - config->columnOffset;
-            if (len < 0)
-                len = 0;
+    // only rows that moved or changed are written when nobody else touched the file since it was read or saved
+    size_t bufferSize = 0, numberofPatches = 0, patchSize = 0;
+    bool isPatching = disk.numberofRequests == 0 && DiskFileIsUnchanged(config->filename, &config->diskInfo);
+    if (isPatching)
+    {
+        patchSize = editorCollectPatches(&config->textBuffer, config->diskInfo.size, NULL, NULL, &numberofPatches, &bufferSize);
 
-            if (len > config->screenColumns)
-                len = config->screenColumns;
+        // patching is not atomic, past that share of the file a full rewrite costs little more and is safe
+        isPatching = patchSize <= bufferSize / EDITOR_PATCH_RATIO;
+    }
 
-            char* temp = &config->textBuffer.textRow[fileRow].render[config->columnOffset];
-            unsigned char* highlight = &config->textBuffer.textRow[fileRow].highlight[config->columnOffset];
-            char* currentColor = NULL;
+    if (isPatching && patchSize == 0 && (off_t)bufferSize == config->diskInfo.size)
+    {
+        config->isSaved = true;
+        EditorSetStatusMessage(config, "0B written, the file on disk already matches.");
+        return;
+    }
 
-            for (size_t j = 0; j < len; j++)
-            {
-                if (iscntrl(temp[j]))
-                {
-                    char symbol = (temp[j] <= 26) ? '@' + temp[j] : '?';
-                    ScreenBufferAppend(sbuf, "\x1b[7m", 4);
-                    ScreenBufferAppend(sbuf, &symbol, 1);
-                    ScreenBufferAppend(sbuf, "\x1b[m", 3);
-                    if (currentColor != NULL)
-                    {
-                        char buffer[16];
-                        int len = snprintf(buffer, sizeof(buffer), "\x1b[%sm", currentColor);
-                        ScreenBufferAppend(sbuf, buffer, len);
-                    }
-                }
-                else if(highlight[j] == HIGHLIGHT_NORMAL)
-                {
-                    if(currentColor != NULL)
-                    {
-                        ScreenBufferAppend(sbuf, "\x1b[39m", 5);
-                        currentColor = NULL;
-                    }
-                    ScreenBufferAppend(sbuf, &temp[j], 1);
-                }
-                else
-                {
-                    char* color = getSyntaxColor(highlight[j]);
-                    if (color != currentColor)
-                    {
-                        currentColor = color;
-                        char buffer[16];
-                        int len = snprintf(buffer, sizeof(buffer), "\x1b[%sm", color);
-                        ScreenBufferAppend(sbuf, buffer, len);
-                    }
-                    ScreenBufferAppend(sbuf, &temp[j], 1);
-                }
-            }
+    int status;
+    if (isPatching)
+    {
+        char* buffer = malloc(patchSize + 1);
+        DiskPatch* patches = malloc(sizeof(DiskPatch) * (numberofPatches + 1));
+        if (buffer == NULL || patches == NULL)
+            die("malloc");
 
-            ScreenBufferAppend(sbuf, "\x1b[39m", 5);
-        }
+        editorCollectPatches(&config->textBuffer, config->diskInfo.size, buffer, patches, &numberofPatches, &bufferSize);
+        status = DiskWritePatches(config->filename, buffer, patches, numberofPatches, bufferSize, editorSaveDone, config);
+    }
+    else
+    {
+        char* buffer = TextBufferToString(&config->textBuffer, &bufferSize);
+        status = DiskWriteFile(config->filename, buffer, bufferSize, editorSaveDone, config);
+    }
 
-        ScreenBufferAppend(sbuf, "\x1b[K", 3);
-        ScreenBufferAppend(sbuf, "\r\n", 2);
+    // the snapshot is written in the background, a failure reported later marks the buffer unsaved again
+    if (status == -1)
+    {
+        EditorSetStatusMessage(config, "Save Failed! Error: %s", strerror(errno)); // for testing only
+        return;
     }
+
+    // the buffer only counts as saved once the write is down, an edit meanwhile clears isSaved as usual
+    TextBufferMarkSaved(&config->textBuffer);
+    config->diskInfo.isKnown = false;
+    config->isSaved = true;
+    config->isSaving = true;
+
+    if (isPatching)
+        EditorSetStatusMessage(config, "Writing %zuB of %zuB...", patchSize, bufferSize);
+    else
+        EditorSetStatusMessage(config, "Writing %zuB...", bufferSize);
 }
 
-void    EditorDrawStatusBar(EditorConfiguration *config, ScreenBuffer* sbuf)
-{
-    ScreenBufferAppend(sbuf, "\x1b[7m", 4);
+/******* buffer list ********/
 
-    char* filename = (config->filename == NULL) ? "[No File Opened]" : config->filename;
+static void editorStoreBuffer(EditorConfiguration *config, EditorBuffer* buffer)
+{
+    buffer->textBuffer = config->textBuffer;
+    buffer->filename = config->filename;
+    buffer->cursorX = config->cursorX;
+    buffer->cursorY = config->cursorY;
+    buffer->renderX = config->renderX;
+    buffer->rowOffset = config->rowOffset;
+    buffer->columnOffset = config->columnOffset;
+    buffer->isSaved = config->isSaved;
+    buffer->isSaving = config->isSaving;
+    buffer->load = config->load;
+    buffer->diskInfo = config->diskInfo;
+    buffer->viewer = config->viewer;
+    buffer->follower = config->follower;
+    buffer->stream = config->stream;
+    buffer->wrap = config->wrap;
+    buffer->wrapLineOffset = config->wrapLineOffset;
+    buffer->brackets = config->brackets;
+    buffer->filter = config->filter;
+    buffer->lastUsed = ++config->bufferClock;
+    buffer->isCacheDropped = false;
+}
 
-    char status[140], cursor[50];
+static void editorLoadBuffer(EditorConfiguration *config, EditorBuffer* buffer)
+{
+    config->textBuffer = buffer->textBuffer;
+    config->filename = buffer->filename;
+    config->cursorX = buffer->cursorX;
+    config->cursorY = buffer->cursorY;
+    config->renderX = buffer->renderX;
+    config->rowOffset = buffer->rowOffset;
+    config->columnOffset = buffer->columnOffset;
+    config->isSaved = buffer->isSaved;
+    config->isSaving = buffer->isSaving;
+    config->load = buffer->load;
+    config->diskInfo = buffer->diskInfo;
+    config->viewer = buffer->viewer;
+    config->follower = buffer->follower;
+    config->stream = buffer->stream;
+    config->wrap = buffer->wrap;
+    config->wrapLineOffset = buffer->wrapLineOffset;
+    config->brackets = buffer->brackets;
+    config->filter = buffer->filter;
+}
 
-    char* saveStatus = config->isSaved ? "" : "[UNSAVED]";
-    int statusSize = snprintf(status, sizeof(status), "%s  %.50s ~ %ld lines", saveStatus, filename, config->textBuffer.numberofTextRows);
+void    EditorNewBuffer(EditorConfiguration *config)
+{
+    EditorBuffer* temp = realloc(config->buffers, sizeof(EditorBuffer) * (config->numberofBuffers + 1));
+    if (temp == NULL)
+        die("realloc");
+
+    config->buffers = temp;
+    editorStoreBuffer(config, &config->buffers[config->currentBuffer]);
+    config->currentBuffer = config->numberofBuffers;
+    config->numberofBuffers++;
+
+    // soft wrap is only suspended while a filter is shown
+    bool isWrapped = config->filter.isEnabled ? config->filter.wasWrapped : config->wrap.isEnabled;
+    config->textBuffer = (TextBuffer){ NULL, NULL, 0, 0, false };
+    config->filename = NULL;
+    config->cursorX = 0;
+    config->cursorY = 0;
+    config->renderX = 0;
+    config->rowOffset = 0;
+    config->columnOffset = 0;
+    config->isSaved = true;
+    config->isSaving = false;
+    config->load = NULL;
+    config->diskInfo = (DiskFileInfo)DISK_FILE_INFO_INIT;
+    config->viewer = (FileViewer)FILE_VIEWER_INIT;
+    config->follower = (FileFollower)FILE_FOLLOWER_INIT;
+    config->stream = NULL;
+    config->wrap = (WrapIndex)WRAP_INDEX_INIT;
+    config->wrap.isEnabled = isWrapped;
+    config->wrapLineOffset = 0;
+    config->brackets = (BracketIndex)BRACKET_INDEX_INIT;
+    config->filter = (FilterIndex)FILTER_INDEX_INIT;
+    config->isSelecting = false;
+    EditorClearCursors(config);
+}
 
-    int cursorSize = snprintf(cursor, sizeof(cursor), "%ld:%ld", config->cursorY + 1, config->cursorX + 1);
+void    EditorSwitchBuffer(EditorConfiguration *config, size_t index)
+{
+    if (index >= config->numberofBuffers || index == config->currentBuffer)
+        return;
 
-    if (statusSize > config->screenColumns)
-        statusSize = config->screenColumns;
+    editorStoreBuffer(config, &config->buffers[config->currentBuffer]);
+    editorLoadBuffer(config, &config->buffers[index]);
+    config->currentBuffer = index;
+    config->isSelecting = false;
+    EditorClearCursors(config);
 
-    ScreenBufferAppend(sbuf, status, statusSize);
+    if (config->load != NULL && config->load->isDone)
+        editorFinishLoad(config);
+}
 
-    for (int i = statusSize; i < config->screenColumns; i++)
+void    EditorOpenBuffer(EditorConfiguration *config, const char* filename, Syntax HLDB[])
+{
+    for (size_t i = 0; i < config->numberofBuffers; i++)
     {
-        if (config->screenColumns - i == cursorSize)
+        char* name = (i == config->currentBuffer) ? config->filename : config->buffers[i].filename;
+        if (name != NULL && !strcmp(name, filename))
         {
-            ScreenBufferAppend(sbuf, cursor, cursorSize);
-            break;
+            EditorSwitchBuffer(config, i);
+            return;
         }
-        else
-            ScreenBufferAppend(sbuf, " ", 1);
     }
 
-    ScreenBufferAppend(sbuf, "\x1b[m", 3);
-    ScreenBufferAppend(sbuf, "\r\n", 2);
+    if (access(filename, R_OK) == -1)
+    {
+        EditorSetStatusMessage(config, "Cannot open %s: %s", filename, strerror(errno));
+        return;
+    }
+
+    if (config->filename != NULL || config->textBuffer.numberofTextRows > 0)
+        EditorNewBuffer(config);
+
+    EditorOpenFile(config, filename, HLDB);
+    EditorTrimBufferCaches(config, EDITOR_INACTIVE_CACHE_BUDGET);
 }
 
-void    EditorDrawMessageBar(EditorConfiguration *config, ScreenBuffer* sbuf)
+void    EditorTrimBufferCaches(EditorConfiguration *config, size_t budget)
 {
+    // drop render and highlight caches of the least recently used buffers first
+    size_t cacheSize = 0;
+    for (size_t i = 0; i < config->numberofBuffers; i++)
+    {
+        if (i != config->currentBuffer && !config->buffers[i].isCacheDropped)
+            cacheSize += TextBufferCacheSize(&config->buffers[i].textBuffer);
+    }
 
-    ScreenBufferAppend(sbuf, "\x1b[K", 3);
-    int messageSize = strlen(config->statusMessage);
+    while (cacheSize > budget)
+    {
+        EditorBuffer* oldest = NULL;
+        for (size_t i = 0; i < config->numberofBuffers; i++)
+        {
+            EditorBuffer* buffer = &config->buffers[i];
+            if (i != config->currentBuffer && !buffer->isCacheDropped && (oldest == NULL || buffer->lastUsed < oldest->lastUsed))
+                oldest = buffer;
+        }
 
-    if (messageSize > config->screenColumns)
-        messageSize = config->screenColumns;
+        if (oldest == NULL)
+            break;
 
-    if (messageSize && time(NULL) - config->statusMessageTime < STATUS_MESSAGE_DELAY)
-        ScreenBufferAppend(sbuf, config->statusMessage, messageSize);
+        size_t size = TextBufferCacheSize(&oldest->textBuffer);
+        TextBufferDropCache(&oldest->textBuffer);
+        oldest->isCacheDropped = true;
+        cacheSize = (cacheSize > size) ? cacheSize - size : 0;
+    }
+}
+
+bool    EditorHasUnsavedBuffers(EditorConfiguration *config)
+{
+    for (size_t i = 0; i < config->numberofBuffers; i++)
+    {
+        bool isSaved = (i == config->currentBuffer) ? config->isSaved : config->buffers[i].isSaved;
+        bool isSaving = (i == config->currentBuffer) ? config->isSaving : config->buffers[i].isSaving;
+        if (!isSaved || isSaving)
+            return true;
+    }
+
+    return false;
+}
+
+void    EditorToggleFollow(EditorConfiguration *config)
+{
+    if (FollowerIsActive(&config->follower))
+    {
+        FollowerStop(&config->follower);
+        EditorSetStatusMessage(config, "Follow mode off.");
+        return;
+    }
+
+    if (config->filename == NULL)
+    {
+        EditorSetStatusMessage(config, "Follow mode needs a file on disk.");
+        return;
+    }
+
+    off_t offset;
+    if (ViewerIsActive(&config->viewer))
+        offset = config->viewer.fileSize;
+    else
+    {
+        struct stat info;
+        offset = (stat(config->filename, &info) == 0) ? info.st_size : 0;
+    }
+
+    if (FollowerStart(&config->follower, config->filename, offset) == -1)
+        EditorSetStatusMessage(config, "Follow failed! Error: %s", strerror(errno));
+    else
+        EditorSetStatusMessage(config, "Following %s", config->filename);
+}
+
+void    EditorFollowUpdate(EditorConfiguration *config)
+{
+    FileFollower* follower = &config->follower;
+    FileViewer* viewer = &config->viewer;
+    TextBuffer* tbuf = &config->textBuffer;
+
+    // the editor's own save is not news, the follower picks up from its end once it is written
+    if (config->isSaving)
+    {
+        FollowerResync(follower);
+        return;
+    }
+
+    int events = FollowerProcessEvents(follower);
+    if (events == FOLLOW_NONE)
+        return;
+
+    bool isViewer = ViewerIsActive(viewer);
+    size_t numberofLines = isViewer ? viewer->numberofLines : tbuf->numberofTextRows;
+    size_t absoluteCursor = (isViewer ? viewer->firstLine : 0) + config->cursorY;
+    bool isPastEnd = config->cursorY >= tbuf->numberofTextRows;
+    bool isPinned = absoluteCursor + 1 >= numberofLines;
+
+    if ((events & (FOLLOW_TRUNCATED | FOLLOW_ROTATED)) && !isViewer && !config->isSaved)
+    {
+        // reloading would throw the edits away, so following ends and the buffer stays as it is
+        FollowerStop(follower);
+        EditorSetStatusMessage(config, (events & FOLLOW_ROTATED) ? "File was rotated, follow stopped to keep unsaved changes." : "File was truncated, follow stopped to keep unsaved changes.");
+        return;
+    }
+
+    if (events & (FOLLOW_TRUNCATED | FOLLOW_ROTATED))
+    {
+        if (isViewer)
+        {
+            ViewerClose(viewer);
+            if (ViewerOpen(viewer, follower->path) == -1)
+                die("ViewerOpen");
+            follower->offset = viewer->fileSize;
+            ViewerLoadWindow(viewer, tbuf, 0);
+        }
+        else
+            TextBufferFree(tbuf);
+
+        config->cursorX = 0;
+        config->cursorY = 0;
+        config->rowOffset = 0;
+        config->columnOffset = 0;
+        isPinned = true;
+        EditorNotifyRowsChanged(config);
+
+        EditorSetStatusMessage(config, (events & FOLLOW_ROTATED) ? "File was rotated, reloaded." : "File was truncated, reloaded.");
+    }
+
+    char buffer[FOLLOW_READ_CHUNK];
+    ssize_t readSize;
+    size_t first = tbuf->numberofTextRows;
+    while ((readSize = FollowerRead(follower, buffer, sizeof(buffer))) > 0)
+    {
+        if (isViewer)
+        {
+            bool lineOpen = viewer->lineOpen;
+            bool isWindowAtEnd = viewer->firstLine + tbuf->numberofTextRows >= viewer->numberofLines;
+
+            ViewerIndexChunk(viewer, buffer, readSize);
+            if (isWindowAtEnd && tbuf->numberofTextRows < VIEWER_WINDOW_LINES)
+                TextBufferAppendData(tbuf, buffer, readSize, &lineOpen);
+        }
+        else
+            TextBufferAppendData(tbuf, buffer, readSize, &follower->lineOpen);
+    }
+
+    EditorNotifyRowsAppended(config, first);
+
+    if (!isPinned)
+        return;
+
+    if (isViewer)
+    {
+        size_t lastLine = (viewer->numberofLines > 0) ? viewer->numberofLines - 1 : 0;
+        if (lastLine >= viewer->firstLine + tbuf->numberofTextRows)
+        {
+            ViewerLoadWindow(viewer, tbuf, (lastLine > VIEWER_WINDOW_LINES / 2) ? lastLine - VIEWER_WINDOW_LINES / 2 : 0);
+            EditorNotifyRowsChanged(config);
+        }
+        config->cursorY = lastLine - viewer->firstLine;
+    }
+    else if (tbuf->numberofTextRows > 0)
+        config->cursorY = tbuf->numberofTextRows - (isPastEnd ? 0 : 1);
+
+    config->cursorX = 0;
+}
+
+void    EditorOpenStream(EditorConfiguration *config, int file)
+{
+    config->stream = StreamStart(file);
+    if (config->stream == NULL)
+    {
+        close(file);
+        EditorSetStatusMessage(config, "Cannot start reading the input stream.");
+    }
+}
+
+void    EditorStreamUpdate(EditorConfiguration *config)
+{
+    StreamReader* stream = config->stream;
+    bool isFinished;
+
+    // bounded per pass so keys still get through while a fast writer fills the queue
+    StreamChunk* chunks = StreamTake(stream, STREAM_INGEST_BUDGET, &isFinished);
+    size_t first = config->textBuffer.numberofTextRows;
+    for (StreamChunk* chunk = chunks; chunk != NULL; chunk = chunk->next)
+        TextBufferAppendData(&config->textBuffer, chunk->data, chunk->size, &stream->lineOpen);
+
+    StreamFreeChunks(chunks);
+    EditorNotifyRowsAppended(config, first);
+
+    if (!isFinished)
+        return;
+
+    if (stream->error != 0)
+        EditorSetStatusMessage(config, "Reading input failed! Error: %s", strerror(stream->error));
+    else
+        EditorSetStatusMessage(config, "Read %zu lines, %zu bytes", config->textBuffer.numberofTextRows, stream->totalBytes);
+
+    StreamStop(stream);
+    config->stream = NULL;
+}
+
+void    EditorToggleWrap(EditorConfiguration *config)
+{
+    if (config->filter.isEnabled)
+    {
+        EditorSetStatusMessage(config, "Soft wrap is off while lines are filtered.");
+        return;
+    }
+
+    config->wrap.isEnabled = !config->wrap.isEnabled;
+    config->wrapLineOffset = 0;
+    config->columnOffset = 0;
+    EditorSetStatusMessage(config, config->wrap.isEnabled ? "Soft wrap on." : "Soft wrap off.");
+}
+
+void    EditorToggleFilter(EditorConfiguration *config)
+{
+    if (config->filter.isEnabled)
+    {
+        FilterIndexSetQuery(&config->filter, NULL);
+        config->wrap.isEnabled = config->filter.wasWrapped;
+        config->wrapLineOffset = 0;
+        config->rowOffset = (config->cursorY > config->screenRows / 2) ? config->cursorY - config->screenRows / 2 : 0;
+        EditorSetStatusMessage(config, "Showing all lines.");
+        return;
+    }
+
+    if (ViewerIsActive(&config->viewer))
+    {
+        EditorSetStatusMessage(config, "Filtering needs the whole file loaded.");
+        return;
+    }
+
+    char* query = EditorPromptForInput(config, "Show lines matching: %s (ESC to cancel)", NULL);
+    if (query == NULL)
+        return;
+
+    FilterIndexSetQuery(&config->filter, query);
+    FilterIndexSync(&config->filter, &config->textBuffer);
+    config->filter.wasWrapped = config->wrap.isEnabled;
+    config->wrap.isEnabled = false;
+    config->wrapLineOffset = 0;
+
+    // the cursor moves to the first match at or after it, or the last one before it
+    size_t line = FilterIndexFindLine(&config->filter, config->cursorY);
+    if (line == config->filter.numberofRows && line > 0)
+        line--;
+
+    config->cursorY = FilterIndexGetRow(&config->filter, &config->textBuffer, line);
+    config->cursorX = 0;
+    config->rowOffset = config->cursorY;
+    config->columnOffset = 0;
+
+    EditorSetStatusMessage(config, "%zu of %zu lines match \"%s\" (Ctrl-K shows all).", config->filter.numberofRows, config->textBuffer.numberofTextRows, query);
+    free(query);
+}
+
+void    EditorTransformLines(EditorConfiguration *config)
+{
+    if (ViewerIsActive(&config->viewer))
+    {
+        EditorSetStatusMessage(config, "Read-only view: file is too large to edit.");
+        return;
+    }
+
+    if (FollowerIsActive(&config->follower) || config->stream != NULL)
+    {
+        EditorSetStatusMessage(config, "Lines are still arriving, stop following first.");
+        return;
+    }
+
+    // a selection limits the command to the rows it touches, a selection ending at the start of a row leaves that row out
+    size_t first = 0, last = config->textBuffer.numberofTextRows;
+    size_t startX, startY, endX, endY;
+    if (EditorGetSelection(config, &startX, &startY, &endX, &endY))
+    {
+        first = startY;
+        last = (endX == 0 && endY > startY) ? endY : endY + 1;
+    }
+
+    char* command = EditorPromptForInput(config, "Lines: %s (sort [-n] [-r], unique, reverse, delete TEXT, keep TEXT)", NULL);
+    if (command == NULL)
+        return;
+
+    size_t removed = 0;
+    bool isReordered = false;
+
+    if (strncmp(command, "sort", 4) == 0 && (command[4] == '\0' || command[4] == ' '))
+    {
+        int flags = 0;
+        for (char* option = strtok(&command[4], " "); option != NULL; option = strtok(NULL, " "))
+        {
+            if (option[0] != '-' || option[1] == '\0' || strspn(&option[1], "nr") != strlen(&option[1]))
+            {
+                EditorSetStatusMessage(config, "Unknown sort option: %s", option);
+                free(command);
+                return;
+            }
+
+            flags |= (strchr(option, 'n') != NULL) ? TRANSFORM_NUMERIC : 0;
+            flags |= (strchr(option, 'r') != NULL) ? TRANSFORM_REVERSE : 0;
+        }
+
+        TransformSortRows(&config->textBuffer, first, last, flags);
+        isReordered = true;
+        EditorSetStatusMessage(config, "Sorted %zu lines.", last - first);
+    }
+    else if (strcmp(command, "unique") == 0)
+    {
+        removed = TransformUniqueRows(&config->textBuffer, first, last);
+        EditorSetStatusMessage(config, "Removed %zu duplicate lines.", removed);
+    }
+    else if (strcmp(command, "reverse") == 0)
+    {
+        TransformReverseRows(&config->textBuffer, first, last);
+        isReordered = true;
+        EditorSetStatusMessage(config, "Reversed %zu lines.", last - first);
+    }
+    else if ((strncmp(command, "delete ", 7) == 0 || strncmp(command, "keep ", 5) == 0) && strchr(command, ' ')[1] != '\0')
+    {
+        bool isMatching = (command[0] == 'd');
+        removed = TransformDeleteRows(&config->textBuffer, first, last, strchr(command, ' ') + 1, isMatching);
+        EditorSetStatusMessage(config, "Deleted %zu lines.", removed);
+    }
+    else
+    {
+        EditorSetStatusMessage(config, "Unknown command: %s", command);
+        free(command);
+        return;
+    }
+
+    free(command);
+
+    if (removed > 0 || (isReordered && last - first > 1))
+    {
+        EditorNotifyRowsChanged(config);
+        config->isSaved = false;
+    }
+
+    EditorClearCursors(config);
+    config->isSelecting = false;
+    config->cursorY = (first < config->textBuffer.numberofTextRows) ? first : config->textBuffer.numberofTextRows;
+    config->cursorX = 0;
+}
+
+/******* Editor output ********/
+
+// the visual line a column of row y lands on with wrapping on, x is where it sits on that line
+static size_t editorVisualLine(EditorConfiguration *config, size_t y, size_t column, size_t* x)
+{
+    size_t line = WrapIndexGetLine(&config->wrap, y);
+    *x = column % config->wrap.width;
+    if (y < config->textBuffer.numberofTextRows)
+        line += WrapIndexLocate(&config->textBuffer.textRow[y], config->wrap.width, column, x);
+
+    return line;
+}
+
+void    EditorScroll(EditorConfiguration *config)
+{
+    if (ViewerSyncWindow(&config->viewer, &config->textBuffer, &config->cursorY, &config->rowOffset, config->screenRows * 2 + 1))
+        EditorNotifyRowsChanged(config);
+
+    config->renderX = 0;
+    if (config->cursorY < config->textBuffer.numberofTextRows)
+        config->renderX = TextRowGetRenderX(&config->textBuffer.textRow[config->cursorY], config->cursorX);
+
+    if (config->wrap.isEnabled)
+    {
+        WrapIndexSync(&config->wrap, &config->textBuffer, config->screenColumns);
+
+        size_t cursorX;
+        size_t cursorLine = editorVisualLine(config, config->cursorY, config->renderX, &cursorX);
+        size_t topLine = WrapIndexGetLine(&config->wrap, config->rowOffset) + config->wrapLineOffset;
+
+        if (cursorLine < topLine)
+            topLine = cursorLine;
+
+        if (cursorLine >= topLine + config->screenRows)
+            topLine = cursorLine - config->screenRows + 1;
+
+        config->rowOffset = WrapIndexFindRow(&config->wrap, topLine, &config->wrapLineOffset);
+        config->columnOffset = 0;
+        return;
+    }
+
+    if (config->filter.isEnabled)
+    {
+        FilterIndexSync(&config->filter, &config->textBuffer);
+        FilterIndexHoldRow(&config->filter, &config->textBuffer, config->cursorY);
+
+        size_t cursorLine = FilterIndexFindLine(&config->filter, config->cursorY);
+        size_t topLine = FilterIndexFindLine(&config->filter, config->rowOffset);
+
+        if (cursorLine < topLine)
+            topLine = cursorLine;
+
+        if (cursorLine >= topLine + config->screenRows)
+            topLine = cursorLine - config->screenRows + 1;
+
+        config->rowOffset = FilterIndexGetRow(&config->filter, &config->textBuffer, topLine);
+    }
+    else
+    {
+        if (config->cursorY < config->rowOffset)
+            config->rowOffset = config->cursorY;
+
+        if (config->cursorY >= config->rowOffset + config->screenRows)
+            config->rowOffset = config->cursorY - config->screenRows + 1;
+    }
+
+    if (config->renderX < config->columnOffset)
+        config->columnOffset = config->renderX;
+
+    if (config->renderX >= config->columnOffset + config->screenColumns)
+        config->columnOffset = config->renderX - config->screenColumns + 1;
+}
+
+void    EditorSetStatusMessage(EditorConfiguration *config, const char* fstring, ...)
+{
+    va_list arg;
+    va_start(arg, fstring);
+    vsnprintf(config->statusMessage, sizeof(config->statusMessage), fstring, arg);
+    va_end(arg);
+    config->statusMessageTime = time(NULL);
+}
+
+size_t  EditorDrawTextRow(ScreenBuffer* sbuf, TextRow* row, size_t start, size_t length, size_t selectionStart, size_t selectionEnd, const HighlightSpan* overlay)
+{
+    TextPosition position = TextRowSeek(row, POSITION_COLUMN, start);
+    size_t index = position.render;
+    size_t span = TextRowFindHighlight(row, index);
+    size_t column = position.column;
+    size_t end = start + length;
+    char* currentColor = NULL;
+    bool isSelected = false;
+
+    while (index < row->renderSize)
+    {
+        if (column >= start && isSelected != (index >= selectionStart && index < selectionEnd))
+        {
+            isSelected = !isSelected;
+            ScreenBufferAppend(sbuf, isSelected ? "\x1b[7m" : "\x1b[27m", isSelected ? 4 : 5);
+        }
+
+        while (span < row->numberofHighlights && row->highlights[span].start + row->highlights[span].length <= index)
+            span++;
+
+        HighlightClass highlight = HIGHLIGHT_NORMAL;
+        if (overlay != NULL && index >= overlay->start && index < overlay->start + overlay->length)
+            highlight = overlay->type;
+        else if (span < row->numberofHighlights && row->highlights[span].start <= index)
+            highlight = row->highlights[span].type;
+
+        unsigned char current = row->render[index];
+        unsigned int codepoint;
+        size_t charLength = Utf8Decode(&row->render[index], row->renderSize - index, &codepoint);
+        bool isInvalid = (charLength == 1 && current >= 0x80);
+        size_t width = (charLength == 1) ? 1 : Utf8CharWidth(codepoint);
+
+        if (column < start)
+        {
+            for (size_t i = start; i < column + width && i < end; i++)
+                ScreenBufferAppend(sbuf, " ", 1);
+            column += width;
+            index += charLength;
+            continue;
+        }
+
+        if (width > 0 && column + width > end)
+        {
+            for (size_t i = column; i < end; i++)
+                ScreenBufferAppend(sbuf, " ", 1);
+            break;
+        }
+
+        if (iscntrl(current) || isInvalid)
+        {
+            char symbol = (current <= 26) ? '@' + current : '?';
+            ScreenBufferAppend(sbuf, "\x1b[7m", 4);
+            ScreenBufferAppend(sbuf, &symbol, 1);
+            ScreenBufferAppend(sbuf, isSelected ? "\x1b[m\x1b[7m" : "\x1b[m", isSelected ? 7 : 3);
+            if (currentColor != NULL)
+            {
+                char buffer[16];
+                int len = snprintf(buffer, sizeof(buffer), "\x1b[%sm", currentColor);
+                ScreenBufferAppend(sbuf, buffer, len);
+            }
+        }
+        else if(highlight == HIGHLIGHT_NORMAL)
+        {
+            if(currentColor != NULL)
+            {
+                ScreenBufferAppend(sbuf, "\x1b[39m", 5);
+                currentColor = NULL;
+            }
+            ScreenBufferAppend(sbuf, &row->render[index], charLength);
+        }
+        else
+        {
+            char* color = getSyntaxColor(highlight);
+            if (color != currentColor)
+            {
+                currentColor = color;
+                char buffer[16];
+                int len = snprintf(buffer, sizeof(buffer), "\x1b[%sm", color);
+                ScreenBufferAppend(sbuf, buffer, len);
+            }
+            ScreenBufferAppend(sbuf, &row->render[index], charLength);
+        }
+
+        index += charLength;
+        column += width;
+    }
+
+    if (isSelected)
+        ScreenBufferAppend(sbuf, "\x1b[27m", 5);
+    ScreenBufferAppend(sbuf, "\x1b[39m", 5);
+    return column;
+}
+
+void    EditorDrawRows(EditorConfiguration *config, ScreenBuffer* sbuf, size_t* lineEnds)
+{
+    size_t fileRow = config->rowOffset;
+    size_t wrapLine = config->wrap.isEnabled ? config->wrapLineOffset : 0;
+    size_t wrapLines = 0, wrapStart = 0;
+    size_t filterLine = config->filter.isEnabled ? FilterIndexFindLine(&config->filter, fileRow) : 0;
+
+    size_t startX = 0, startY = 0, endX = 0, endY = 0;
+    bool isSelection = EditorGetSelection(config, &startX, &startY, &endX, &endY);
+
+    for (int i = 0; i < config->screenRows; i++)
+    {
+        if (fileRow >= config->textBuffer.numberofTextRows)
+        {
+            if (config->textBuffer.numberofTextRows == 0 && i == config->screenRows / 3)
+            {
+                char welcome[50];
+                int welcomelen = snprintf(welcome, sizeof(welcome), "Neo Text Editor -- version %s", NEO_VERSION);
+
+                if (welcomelen > config->screenColumns)
+                    welcomelen = config->screenColumns;
+
+                int padding = (config->screenColumns - welcomelen) / 2;
+                if (padding > 0)
+                {
+                    ScreenBufferAppend(sbuf, ">", 1);
+                    padding--;
+                }
+                while (padding)
+                {
+                    ScreenBufferAppend(sbuf, " ", 1);
+                    padding--;
+                }
+
+                ScreenBufferAppend(sbuf, welcome, welcomelen);
+            }
+            else
+                ScreenBufferAppend(sbuf, ">", 1);
+        }
+        else
+        {
+            TextRow* row = &config->textBuffer.textRow[fileRow];
+
+            size_t selectionStart = 0, selectionEnd = 0;
+            if (isSelection && fileRow >= startY && fileRow <= endY)
+            {
+                selectionStart = (fileRow == startY) ? TextRowSeek(row, POSITION_TEXT, startX).render : 0;
+                selectionEnd = (fileRow == endY) ? TextRowSeek(row, POSITION_TEXT, endX).render : row->renderSize;
+            }
+
+            const HighlightSpan* overlay = (fileRow == config->searchRow && config->searchHighlight.length > 0) ? &config->searchHighlight : NULL;
+
+            if (config->wrap.isEnabled)
+            {
+                // each line starts where the previous one stopped drawing, the row is laid out once on entry
+                if (wrapLines == 0)
+                {
+                    wrapLines = WrapIndexRowLines(row, config->wrap.width);
+                    wrapStart = WrapIndexLineStart(row, config->wrap.width, wrapLine);
+                }
+
+                wrapStart = EditorDrawTextRow(sbuf, row, wrapStart, config->wrap.width, selectionStart, selectionEnd, overlay);
+
+                wrapLine++;
+                if (wrapLine >= wrapLines)
+                {
+                    fileRow++;
+                    wrapLine = 0;
+                    wrapLines = 0;
+                }
+            }
+            else
+            {
+                EditorDrawTextRow(sbuf, row, config->columnOffset, config->screenColumns, selectionStart, selectionEnd, overlay);
+                fileRow = config->filter.isEnabled ? FilterIndexGetRow(&config->filter, &config->textBuffer, ++filterLine) : fileRow + 1;
+            }
+        }
+
+        ScreenBufferAppend(sbuf, "\x1b[K", 3);
+        lineEnds[i] = sbuf->size;
+    }
+}
+
+void    EditorDrawStatusBar(EditorConfiguration *config, ScreenBuffer* sbuf)
+{
+    ScreenBufferAppend(sbuf, "\x1b[7m", 4);
+
+    char* filename = (config->filename == NULL) ? "[No File Opened]" : config->filename;
+
+    char status[140], cursor[50];
+
+    bool isViewer = ViewerIsActive(&config->viewer);
+    size_t firstLine = isViewer ? config->viewer.firstLine : 0;
+    size_t numberofLines = isViewer ? config->viewer.numberofLines : config->textBuffer.numberofTextRows;
+
+    char* saveStatus = isViewer ? "[VIEW]" : (!config->isSaved ? "[UNSAVED]" : (config->isSaving ? "[SAVING]" : ""));
+    char* followStatus = FollowerIsActive(&config->follower) ? "[FOLLOW]" : ((config->stream != NULL || config->load != NULL) ? "[READING]" : "");
+    char* filterStatus = config->filter.isEnabled ? "[FILTER]" : "";
+    char bufferStatus[32] = "";
+    if (config->numberofBuffers > 1)
+        snprintf(bufferStatus, sizeof(bufferStatus), "[%zu/%zu] ", config->currentBuffer + 1, config->numberofBuffers);
+
+    int statusSize = snprintf(status, sizeof(status), "%s%s%s  %s%.50s ~ %ld lines", saveStatus, followStatus, filterStatus, bufferStatus, filename, numberofLines);
+
+    int cursorSize = snprintf(cursor, sizeof(cursor), "%ld:%ld", firstLine + config->cursorY + 1, config->cursorX + 1);
+
+    if (statusSize > config->screenColumns)
+        statusSize = config->screenColumns;
+
+    ScreenBufferAppend(sbuf, status, statusSize);
+
+    for (int i = statusSize; i < config->screenColumns; i++)
+    {
+        if (config->screenColumns - i == cursorSize)
+        {
+            ScreenBufferAppend(sbuf, cursor, cursorSize);
+            break;
+        }
+        else
+            ScreenBufferAppend(sbuf, " ", 1);
+    }
+
+    ScreenBufferAppend(sbuf, "\x1b[m", 3);
+}
+
+void    EditorDrawProfileOverlay(EditorConfiguration *config, ScreenBuffer* sbuf)
+{
+    char overlay[240];
+    int overlaySize = snprintf(overlay, sizeof(overlay),
+                               "frame %.2f/%.2fms in %.2f syn %.2f/%.2f draw %.2f/%.2f write %.2f/%.2f | %zu rows %zu allocs %zuB | %zu merged %zu dropped",
+                               ProfileLast(PROFILE_FRAME) / 1e6, ProfilePercentile(PROFILE_FRAME, 99) / 1e6,
+                               ProfileLast(PROFILE_INPUT) / 1e6,
+                               ProfileLast(PROFILE_SYNTAX) / 1e6, ProfilePercentile(PROFILE_SYNTAX, 99) / 1e6,
+                               ProfileLast(PROFILE_DRAW) / 1e6, ProfilePercentile(PROFILE_DRAW, 99) / 1e6,
+                               ProfileLast(PROFILE_WRITE) / 1e6, ProfilePercentile(PROFILE_WRITE, 99) / 1e6,
+                               profile.lastRowsHighlighted, profile.lastAllocations, profile.lastBytesWritten,
+                               atomic_load(&profile.framesMerged), atomic_load(&profile.framesDropped));
+
+    if (overlaySize > config->screenColumns)
+        overlaySize = config->screenColumns;
+
+    ScreenBufferAppend(sbuf, "\x1b[7m", 4);
+    ScreenBufferAppend(sbuf, overlay, overlaySize);
+    ScreenBufferAppend(sbuf, "\x1b[m", 3);
+}
+
+void    EditorDrawMessageBar(EditorConfiguration *config, ScreenBuffer* sbuf)
+{
+
+    ScreenBufferAppend(sbuf, "\x1b[K", 3);
+    if (profile.isOverlayVisible)
+    {
+        EditorDrawProfileOverlay(config, sbuf);
+        return;
+    }
+
+    int messageSize = strlen(config->statusMessage);
+
+    if (messageSize > config->screenColumns)
+        messageSize = config->screenColumns;
+
+    if (messageSize && time(NULL) - config->statusMessageTime < STATUS_MESSAGE_DELAY)
+        ScreenBufferAppend(sbuf, config->statusMessage, messageSize);
 }
 
 void    EditorRefreshScreen(EditorConfiguration *config)
 {
-    EditorScroll(config);
+    editorApplyResize(config);
+    ProfileBeginFrame();
+    EditorScroll(config);
+
+    if (config->filter.isEnabled)
+    {
+        // only rows in view are highlighted, the hidden ones between them just carry comment state forward
+        size_t topLine = FilterIndexFindLine(&config->filter, config->rowOffset);
+        for (size_t i = 0; i < config->screenRows; i++)
+        {
+            size_t row = FilterIndexGetRow(&config->filter, &config->textBuffer, topLine + i);
+            BracketIndexEnsureRows(&config->brackets, &config->textBuffer, row, row + 1);
+        }
+    }
+    else
+        BracketIndexEnsureRows(&config->brackets, &config->textBuffer, config->rowOffset, config->rowOffset + config->screenRows);
+
+    // the frame owns everything it shows, the render thread never looks at the editor
+    RenderFrame* frame = RenderFrameNew(config->screenRows + 2, config->screenColumns);
+    ScreenBuffer* sbuf = &frame->text;
+
+    uint64_t profileStart = ProfileStart();
+    EditorDrawRows(config, sbuf, frame->lineEnds);
+    ProfileStop(PROFILE_DRAW, profileStart);
+    EditorDrawStatusBar(config, sbuf);
+    frame->lineEnds[config->screenRows] = sbuf->size;
+    EditorDrawMessageBar(config, sbuf);
+    frame->lineEnds[config->screenRows + 1] = sbuf->size;
+    EditorDrawBrackets(config, sbuf);
+    EditorDrawCursors(config, sbuf);
+
+    size_t screenY = config->cursorY - config->rowOffset;
+    size_t screenX = config->renderX - config->columnOffset;
+    if (config->wrap.isEnabled)
+    {
+        screenY = editorVisualLine(config, config->cursorY, config->renderX, &screenX)
+                - WrapIndexGetLine(&config->wrap, config->rowOffset) - config->wrapLineOffset;
+    }
+    else if (config->filter.isEnabled)
+        screenY = FilterIndexFindLine(&config->filter, config->cursorY) - FilterIndexFindLine(&config->filter, config->rowOffset);
+
+    frame->cursorX = screenX;
+    frame->cursorY = screenY;
+
+    RenderPublish(frame);
+    ProfileEndFrame();
+}
+
+/******* input ********/
+
+bool    EditorWaitForInput(EditorConfiguration *config)
+{
+    struct pollfd descriptors[6] = {
+        { STDIN_FILENO, POLLIN, 0 },
+        { (config->load == NULL) ? config->follower.notify : -1, POLLIN, 0 },
+        { (config->stream != NULL) ? config->stream->notify : -1, POLLIN, 0 },
+        { pool.notify, POLLIN, 0 },
+        { disk.notify, POLLIN, 0 },
+        { config->memoryPressure, POLLPRI, 0 }
+    };
+
+    // negative descriptors are skipped by poll
+    if (poll(descriptors, 6, -1) == -1)
+    {
+        if (errno == EINTR)
+            return false;
+        die("poll");
+    }
+
+    if (descriptors[1].revents & POLLIN)
+        EditorFollowUpdate(config);
+
+    if (descriptors[2].revents & POLLIN)
+        EditorStreamUpdate(config);
+
+    if (descriptors[3].revents & POLLIN)
+        PoolDispatch();
+
+    if (descriptors[4].revents & POLLIN)
+        DiskDispatch();
+
+    if (config->load != NULL && config->load->isDone)
+        editorFinishLoad(config);
+
+    // under memory pressure every buffer out of view gives up its render and highlight caches
+    if (descriptors[5].revents & POLLPRI)
+        EditorTrimBufferCaches(config, 0);
+    else if (descriptors[5].revents & (POLLERR | POLLNVAL))
+    {
+        close(config->memoryPressure);
+        config->memoryPressure = -1;
+    }
+
+    return (descriptors[0].revents & POLLIN) != 0;
+}
+
+char*   EditorPromptForInput(EditorConfiguration *config, char* prompt, void (*callBackFunction)(EditorConfiguration*, char*, int))
+{
+    int maxBufferSize = 150;
+    char* buffer = malloc(maxBufferSize);
+    buffer[0] = '\0';
+    int bufferSize = 0;
+
+    while (1)
+    {
+        EditorSetStatusMessage(config, prompt, buffer);
+        EditorRefreshScreen(config);
+
+        short int input = readKeypress();
+
+        if (input == DELETE_KEY || input == CTRL_KEY('h') || input == BACKSPACE)
+        {
+            if (bufferSize > 0)
+            {
+                bufferSize--;
+                buffer[bufferSize] = '\0';
+            }
+        }
+        else if (input == '\x1b')
+        {
+            EditorSetStatusMessage(config, "");
+
+            if (callBackFunction)
+                callBackFunction(config, buffer, input);
+
+            free(buffer);
+            return NULL;
+        }
+        else if (input == '\r')
+        {
+            if(bufferSize > 0)
+            {
+                EditorSetStatusMessage(config, "");
+
+                if (callBackFunction)
+                    callBackFunction(config, buffer, input);
+
+                return buffer;
+            }
+        }
+        else if (!iscntrl(input) && input < 128)
+        {
+            if (bufferSize == maxBufferSize - 1)
+            {
+                maxBufferSize *= 2;
+                buffer = realloc(buffer, maxBufferSize);
+                if (buffer == NULL)
+                    die("realloc");
+            }
+            buffer[bufferSize] = input;
+            bufferSize++;
+            buffer[bufferSize] = '\0';
+        }
+
+        if(callBackFunction)
+            callBackFunction(config, buffer, input);
+    }
+}
+
+// steps a number of lines through the view, rows hidden by a filter are skipped
+static size_t editorStepRow(EditorConfiguration *config, size_t index, ssize_t lines)
+{
+    size_t line = index, numberofLines = config->textBuffer.numberofTextRows;
+    if (config->filter.isEnabled)
+    {
+        FilterIndexSync(&config->filter, &config->textBuffer);
+        line = FilterIndexFindLine(&config->filter, index);
+        numberofLines = config->filter.numberofRows;
+    }
+
+    if (lines < 0 && (size_t)-lines > line)
+        line = 0;
+    else
+        line += lines;
+
+    if (line > numberofLines)
+        line = numberofLines;
+
+    return config->filter.isEnabled ? FilterIndexGetRow(&config->filter, &config->textBuffer, line) : line;
+}
+
+void    EditorMoveCursor(EditorConfiguration *config, short int key)
+{
+    TextRow* row = (config->cursorY >= config->textBuffer.numberofTextRows)
+                   ? NULL
+                   : &config->textBuffer.textRow[config->cursorY];
+    size_t renderX = (row != NULL) ? TextRowGetRenderX(row, config->cursorX) : 0;
+    size_t cursorY = config->cursorY;
+
+    switch (key)
+    {
+        case ARROW_LEFT:
+            if (config->cursorX != 0)
+                config->cursorX = TextRowPreviousChar(row, config->cursorX);
+            else if (editorStepRow(config, config->cursorY, -1) != config->cursorY)
+            {
+                config->cursorY = editorStepRow(config, config->cursorY, -1);
+                config->cursorX = config->textBuffer.textRow[config->cursorY].textSize;
+            }
+            break;
+        case ARROW_RIGHT:
+            if (row != NULL && config->cursorX < row->textSize)
+                config->cursorX = TextRowNextChar(row, config->cursorX);
+            else if (row != NULL && config->cursorX == row->textSize)
+            {
+                config->cursorY = editorStepRow(config, config->cursorY, 1);
+                config->cursorX = 0;
+            }
+            break;
+        case ARROW_UP:
+            if (config->wrap.isEnabled)
+                EditorMoveCursorVisual(config, -1);
+            else
+                config->cursorY = editorStepRow(config, config->cursorY, -1);
+            break;
+        case ARROW_DOWN:
+            if (config->wrap.isEnabled)
+                EditorMoveCursorVisual(config, 1);
+            else
+                config->cursorY = editorStepRow(config, config->cursorY, 1);
+            break;
+    }
+
+    row = (config->cursorY >= config->textBuffer.numberofTextRows)
+          ? NULL
+          : &config->textBuffer.textRow[config->cursorY];
+
+    if ((key == ARROW_UP || key == ARROW_DOWN) && config->cursorY != cursorY && !config->wrap.isEnabled)
+        config->cursorX = (row != NULL) ? TextRowGetCursorX(row, renderX) : 0;
+
+    size_t rowSize = (row != NULL) ? row->textSize : 0;
+    if (config->cursorX > rowSize)
+        config->cursorX = rowSize;
+}
+
+void    EditorMoveCursorVisual(EditorConfiguration *config, ssize_t lines)
+{
+    WrapIndexSync(&config->wrap, &config->textBuffer, config->screenColumns);
+
+    TextBuffer* tbuf = &config->textBuffer;
+    size_t width = config->wrap.width;
+    size_t renderX = (config->cursorY < tbuf->numberofTextRows) ? TextRowGetRenderX(&tbuf->textRow[config->cursorY], config->cursorX) : 0;
+    size_t screenX;
+    size_t line = editorVisualLine(config, config->cursorY, renderX, &screenX);
+    size_t lastLine = WrapIndexGetLine(&config->wrap, tbuf->numberofTextRows);
+
+    if (lines < 0 && (size_t)-lines > line)
+        line = 0;
+    else
+        line += lines;
+
+    if (line > lastLine)
+        line = lastLine;
+
+    size_t lineInRow;
+    config->cursorY = WrapIndexFindRow(&config->wrap, line, &lineInRow);
+    if (config->cursorY >= tbuf->numberofTextRows)
+    {
+        config->cursorX = 0;
+        return;
+    }
+
+    // a line cut short by a wide character keeps the cursor on its last column
+    TextRow* row = &tbuf->textRow[config->cursorY];
+    size_t column = WrapIndexLineStart(row, width, lineInRow) + screenX;
+    if (lineInRow + 1 < WrapIndexRowLines(row, width))
+    {
+        size_t next = WrapIndexLineStart(row, width, lineInRow + 1);
+        if (column >= next)
+            column = next - 1;
+    }
+
+    config->cursorX = TextRowGetCursorX(row, column);
+}
+
+void    EditorGoToLine(EditorConfiguration *config, size_t line)
+{
+    bool isViewer = ViewerIsActive(&config->viewer);
+    size_t numberofLines = isViewer ? config->viewer.numberofLines : config->textBuffer.numberofTextRows;
+    if (line >= numberofLines)
+        line = (numberofLines > 0) ? numberofLines - 1 : 0;
+
+    if (isViewer && (line < config->viewer.firstLine || line >= config->viewer.firstLine + config->textBuffer.numberofTextRows))
+    {
+        ViewerLoadWindow(&config->viewer, &config->textBuffer, (line > VIEWER_WINDOW_LINES / 2) ? line - VIEWER_WINDOW_LINES / 2 : 0);
+        EditorNotifyRowsChanged(config);
+    }
+
+    config->cursorY = line - (isViewer ? config->viewer.firstLine : 0);
+    if (config->cursorY > config->textBuffer.numberofTextRows)
+        config->cursorY = config->textBuffer.numberofTextRows;
+    config->cursorX = 0;
+    config->rowOffset = (config->cursorY > config->screenRows / 2) ? config->cursorY - config->screenRows / 2 : 0;
+    config->columnOffset = 0;
+    config->wrapLineOffset = 0;
+}
+
+void    EditorGoToPrompt(EditorConfiguration *config)
+{
+    char* target = EditorPromptForInput(config, "Go to line: %s (N, N%%, ^ or $)", NULL);
+    if (target == NULL)
+        return;
+
+    bool isViewer = ViewerIsActive(&config->viewer);
+    size_t numberofLines = isViewer ? config->viewer.numberofLines : config->textBuffer.numberofTextRows;
+    size_t line = 0;
+    char* end;
+
+    if (!strcmp(target, "$"))
+        line = SIZE_MAX;
+    else if (strcmp(target, "^") != 0)
+    {
+        unsigned long long number = strtoull(target, &end, 10);
+        if (end == target || (*end != '\0' && strcmp(end, "%") != 0))
+        {
+            EditorSetStatusMessage(config, "Not a line number: %s", target);
+            free(target);
+            return;
+        }
+
+        if (*end == '%')
+            line = (number >= 100 || numberofLines == 0) ? SIZE_MAX : (size_t)((double)number / 100 * (numberofLines - 1));
+        else
+            line = (number > 0) ? number - 1 : 0;
+    }
+
+    EditorGoToLine(config, line);
+    free(target);
+}
+
+void    EditorProcessKeypress(EditorConfiguration *config, Syntax HLDB[])
+{
+    static bool isQuiting = false;
+
+    ProfileBeginFrame();
+    uint64_t profileStart = ProfileStart();
+    short int input = readKeypress();
+    ProfileStop(PROFILE_INPUT, profileStart);
+
+    // until the file is read only quitting and moving between buffers make sense
+    if (config->load != NULL && input != CTRL_KEY('q') && input != CTRL_KEY('o') && input != CTRL_KEY('n') && input != CTRL_KEY('b'))
+    {
+        EditorSetStatusMessage(config, "Still reading %s...", config->filename);
+        return;
+    }
+
+    bool isShifted = true;
+    switch (input)
+    {
+        case SHIFT_ARROW_LEFT:  input = ARROW_LEFT;  break;
+        case SHIFT_ARROW_RIGHT: input = ARROW_RIGHT; break;
+        case SHIFT_ARROW_UP:    input = ARROW_UP;    break;
+        case SHIFT_ARROW_DOWN:  input = ARROW_DOWN;  break;
+        case SHIFT_HOME_KEY:    input = HOME_KEY;    break;
+        case SHIFT_END_KEY:     input = END_KEY;     break;
+        default:                isShifted = false;   break;
+    }
+
+    if (isShifted)
+        EditorClearCursors(config);
+    else if (config->numberofCursors > 0 && EditorProcessCursorsKeypress(config, input))
+    {
+        isQuiting = false;
+        return;
+    }
+
+    if (isShifted && !config->isSelecting)
+    {
+        config->isSelecting = true;
+        config->selectionX = config->cursorX;
+        config->selectionY = config->cursorY;
+    }
+    else if (!isShifted && (input == ARROW_LEFT || input == ARROW_RIGHT || input == ARROW_UP || input == ARROW_DOWN ||
+                            input == HOME_KEY || input == END_KEY || input == PAGE_UP || input == PAGE_DOWN || input == '\x1b'))
+        config->isSelecting = false;
+
+    switch (input)
+    {
+        case '\r':
+            EditorInsertNewLine(config);
+            break;
+
+        case CTRL_KEY('s'):
+            EditorSaveToFile(config, HLDB);
+            break;
+
+        case CTRL_KEY('f'):
+            EditorFind(config);
+            break;
+
+        case CTRL_KEY('t'):
+            EditorToggleFollow(config);
+            break;
+
+        case CTRL_KEY('w'):
+            EditorToggleWrap(config);
+            break;
+
+        case CTRL_KEY('k'):
+            EditorToggleFilter(config);
+            break;
+
+        case CTRL_KEY('e'):
+            EditorTransformLines(config);
+            break;
+
+        case CTRL_KEY('o'):
+        {
+            char* filename = EditorPromptForInput(config, "Open file: %s", NULL);
+            if (filename != NULL)
+            {
+                EditorOpenBuffer(config, filename, HLDB);
+                free(filename);
+            }
+            break;
+        }
+
+        case CTRL_KEY('n'):
+            EditorSwitchBuffer(config, (config->currentBuffer + 1) % config->numberofBuffers);
+            break;
+
+        case CTRL_KEY('b'):
+            EditorSwitchBuffer(config, (config->currentBuffer + config->numberofBuffers - 1) % config->numberofBuffers);
+            break;
+
+        case CTRL_KEY('a'):
+            EditorSelectAll(config);
+            break;
+
+        case CTRL_KEY('d'):
+            EditorAddCursorBelow(config);
+            break;
+
+        case CTRL_KEY('g'):
+            EditorGoToPrompt(config);
+            break;
+
+        case CTRL_KEY(']'):
+            EditorJumpToBracket(config);
+            break;
+
+        case CTRL_HOME_KEY:
+            EditorGoToLine(config, 0);
+            break;
+
+        case CTRL_END_KEY:
+            EditorGoToLine(config, SIZE_MAX);
+            break;
+
+        case CTRL_KEY('c'):
+            EditorCopy(config);
+            break;
+
+        case CTRL_KEY('x'):
+            EditorCut(config);
+            break;
+
+        case CTRL_KEY('v'):
+            EditorPaste(config);
+            break;
+
+        case CTRL_KEY('p'):
+            profile.isOverlayVisible = !profile.isOverlayVisible;
+            profile.isEnabled = true;
+            break;
+
+        case CTRL_KEY('q'):
+            if (EditorHasUnsavedBuffers(config) && !isQuiting)
+            {
+                EditorSetStatusMessage(config, "File has unsaved changes! Press Ctrl-Q again to quit anyways.");
+                isQuiting = true;
+                return;
+            }
+
+            RenderStop();
+            TerminalWrite("\x1b[2J", 4);
+            TerminalWrite("\x1b[H", 3);
+            //EditorKill(config);
+            exit(0);
+            break;
+
+        case HOME_KEY:
+            config->cursorX = 0;
+            break;
+
+        case END_KEY:
+            if (config->cursorY < config->textBuffer.numberofTextRows)
+                config->cursorX = config->textBuffer.textRow[config->cursorY].textSize;
+            break;
+
+        case BACKSPACE:
+        case CTRL_KEY('h'):
+        case DELETE_KEY:
+            if (EditorDeleteSelection(config))
+                break;
+            if (input == DELETE_KEY)
+                EditorMoveCursor(config, ARROW_RIGHT);
+            EditorDeleteChar(config);
+            break;
+
+        case PAGE_UP:
+        case PAGE_DOWN:
+            if (config->wrap.isEnabled)
+            {
+                size_t cursorX;
+                ssize_t cursorLine = editorVisualLine(config, config->cursorY, config->renderX, &cursorX);
+                ssize_t topLine = WrapIndexGetLine(&config->wrap, config->rowOffset) + config->wrapLineOffset;
+
+                if (input == PAGE_UP)
+                    EditorMoveCursorVisual(config, topLine - cursorLine - config->screenRows);
+                else
+                    EditorMoveCursorVisual(config, topLine + 2 * config->screenRows - 1 - cursorLine);
+                break;
+            }
+
+            {
+                size_t renderX = config->renderX;
+                if (input == PAGE_UP)
+                    config->cursorY = editorStepRow(config, config->rowOffset, -(ssize_t)config->screenRows);
+                else
+                    config->cursorY = editorStepRow(config, config->rowOffset, 2 * config->screenRows - 1);
+
+                config->cursorX = (config->cursorY < config->textBuffer.numberofTextRows)
+                                  ? TextRowGetCursorX(&config->textBuffer.textRow[config->cursorY], renderX)
+                                  : 0;
+            }
+            break;
+
+        case ARROW_UP:
+        case ARROW_DOWN:
+        case ARROW_LEFT:
+        case ARROW_RIGHT:
+            EditorMoveCursor(config, input);
+            break;
+
+        case CTRL_KEY('l'):
+        case '\x1b':
+            break;
+
+        default:
+            EditorInsertChar(config, input);
+            break;
+    }
+
+    isQuiting = false;
+}
+
+
+/******* Editor operations ********/
+
+void    EditorNotifyRowChanged(EditorConfiguration *config, size_t index)
+{
+    TextBuffer* tbuf = &config->textBuffer;
+    if (index + 1 < tbuf->numberofTextRows && tbuf->textRow[index + 1].incomingComment != tbuf->textRow[index].openComment)
+        TextBufferUpdateSyntax(tbuf, index + 1);
+
+    WrapIndexUpdateRow(&config->wrap, &config->textBuffer, index);
+    BracketIndexUpdateRow(&config->brackets, tbuf, index);
+    FilterIndexUpdateRow(&config->filter, tbuf, index);
+}
+
+void    EditorNotifyRowsChanged(EditorConfiguration *config)
+{
+    WrapIndexInvalidate(&config->wrap);
+    BracketIndexInvalidate(&config->brackets);
+    FilterIndexInvalidate(&config->filter);
+}
+
+void    EditorNotifyRowsInserted(EditorConfiguration *config, size_t index, size_t count)
+{
+    if (count == 0)
+        return;
+
+    WrapIndexInsertRows(&config->wrap, &config->textBuffer, index, count);
+    BracketIndexInsertRows(&config->brackets, &config->textBuffer, index, count);
+    FilterIndexInsertRows(&config->filter, &config->textBuffer, index, count);
+}
+
+void    EditorNotifyRowsDeleted(EditorConfiguration *config, size_t index, size_t count)
+{
+    if (count == 0)
+        return;
+
+    WrapIndexDeleteRows(&config->wrap, index, count);
+    BracketIndexDeleteRows(&config->brackets, index, count);
+    FilterIndexDeleteRows(&config->filter, index, count);
+}
+
+// rows from first on were added at the end, the open line before them may have grown as well
+void    EditorNotifyRowsAppended(EditorConfiguration *config, size_t first)
+{
+    if (first > 0)
+        EditorNotifyRowChanged(config, first - 1);
+
+    EditorNotifyRowsInserted(config, first, config->textBuffer.numberofTextRows - first);
+}
+
+void    EditorInsertChar(EditorConfiguration *config, short int input)
+{
+    if (ViewerIsActive(&config->viewer))
+        return;
+
+    EditorDeleteSelection(config);
+
+    if (config->cursorY == config->textBuffer.numberofTextRows)
+    {
+        TextBufferInsertTextRow(&config->textBuffer, config->textBuffer.numberofTextRows, "", 0);
+        EditorNotifyRowsInserted(config, config->textBuffer.numberofTextRows - 1, 1);
+    }
+
+    TextRowInsertChar(&config->textBuffer.textRow[config->cursorY], config->cursorX, input, config->textBuffer.syntax);
+    EditorNotifyRowChanged(config, config->cursorY);
+    config->isSaved = false;
+    config->cursorX++;
+}
+
+void    EditorInsertNewLine(EditorConfiguration *config)
+{
+    if (ViewerIsActive(&config->viewer))
+        return;
+
+    EditorDeleteSelection(config);
+
+    if (config->cursorX == 0)
+    {
+        TextBufferInsertTextRow(&config->textBuffer, config->cursorY, "", 0);
+        EditorNotifyRowsInserted(config, config->cursorY, 1);
+    }
+    else
+    {
+        TextRow* row = &config->textBuffer.textRow[config->cursorY];
+        TextBufferInsertTextRow(&config->textBuffer, config->cursorY + 1, &row->text[config->cursorX], row->textSize - config->cursorX);
+        row = &config->textBuffer.textRow[config->cursorY];
+        TextRowMakeWritable(row);
+        row->textSize = config->cursorX;
+        row->text[row->textSize] = '\0';
+        TextRowUpdateRender(row);
+        TextBufferUpdateSyntax(&config->textBuffer, config->cursorY);
+        EditorNotifyRowsInserted(config, config->cursorY + 1, 1);
+        EditorNotifyRowChanged(config, config->cursorY);
+    }
+
+    config->cursorY++;
+    config->cursorX = 0;
+    config->isSaved = false;
+}
+
+void    EditorDeleteChar(EditorConfiguration *config)
+{
+    if (ViewerIsActive(&config->viewer))
+        return;
+
+    if (config->cursorX == 0 && config->cursorY == 0)
+        return;
+
+    if (config->cursorY == config->textBuffer.numberofTextRows)
+        return;
+
+    TextRow* row = &config->textBuffer.textRow[config->cursorY];
+    if (config->cursorX > 0)
+    {
+        size_t start = TextRowPreviousChar(row, config->cursorX);
+        TextRowDeleteRange(row, start, config->cursorX - start, config->textBuffer.syntax);
+        EditorNotifyRowChanged(config, config->cursorY);
+        config->isSaved = false;
+        config->cursorX = start;
+    }
+    else
+    {
+        config->cursorX = config->textBuffer.textRow[config->cursorY - 1].textSize;
+        TextRowAppendString(&config->textBuffer.textRow[config->cursorY - 1], row->text, row->textSize, config->textBuffer.syntax);
+        TextBufferDeleteTextRow(&config->textBuffer, config->cursorY);
+        EditorNotifyRowsDeleted(config, config->cursorY, 1);
+        EditorNotifyRowChanged(config, config->cursorY - 1);
+        config->isSaved = false;
+        config->cursorY--;
+    }
+}
+
+/******* multiple cursors ********/
+
+void    EditorAddCursor(EditorConfiguration *config, size_t x, size_t y)
+{
+    if (config->numberofCursors == config->cursorCapacity)
+    {
+        config->cursorCapacity = (config->cursorCapacity == 0) ? 16 : config->cursorCapacity * 2;
+        EditorCursor* temp = realloc(config->cursors, sizeof(EditorCursor) * config->cursorCapacity);
+        if (temp == NULL)
+            die("realloc");
+        config->cursors = temp;
+    }
+
+    config->cursors[config->numberofCursors] = (EditorCursor){ x, y };
+    config->numberofCursors++;
+}
+
+void    EditorClearCursors(EditorConfiguration *config)
+{
+    free(config->cursors);
+    config->cursors = NULL;
+    config->numberofCursors = 0;
+    config->cursorCapacity = 0;
+}
+
+void    EditorAddCursorBelow(EditorConfiguration *config)
+{
+    size_t startX, startY, endX, endY;
+    if (EditorGetSelection(config, &startX, &startY, &endX, &endY) && startY != endY)
+    {
+        // one cursor per selected line, in the column of the primary cursor
+        size_t renderX = (config->cursorY < config->textBuffer.numberofTextRows)
+                         ? TextRowGetRenderX(&config->textBuffer.textRow[config->cursorY], config->cursorX)
+                         : 0;
+
+        for (size_t y = startY; y <= endY && y < config->textBuffer.numberofTextRows; y++)
+        {
+            if (y != config->cursorY && (!config->filter.isEnabled || FilterIndexHasRow(&config->filter, y)))
+                EditorAddCursor(config, TextRowGetCursorX(&config->textBuffer.textRow[y], renderX), y);
+        }
+
+        config->isSelecting = false;
+    }
+    else
+    {
+        size_t x = config->cursorX, y = config->cursorY;
+        EditorMoveCursor(config, ARROW_DOWN);
+        if (config->cursorY != y && config->cursorY < config->textBuffer.numberofTextRows)
+            EditorAddCursor(config, x, y);
+        else
+        {
+            config->cursorX = x;
+            config->cursorY = y;
+        }
+    }
+
+    EditorSetStatusMessage(config, "%zu cursors (ESC to leave).", config->numberofCursors + 1);
+}
+
+static int compareCursors(const void* a, const void* b)
+{
+    const EditorCursor* first = a;
+    const EditorCursor* second = b;
+    if (first->y != second->y)
+        return (first->y > second->y) - (first->y < second->y);
+
+    return (first->x > second->x) - (first->x < second->x);
+}
+
+static void editorSortCursors(EditorConfiguration *config)
+{
+    qsort(config->cursors, config->numberofCursors, sizeof(EditorCursor), compareCursors);
+
+    size_t count = 0;
+    for (size_t i = 0; i < config->numberofCursors; i++)
+    {
+        EditorCursor* cursor = &config->cursors[i];
+        bool isPrimary = (cursor->x == config->cursorX && cursor->y == config->cursorY);
+        if (!isPrimary && (count == 0 || compareCursors(&config->cursors[count - 1], cursor) != 0))
+            config->cursors[count++] = *cursor;
+    }
+
+    config->numberofCursors = count;
+}
+
+void    EditorMoveCursors(EditorConfiguration *config, short int key)
+{
+    size_t primaryX = config->cursorX, primaryY = config->cursorY;
+
+    for (size_t i = 0; i <= config->numberofCursors; i++)
+    {
+        if (i < config->numberofCursors)
+        {
+            config->cursorX = config->cursors[i].x;
+            config->cursorY = config->cursors[i].y;
+        }
+        else
+        {
+            config->cursorX = primaryX;
+            config->cursorY = primaryY;
+        }
+
+        if (key == HOME_KEY)
+            config->cursorX = 0;
+        else if (key == END_KEY)
+            config->cursorX = (config->cursorY < config->textBuffer.numberofTextRows) ? config->textBuffer.textRow[config->cursorY].textSize : 0;
+        else
+            EditorMoveCursor(config, key);
+
+        if (i < config->numberofCursors)
+            config->cursors[i] = (EditorCursor){ config->cursorX, config->cursorY };
+    }
+
+    editorSortCursors(config);
+}
+
+void    EditorEditCursors(EditorConfiguration *config, short int key)
+{
+    if (ViewerIsActive(&config->viewer))
+        return;
+
+    TextBuffer* tbuf = &config->textBuffer;
+    char insert = (char)key;
+    size_t insertSize = (key == BACKSPACE || key == CTRL_KEY('h') || key == DELETE_KEY) ? 0 : 1;
+
+    EditorAddCursor(config, config->cursorX, config->cursorY);
+    size_t count = config->numberofCursors;
+    qsort(config->cursors, count, sizeof(EditorCursor), compareCursors);
+
+    TextRange* ranges = malloc(sizeof(TextRange) * count);
+    if (ranges == NULL)
+        die("malloc");
+
+    size_t primaryX = config->cursorX, primaryY = config->cursorY;
+
+    // cursors are grouped by row so each touched row is rebuilt and re-highlighted once
+    for (size_t first = 0, last; first < count; first = last)
+    {
+        size_t y = config->cursors[first].y;
+        for (last = first; last < count && config->cursors[last].y == y; last++)
+            ;
+
+        if (y >= tbuf->numberofTextRows)
+            continue;
+
+        TextRow* row = &tbuf->textRow[y];
+        size_t numberofRanges = 0;
+        ssize_t shift = 0;
+        size_t previousX = SIZE_MAX;
+
+        for (size_t i = first; i < last; i++)
+        {
+            EditorCursor* cursor = &config->cursors[i];
+            bool isPrimary = (y == primaryY && cursor->x == primaryX);
+            size_t x = (cursor->x > row->textSize) ? row->textSize : cursor->x;
+
+            if (x == previousX)
+                cursor->x = config->cursors[i - 1].x;
+            else
+            {
+                TextRange range = { x, x };
+                if (insertSize == 0 && key != DELETE_KEY && x > 0)
+                    range.start = TextRowPreviousChar(row, x);
+                else if (key == DELETE_KEY && x < row->textSize)
+                    range.end = TextRowNextChar(row, x);
+
+                bool isEdit = (insertSize > 0 || range.start != range.end);
+                cursor->x = (isEdit ? range.start + insertSize : x) + shift;
+
+                if (isEdit)
+                {
+                    ranges[numberofRanges++] = range;
+                    shift += insertSize - (range.end - range.start);
+                }
+                previousX = x;
+            }
+
+            if (isPrimary)
+                config->cursorX = cursor->x;
+        }
+
+        if (numberofRanges > 0)
+        {
+            TextRowReplaceRanges(row, ranges, numberofRanges, &insert, insertSize, tbuf->syntax);
+            EditorNotifyRowChanged(config, y);
+            config->isSaved = false;
+        }
+    }
+
+    free(ranges);
+    editorSortCursors(config);
+}
+
+bool    EditorProcessCursorsKeypress(EditorConfiguration *config, short int key)
+{
+    switch (key)
+    {
+        case ARROW_UP:
+        case ARROW_DOWN:
+        case ARROW_LEFT:
+        case ARROW_RIGHT:
+        case HOME_KEY:
+        case END_KEY:
+            EditorMoveCursors(config, key);
+            return true;
+
+        case BACKSPACE:
+        case CTRL_KEY('h'):
+        case DELETE_KEY:
+            EditorEditCursors(config, key);
+            return true;
+
+        case CTRL_KEY('d'):
+            EditorAddCursorBelow(config);
+            return true;
+
+        case CTRL_KEY('s'):
+        case CTRL_KEY('q'):
+        case CTRL_KEY('p'):
+            return false;
+
+        case '\x1b':
+            EditorClearCursors(config);
+            return true;
+    }
+
+    if ((key >= 32 || key < 0 || key == '\t') && key != BACKSPACE && key < ARROW_LEFT)
+    {
+        EditorEditCursors(config, key);
+        return true;
+    }
+
+    EditorClearCursors(config);
+    return false;
+}
+
+// index is the render byte under the marker, column the screen column it starts at
+static void editorDrawMarker(EditorConfiguration *config, ScreenBuffer* sbuf, size_t y, size_t index, size_t column, const char* style)
+{
+    TextBuffer* tbuf = &config->textBuffer;
+    if (y < config->rowOffset || y >= tbuf->numberofTextRows)
+        return;
+
+    TextRow* row = &tbuf->textRow[y];
+    size_t screenY, screenX;
+
+    if (config->wrap.isEnabled)
+    {
+        size_t topLine = WrapIndexGetLine(&config->wrap, config->rowOffset) + config->wrapLineOffset;
+        size_t line = editorVisualLine(config, y, column, &screenX);
+        if (line < topLine)
+            return;
+        screenY = line - topLine;
+    }
+    else
+    {
+        if (column < config->columnOffset || (config->filter.isEnabled && !FilterIndexHasRow(&config->filter, y)))
+            return;
+        screenY = config->filter.isEnabled ? FilterIndexFindLine(&config->filter, y) - FilterIndexFindLine(&config->filter, config->rowOffset)
+                                           : y - config->rowOffset;
+        screenX = column - config->columnOffset;
+    }
+
+    if (screenY >= config->screenRows || screenX >= config->screenColumns)
+        return;
+
+    size_t charLength = 1;
+    const char* character = " ";
+    if (index < row->renderSize && !iscntrl((unsigned char)row->render[index]))
+    {
+        unsigned int codepoint;
+        character = &row->render[index];
+        charLength = Utf8Decode(character, row->renderSize - index, &codepoint);
+    }
+
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "\x1b[%zu;%zuH%s", screenY + 1, screenX + 1, style);
+    ScreenBufferAppend(sbuf, buffer, length);
+    ScreenBufferAppend(sbuf, character, charLength);
+    ScreenBufferAppend(sbuf, "\x1b[m", 3);
+}
+
+void    EditorDrawCursors(EditorConfiguration *config, ScreenBuffer* sbuf)
+{
+    for (size_t i = 0; i < config->numberofCursors; i++)
+    {
+        EditorCursor* cursor = &config->cursors[i];
+        if (cursor->y < config->textBuffer.numberofTextRows)
+        {
+            TextPosition position = TextRowSeek(&config->textBuffer.textRow[cursor->y], POSITION_TEXT, cursor->x);
+            editorDrawMarker(config, sbuf, cursor->y, position.render, position.column, "\x1b[7m");
+        }
+    }
+}
+
+static bool editorFindBracketPair(EditorConfiguration *config, size_t* bracketX, size_t* bracketY, size_t* matchX, size_t* matchY)
+{
+    TextBuffer* tbuf = &config->textBuffer;
+    if (config->cursorY >= tbuf->numberofTextRows)
+        return false;
 
-    ScreenBuffer sbuf = SCREEN_BUFFER_INIT;
+    TextRow* row = &tbuf->textRow[config->cursorY];
+    size_t renderX = TextRowSeek(row, POSITION_TEXT, config->cursorX).render;
 
-    ScreenBufferAppend(&sbuf, "\x1b[?25l", 6);
-    ScreenBufferAppend(&sbuf, "\x1b[H", 3);
+    // the bracket under the cursor wins, then the one just before it, then the enclosing block
+    if (TextRowBracketDirection(row, renderX, NULL) == 0 && renderX > 0 && TextRowBracketDirection(row, renderX - 1, NULL) != 0)
+        renderX--;
 
-    EditorDrawRows(config, &sbuf);
-    EditorDrawStatusBar(config, &sbuf);
-    EditorDrawMessageBar(config, &sbuf);
+    *bracketX = renderX;
+    *bracketY = config->cursorY;
 
-    char buffer[32];
-    snprintf(buffer, sizeof(buffer), "\x1b[%ld;%ldH", (config->cursorY - config->rowOffset) + 1, (config->renderX - config->columnOffset) + 1);
+    if (TextRowBracketDirection(row, renderX, NULL) == 0 &&
+        !BracketIndexFindEnclosing(&config->brackets, tbuf, renderX, config->cursorY, bracketX, bracketY))
+        return false;
 
-    ScreenBufferAppend(&sbuf, buffer, strlen(buffer));
+    return BracketIndexFindMatch(&config->brackets, tbuf, *bracketX, *bracketY, matchX, matchY);
+}
 
-    ScreenBufferAppend(&sbuf, "\x1b[?25h", 6);
+void    EditorDrawBrackets(EditorConfiguration *config, ScreenBuffer* sbuf)
+{
+    size_t bracketX, bracketY, matchX, matchY;
+    if (!editorFindBracketPair(config, &bracketX, &bracketY, &matchX, &matchY))
+        return;
 
-    write(STDOUT_FILENO, sbuf.string, sbuf.size);
-    ScreenBufferFree(&sbuf);
+    TextBuffer* tbuf = &config->textBuffer;
+    editorDrawMarker(config, sbuf, bracketY, bracketX, TextRowSeek(&tbuf->textRow[bracketY], POSITION_RENDER, bracketX).column, "\x1b[1;4m");
+    editorDrawMarker(config, sbuf, matchY, matchX, TextRowSeek(&tbuf->textRow[matchY], POSITION_RENDER, matchX).column, "\x1b[1;4m");
 }
 
-/******* input ********/
-
-char*   EditorPromptForInput(EditorConfiguration *config, char* prompt, void (*callBackFunction)(EditorConfiguration*, char*, int))
+void    EditorJumpToBracket(EditorConfiguration *config)
 {
-    int maxBufferSize = 150;
-    char* buffer = malloc(maxBufferSize);
-    buffer[0] = '\0';
-    int bufferSize = 0;
-
-    while (1)
+    size_t bracketX, bracketY, matchX, matchY;
+    if (!editorFindBracketPair(config, &bracketX, &bracketY, &matchX, &matchY))
     {
-        EditorSetStatusMessage(config, prompt, buffer);
-        EditorRefreshScreen(config);
+        EditorSetStatusMessage(config, "No matching bracket");
+        return;
+    }
 
-        short int input = readKeypress();
+    size_t renderX = TextRowSeek(&config->textBuffer.textRow[config->cursorY], POSITION_TEXT, config->cursorX).render;
+    bool isAtBracket = (config->cursorY == bracketY && (renderX == bracketX || renderX == bracketX + 1));
 
-        if (input == DELETE_KEY || input == CTRL_KEY('h') || input == BACKSPACE)
-        {
-            if (bufferSize > 0)
-            {
-                bufferSize--;
-                buffer[bufferSize] = '\0';
-            }
-        }
-        else if (input == '\x1b')
-        {
-            EditorSetStatusMessage(config, "");
+    config->cursorY = isAtBracket ? matchY : bracketY;
+    config->cursorX = TextRowSeek(&config->textBuffer.textRow[config->cursorY], POSITION_RENDER, isAtBracket ? matchX : bracketX).text;
+}
 
-            if (callBackFunction)
-                callBackFunction(config, buffer, input);
+/******* selection and clipboard ********/
 
-            free(buffer);
-            return NULL;
-        }
-        else if (input == '\r')
-        {
-            if(bufferSize > 0)
-            {
-                EditorSetStatusMessage(config, "");
+bool    EditorGetSelection(EditorConfiguration *config, size_t* startX, size_t* startY, size_t* endX, size_t* endY)
+{
+    if (!config->isSelecting)
+        return false;
 
-                if (callBackFunction)
-                    callBackFunction(config, buffer, input);
+    bool isAnchorFirst = config->selectionY < config->cursorY ||
+                         (config->selectionY == config->cursorY && config->selectionX < config->cursorX);
 
-                return buffer;
-            }
-        }
-        else if (!iscntrl(input) && input < 128)
-        {
-            if (bufferSize == maxBufferSize - 1)
-            {
-                maxBufferSize *= 2;
-                buffer = realloc(buffer, maxBufferSize);
-                if (buffer == NULL)
-                    die("realloc");
-            }
-            buffer[bufferSize] = input;
-            bufferSize++;
-            buffer[bufferSize] = '\0';
-        }
+    *startX = isAnchorFirst ? config->selectionX : config->cursorX;
+    *startY = isAnchorFirst ? config->selectionY : config->cursorY;
+    *endX = isAnchorFirst ? config->cursorX : config->selectionX;
+    *endY = isAnchorFirst ? config->cursorY : config->selectionY;
 
-        if(callBackFunction)
-            callBackFunction(config, buffer, input);
-    }
+    return *startX != *endX || *startY != *endY;
 }
 
-void    EditorMoveCursor(EditorConfiguration *config, short int key)
+void    EditorSelectAll(EditorConfiguration *config)
 {
-    TextRow* row = (config->cursorY >= config->textBuffer.numberofTextRows)
-                   ? NULL
-                   : &config->textBuffer.textRow[config->cursorY];
+    size_t rows = config->textBuffer.numberofTextRows;
 
-    switch (key)
+    config->isSelecting = true;
+    config->selectionX = 0;
+    config->selectionY = 0;
+    config->cursorY = (rows > 0) ? rows - 1 : 0;
+    config->cursorX = (rows > 0) ? config->textBuffer.textRow[rows - 1].textSize : 0;
+}
+
+bool    EditorDeleteSelection(EditorConfiguration *config)
+{
+    size_t startX, startY, endX, endY;
+    if (!EditorGetSelection(config, &startX, &startY, &endX, &endY))
     {
-        case ARROW_LEFT:
-            if (config->cursorX != 0)
-                config->cursorX--;
-            else if (config->cursorY > 0)
-            {
-                config->cursorY--;
-                config->cursorX = config->textBuffer.textRow[config->cursorY].textSize;
-            }
-            break;
-        case ARROW_RIGHT:
-            if (row != NULL && config->cursorX < row->textSize)
-                config->cursorX++;
-            else if (row != NULL && config->cursorX == row->textSize)
-            {
-                config->cursorY++;
-                config->cursorX = 0;
-            }
-            break;
-        case ARROW_UP:
-            if (config->cursorY != 0)
-                config->cursorY--;
-            break;
-        case ARROW_DOWN:
-            if (config->cursorY < config->textBuffer.numberofTextRows)
-                config->cursorY++;
-            break;
+        config->isSelecting = false;
+        return false;
     }
 
-    row = (config->cursorY >= config->textBuffer.numberofTextRows)
-          ? NULL
-          : &config->textBuffer.textRow[config->cursorY];
+    config->isSelecting = false;
+    if (ViewerIsActive(&config->viewer))
+        return false;
 
-    size_t rowSize = (row != NULL) ? row->textSize : 0;
-    if (config->cursorX > rowSize)
-        config->cursorX = rowSize;
+    size_t numberofRows = config->textBuffer.numberofTextRows;
+    TextBufferDeleteRange(&config->textBuffer, startX, startY, endX, endY);
+    config->cursorX = startX;
+    config->cursorY = startY;
+    config->isSaved = false;
+    EditorNotifyRowsDeleted(config, startY + 1, numberofRows - config->textBuffer.numberofTextRows);
+    EditorNotifyRowChanged(config, startY);
+    return true;
 }
 
-void    EditorProcessKeypress(EditorConfiguration *config, Syntax HLDB[])
+void    EditorCopy(EditorConfiguration *config)
 {
-    static bool isQuiting = false;
+    size_t startX, startY, endX, endY;
+    if (!EditorGetSelection(config, &startX, &startY, &endX, &endY))
+        return;
 
-    short int input = readKeypress();
+    ClipboardCopy(&config->clipboard, &config->textBuffer, startX, startY, endX, endY);
+    EditorSetStatusMessage(config, "Copied %zu lines.", config->clipboard.numberofSpans);
+}
 
-    switch (input)
+void    EditorCut(EditorConfiguration *config)
+{
+    if (ViewerIsActive(&config->viewer))
     {
-        case '\r':
-            EditorInsertNewLine(config);
-            break;
-
-        case CTRL_KEY('s'):
-            EditorSaveToFile(config, HLDB);
-            break;
-
-        case CTRL_KEY('f'):
-            EditorFind(config);
-            break;
+        EditorSetStatusMessage(config, "Read-only view: file is too large to edit.");
+        return;
+    }
 
-        case CTRL_KEY('q'):
-            if (!config->isSaved && !isQuiting)
-            {
-                EditorSetStatusMessage(config, "File has unsaved changes! Press Ctrl-Q again to quit anyways.");
-                isQuiting = true;
-                return;
-            }
+    EditorCopy(config);
+    EditorDeleteSelection(config);
+}
 
-            write(STDOUT_FILENO, "\x1b[2J", 4);
-            write(STDOUT_FILENO, "\x1b[H", 3);
-            //EditorKill(config);
-            exit(0);
-            break;
+void    EditorPaste(EditorConfiguration *config)
+{
+    if (ViewerIsActive(&config->viewer) || config->clipboard.numberofSpans == 0)
+        return;
 
-        case HOME_KEY:
-            config->cursorX = 0;
-            break;
+    EditorDeleteSelection(config);
 
-        case END_KEY:
-            if (config->cursorY < config->textBuffer.numberofTextRows)
-                config->cursorX = config->textBuffer.textRow[config->cursorY].textSize;
-            break;
+    // pasting past the end adds a row there first, otherwise the new rows follow the one the cursor splits
+    size_t numberofRows = config->textBuffer.numberofTextRows;
+    size_t y = config->cursorY;
+    ClipboardPaste(&config->clipboard, &config->textBuffer, &config->cursorX, &config->cursorY);
+    config->isSaved = false;
 
-        case BACKSPACE:
-        case CTRL_KEY('h'):
-        case DELETE_KEY:
-            if (input == DELETE_KEY)
-                EditorMoveCursor(config, ARROW_RIGHT);
-            EditorDeleteChar(config);
-            break;
+    if (y >= numberofRows)
+        EditorNotifyRowsAppended(config, numberofRows);
+    else
+    {
+        EditorNotifyRowsInserted(config, y + 1, config->textBuffer.numberofTextRows - numberofRows);
+        EditorNotifyRowChanged(config, y);
+    }
+}
 
-        case PAGE_UP:
-        case PAGE_DOWN:
-            if (input == PAGE_UP)
-                config->cursorY = config->rowOffset;
-            else if (input == PAGE_DOWN)
-            {
-                config->cursorY = config->rowOffset + config->screenRows - 1;
-                if (config->cursorY > config->textBuffer.numberofTextRows)
-                    config->cursorY = config->textBuffer.numberofTextRows;
-            }
+/******* text search ********/
 
-            for (int i = config->screenRows; i > 0; i--)
-                EditorMoveCursor(config, input == PAGE_UP ? ARROW_UP : ARROW_DOWN);
-            break;
+static size_t editorSearchRow(EditorSearch* search, size_t step)
+{
+    ssize_t numberofRows = search->tbuf->numberofTextRows;
+    ssize_t row = (search->origin + search->direction * (ssize_t)step) % numberofRows;
+    return (row < 0) ? row + numberofRows : row;
+}
 
-        case ARROW_UP:
-        case ARROW_DOWN:
-        case ARROW_LEFT:
-        case ARROW_RIGHT:
-            EditorMoveCursor(config, input);
-            break;
+// runs on a worker: steps through one chunk of rows in scan order, rows are only read while the prompt is open
+static void editorSearchChunk(void* argument, PoolToken* token)
+{
+    EditorSearchChunk* chunk = argument;
+    EditorSearch* search = chunk->search;
+    size_t index = chunk - search->chunks;
+    size_t last = chunk->first + EDITOR_SEARCH_CHUNK_ROWS;
+    if (last > search->tbuf->numberofTextRows + 1)
+        last = search->tbuf->numberofTextRows + 1;
+
+    for (size_t step = chunk->first; step < last; step++)
+    {
+        // a match in an earlier chunk wins, so later chunks stop as soon as one is known
+        if (step % 1024 == 0 && (PoolIsCancelled(token) || atomic_load(&search->firstMatch) < index))
+            return;
 
-        case CTRL_KEY('l'):
-        case '\x1b':
-            break;
+        if (strstr(search->tbuf->textRow[editorSearchRow(search, step)].render, search->query) != NULL)
+        {
+            chunk->match = step;
 
-        default:
-            EditorInsertChar(config, input);
-            break;
+            size_t first = atomic_load(&search->firstMatch);
+            while (index < first && !atomic_compare_exchange_weak(&search->firstMatch, &first, index));
+            return;
+        }
     }
+}
 
-    isQuiting = false;
+static void editorSearchChunkDone(void* argument, PoolToken* token)
+{
+    (void)token;
+    ((EditorSearchChunk*)argument)->isDone = true;
 }
 
+static EditorSearch* editorSearchStart(TextBuffer* tbuf, const char* query, ssize_t origin, int direction)
+{
+    EditorSearch* search = malloc(sizeof(EditorSearch));
+    if (search == NULL)
+        die("malloc");
+
+    // workers only read rows, so a dropped cache is brought back before they start
+    TextBufferRestoreCache(tbuf);
+    search->tbuf = tbuf;
+    search->query = strdup(query);
+    if (search->query == NULL)
+        die("strdup");
 
-/******* Editor operations ********/
+    search->origin = origin;
+    search->direction = direction;
+    search->numberofChunks = (tbuf->numberofTextRows + EDITOR_SEARCH_CHUNK_ROWS - 1) / EDITOR_SEARCH_CHUNK_ROWS;
+    search->chunks = malloc(sizeof(EditorSearchChunk) * (search->numberofChunks + 1));
+    if (search->chunks == NULL)
+        die("malloc");
 
-void    EditorInsertChar(EditorConfiguration *config, short int input)
-{
-    if (config->cursorY == config->textBuffer.numberofTextRows)
-        TextBufferInsertTextRow(&config->textBuffer, config->textBuffer.numberofTextRows, "", 0);
+    atomic_init(&search->firstMatch, SIZE_MAX);
+    atomic_init(&search->token.isCancelled, false);
+    atomic_init(&search->token.pending, 0);
 
-    TextRowInsertChar(&config->textBuffer.textRow[config->cursorY], config->cursorX, input, config->textBuffer.syntax);
-    config->isSaved = false;
-    config->cursorX++;
+    for (size_t i = 0; i < search->numberofChunks; i++)
+        search->chunks[i] = (EditorSearchChunk){ search, i * EDITOR_SEARCH_CHUNK_ROWS + 1, SIZE_MAX, false };
+
+    for (size_t i = 0; i < search->numberofChunks; i++)
+        PoolSubmit(POOL_PRIORITY_VIEWPORT, editorSearchChunk, editorSearchChunkDone, &search->chunks[i], &search->token);
+
+    return search;
 }
 
-void    EditorInsertNewLine(EditorConfiguration *config)
+// 1 with the matching row, 0 when nothing matched, -1 when a key arrived first
+static int editorSearchWait(EditorSearch* search, size_t* row, bool isInterruptible)
 {
-    if (config->cursorX == 0)
-        TextBufferInsertTextRow(&config->textBuffer, config->cursorY, "", 0);
-    else
+    while (true)
     {
-        TextRow* row = &config->textBuffer.textRow[config->cursorY];
-        TextBufferInsertTextRow(&config->textBuffer, config->cursorY + 1, &row->text[config->cursorX], row->textSize - config->cursorX);
-        row = &config->textBuffer.textRow[config->cursorY];
-        row->textSize = config->cursorX;
-        row->text[row->textSize] = '\0';
-        TextRowUpdateRender(row);
-        TextRowUpdateSyntax(row, config->textBuffer.syntax);
+        PoolDispatch();
+
+        // the first match in scan order is final once every chunk before it is done
+        size_t chunk = 0;
+        while (chunk < search->numberofChunks && search->chunks[chunk].isDone && search->chunks[chunk].match == SIZE_MAX)
+            chunk++;
+
+        if (chunk == search->numberofChunks)
+            return 0;
+
+        if (search->chunks[chunk].isDone)
+        {
+            *row = editorSearchRow(search, search->chunks[chunk].match);
+            return 1;
+        }
+
+        struct pollfd descriptors[2] = {
+            { pool.notify, POLLIN, 0 },
+            { isInterruptible ? TerminalInputDescriptor() : -1, POLLIN, 0 }
+        };
+
+        if (poll(descriptors, 2, -1) == -1 && errno != EINTR)
+            die("poll");
+
+        if (descriptors[1].revents & POLLIN)
+            return -1;
     }
+}
 
-    config->cursorY++;
-    config->cursorX = 0;
-    config->isSaved = false;
+static void editorSearchFree(EditorSearch* search)
+{
+    PoolCancel(&search->token);
+    PoolWait(&search->token);
+
+    free(search->query);
+    free(search->chunks);
+    free(search);
 }
 
-void    EditorDeleteChar(EditorConfiguration *config)
+static void editorSearchShow(EditorConfiguration* config, const char* query, size_t match)
 {
-    if (config->cursorX == 0 && config->cursorY == 0)
-        return;
+    TextRow* row = &config->textBuffer.textRow[match];
+    char* found = strstr(row->render, query);
 
-    if (config->cursorY == config->textBuffer.numberofTextRows)
-        return;
+    config->cursorY = match;
+    config->cursorX = TextRowSeek(row, POSITION_RENDER, found - row->render).text;
+    config->rowOffset = config->textBuffer.numberofTextRows;
 
-    TextRow* row = &config->textBuffer.textRow[config->cursorY];
-    if (config->cursorX > 0)
-    {
-        TextRowDeleteChar(row, config->cursorX - 1, config->textBuffer.syntax);
-        config->isSaved = false;
-        config->cursorX--;
-    }
-    else
-    {
-        config->cursorX = config->textBuffer.textRow[config->cursorY - 1].textSize;
-        TextRowAppendString(&config->textBuffer.textRow[config->cursorY - 1], row->text, row->textSize, config->textBuffer.syntax);
-        TextBufferDeleteTextRow(&config->textBuffer, config->cursorY);
-        config->isSaved = false;
-        config->cursorY--;
-    }
+    config->searchRow = match;
+    config->searchHighlight = (HighlightSpan){ found - row->render, strlen(query), HIGHLIGHT_MATCH };
 }
 
-/******* text search ********/
-
 void findCallBack(EditorConfiguration* config, char* query, int key)
 {
     static ssize_t lastMatch = -1;
     static int direction = 1;
-    static unsigned char* savedHighlight = NULL;
-    static size_t savedRow;
+    static char* interrupted = NULL;
+    size_t match;
 
-    if(savedHighlight != NULL)
+    // a scan cut short by a key is run again when the next key builds on its result, edits to the query make it stale
+    if (interrupted != NULL)
     {
-        memcpy(config->textBuffer.textRow[savedRow].highlight, savedHighlight, config->textBuffer.textRow[savedRow].renderSize);
-        free(savedHighlight);
-        savedHighlight = NULL;
+        bool isNeeded = (key == '\r' || key == ARROW_RIGHT || key == ARROW_DOWN || key == ARROW_LEFT || key == ARROW_UP);
+        if (isNeeded && config->textBuffer.numberofTextRows > 0)
+        {
+            EditorSearch* search = editorSearchStart(&config->textBuffer, interrupted, lastMatch, direction);
+            if (editorSearchWait(search, &match, false) == 1)
+            {
+                lastMatch = match;
+                editorSearchShow(config, interrupted, match);
+            }
+
+            editorSearchFree(search);
+        }
+
+        free(interrupted);
+        interrupted = NULL;
     }
 
+    config->searchHighlight = (HighlightSpan)HIGHLIGHT_SPAN_NONE;
+
     if (key == '\r' || key == '\x1b')
     {
         lastMatch = -1;
@@ -690,32 +2647,25 @@ void findCallBack(EditorConfiguration* config, char* query, int key)
     if (lastMatch == -1)
         direction = 1;
 
-    ssize_t currentMatch = lastMatch;
-    for (size_t i = 0; i < config->textBuffer.numberofTextRows; i++)
-    {
-        currentMatch += direction;
-        if (currentMatch == -1)
-            currentMatch = config->textBuffer.numberofTextRows - 1;
-        else if (currentMatch == config->textBuffer.numberofTextRows)
-            currentMatch = 0;
-
-        TextRow* row = &config->textBuffer.textRow[currentMatch];
-        char* match = strstr(row->render, query);
-        if (match != NULL)
-        {
-            lastMatch = currentMatch;
-            config->cursorY = currentMatch;
-            config->cursorX = TextRowGetCursorX(row, match - row->render);
-            config->rowOffset = config->textBuffer.numberofTextRows;
-
-            savedRow = currentMatch;
-            savedHighlight = malloc(row->renderSize);
-            memcpy(savedHighlight, row->highlight, row->renderSize);
-            memset(&row->highlight[match - row->render], HIGHLIGHT_MATCH, strlen(query));
+    if (config->textBuffer.numberofTextRows == 0)
+        return;
 
-            break;
-        }
+    // the workers are always stopped before returning, the prompt redraws and may reload the rows they read
+    EditorSearch* search = editorSearchStart(&config->textBuffer, query, lastMatch, direction);
+    int status = editorSearchWait(search, &match, true);
+    if (status == -1)
+    {
+        interrupted = strdup(query);
+        if (interrupted == NULL)
+            die("strdup");
+    }
+    else if (status == 1)
+    {
+        lastMatch = match;
+        editorSearchShow(config, query, match);
     }
+
+    editorSearchFree(search);
 }
 
 void EditorFind(EditorConfiguration* config)
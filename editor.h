@@ -3,6 +3,88 @@
 
 #include "terminal.h"
 #include "buffer.h"
+#include "clipboard.h"
+#include "viewer.h"
+#include "follow.h"
+#include "stream.h"
+#include "wrap.h"
+#include "bracket.h"
+#include "filter.h"
+#include "transform.h"
+#include "pool.h"
+#include "render.h"
+#include "disk.h"
+
+#define EDITOR_INACTIVE_CACHE_BUDGET    (64L * 1024 * 1024)
+#define EDITOR_SEARCH_CHUNK_ROWS        16384
+#define EDITOR_PATCH_RATIO              2
+#define EDITOR_MEMORY_PRESSURE          "some 150000 2000000"
+
+typedef struct
+{
+    size_t    x;
+    size_t    y;
+
+} EditorCursor;
+
+// a file read in the background, its rows go into the buffer from the main loop
+typedef struct
+{
+    char*     data;
+    size_t    size;
+    int       error;
+    bool      isDone;
+
+} EditorLoad;
+
+typedef struct EditorSearch EditorSearch;
+
+typedef struct
+{
+    EditorSearch*    search;
+    size_t           first;
+    size_t           match;
+    bool             isDone;
+
+} EditorSearchChunk;
+
+struct EditorSearch
+{
+    TextBuffer*           tbuf;
+    char*                 query;
+    ssize_t               origin;
+    int                   direction;
+    EditorSearchChunk*    chunks;
+    size_t                numberofChunks;
+    atomic_size_t         firstMatch;
+    PoolToken             token;
+
+};
+
+typedef struct
+{
+    TextBuffer             textBuffer;
+    char*                  filename;
+    size_t                 cursorX;
+    size_t                 cursorY;
+    size_t                 renderX;
+    size_t                 rowOffset;
+    size_t                 columnOffset;
+    bool                   isSaved;
+    bool                   isSaving;
+    EditorLoad*            load;
+    DiskFileInfo           diskInfo;
+    FileViewer             viewer;
+    FileFollower           follower;
+    StreamReader*          stream;
+    WrapIndex              wrap;
+    size_t                 wrapLineOffset;
+    BracketIndex           brackets;
+    FilterIndex            filter;
+    size_t                 lastUsed;
+    bool                   isCacheDropped;
+
+} EditorBuffer;
 
 typedef struct
 {
@@ -19,6 +101,30 @@ typedef struct
     char                   statusMessage[200];
     time_t                 statusMessageTime;
     bool                   isSaved;
+    bool                   isSaving;
+    EditorLoad*            load;
+    DiskFileInfo           diskInfo;
+    FileViewer             viewer;
+    FileFollower           follower;
+    StreamReader*          stream;
+    WrapIndex              wrap;
+    size_t                 wrapLineOffset;
+    BracketIndex           brackets;
+    FilterIndex            filter;
+    size_t                 searchRow;
+    HighlightSpan          searchHighlight;
+    EditorBuffer*          buffers;
+    size_t                 numberofBuffers;
+    size_t                 currentBuffer;
+    size_t                 bufferClock;
+    bool                   isSelecting;
+    size_t                 selectionX;
+    size_t                 selectionY;
+    Clipboard              clipboard;
+    EditorCursor*          cursors;
+    size_t                 numberofCursors;
+    size_t                 cursorCapacity;
+    int                    memoryPressure;
 
 } EditorConfiguration;
 
@@ -30,51 +136,141 @@ void    enableRawMode(EditorConfiguration *config);
 
 void    EditorKill(EditorConfiguration *config);
 
+void    EditorFree(EditorConfiguration *config);
+
 int     EditorGetCursorPosition(EditorConfiguration *config);
 
 int     EditorGetWindowSize(EditorConfiguration *config);
 
+void    EditorNotifyResize();
+
 void    EditorInit(EditorConfiguration *config);
 
+void    EditorInitHeadless(EditorConfiguration *config, short unsigned int screenRows, short unsigned int screenColumns);
+
 void    EditorSetSyntaxHighlight(EditorConfiguration *config, Syntax HLDB[]);
 
 /******* handling files to edit ********/
 
 void    EditorOpenFile(EditorConfiguration *config, const char* filename, Syntax HLDB[]);
 
+void    EditorOpenFileViewer(EditorConfiguration *config, const char* filename, Syntax HLDB[]);
+
+void    EditorWaitForLoad(EditorConfiguration *config);
+
 void    EditorSaveToFile(EditorConfiguration *config, Syntax HLDB[]);
 
+void    EditorNewBuffer(EditorConfiguration *config);
+
+void    EditorSwitchBuffer(EditorConfiguration *config, size_t index);
+
+void    EditorOpenBuffer(EditorConfiguration *config, const char* filename, Syntax HLDB[]);
+
+void    EditorTrimBufferCaches(EditorConfiguration *config, size_t budget);
+
+bool    EditorHasUnsavedBuffers(EditorConfiguration *config);
+
+void    EditorToggleFollow(EditorConfiguration *config);
+
+void    EditorFollowUpdate(EditorConfiguration *config);
+
+void    EditorOpenStream(EditorConfiguration *config, int file);
+
+void    EditorStreamUpdate(EditorConfiguration *config);
+
+void    EditorToggleWrap(EditorConfiguration *config);
+
+void    EditorToggleFilter(EditorConfiguration *config);
+
+void    EditorTransformLines(EditorConfiguration *config);
+
 /******* Editor output ********/
 
 void    EditorScroll(EditorConfiguration *config);
 
 void    EditorSetStatusMessage(EditorConfiguration *config, const char* fstring, ...);
 
-void    EditorDrawRows(EditorConfiguration *config, ScreenBuffer* sbuf);
+size_t  EditorDrawTextRow(ScreenBuffer* sbuf, TextRow* row, size_t start, size_t length, size_t selectionStart, size_t selectionEnd, const HighlightSpan* overlay);
+
+void    EditorDrawRows(EditorConfiguration *config, ScreenBuffer* sbuf, size_t* lineEnds);
 
 void    EditorDrawStatusBar(EditorConfiguration *config, ScreenBuffer* sbuf);
 
+void    EditorDrawProfileOverlay(EditorConfiguration *config, ScreenBuffer* sbuf);
+
 void    EditorDrawMessageBar(EditorConfiguration *config, ScreenBuffer* sbuf);
 
 void    EditorRefreshScreen(EditorConfiguration *config);
 
 /******* input ********/
 
+bool    EditorWaitForInput(EditorConfiguration *config);
+
 char*   EditorPromptForInput(EditorConfiguration *config, char* prompt, void (*callBackFunction)(EditorConfiguration*, char*, int));
 
 void    EditorMoveCursor(EditorConfiguration *config, short int key);
 
+void    EditorMoveCursorVisual(EditorConfiguration *config, ssize_t lines);
+
+void    EditorGoToLine(EditorConfiguration *config, size_t line);
+
+void    EditorGoToPrompt(EditorConfiguration *config);
+
 void    EditorProcessKeypress(EditorConfiguration *config, Syntax HLDB[]);
 
 
 /******* Editor operations ********/
 
+void    EditorNotifyRowChanged(EditorConfiguration *config, size_t index);
+
+void    EditorNotifyRowsChanged(EditorConfiguration *config);
+
+void    EditorNotifyRowsInserted(EditorConfiguration *config, size_t index, size_t count);
+
+void    EditorNotifyRowsDeleted(EditorConfiguration *config, size_t index, size_t count);
+
+void    EditorNotifyRowsAppended(EditorConfiguration *config, size_t first);
+
 void    EditorInsertChar(EditorConfiguration *config, short int input);
 
 void    EditorInsertNewLine(EditorConfiguration *config);
 
 void    EditorDeleteChar(EditorConfiguration *config);
 
+/******* multiple cursors ********/
+
+void    EditorAddCursor(EditorConfiguration *config, size_t x, size_t y);
+
+void    EditorClearCursors(EditorConfiguration *config);
+
+void    EditorAddCursorBelow(EditorConfiguration *config);
+
+void    EditorMoveCursors(EditorConfiguration *config, short int key);
+
+void    EditorEditCursors(EditorConfiguration *config, short int key);
+
+bool    EditorProcessCursorsKeypress(EditorConfiguration *config, short int key);
+
+void    EditorDrawCursors(EditorConfiguration *config, ScreenBuffer* sbuf);
+
+void    EditorDrawBrackets(EditorConfiguration *config, ScreenBuffer* sbuf);
+
+void    EditorJumpToBracket(EditorConfiguration *config);
+
+/******* selection and clipboard ********/
+
+bool    EditorGetSelection(EditorConfiguration *config, size_t* startX, size_t* startY, size_t* endX, size_t* endY);
+
+void    EditorSelectAll(EditorConfiguration *config);
+
+bool    EditorDeleteSelection(EditorConfiguration *config);
+
+void    EditorCopy(EditorConfiguration *config);
+
+void    EditorCut(EditorConfiguration *config);
+
+void    EditorPaste(EditorConfiguration *config);
+
 /******* text search ********/
 
 void findCallBack(EditorConfiguration* config, char* query, int key);
@@ -0,0 +1,263 @@
+#include "filter.h"
+
+/******* matching rows ********/
+
+typedef struct
+{
+    FilterIndex*   filter;
+    TextBuffer*    tbuf;
+    size_t         first;
+    size_t         last;
+    size_t*        rows;
+    size_t         numberofRows;
+    size_t         capacity;
+
+} FilterChunk;
+
+static bool filterRowMatches(FilterIndex* filter, TextRow* row)
+{
+    return row->render != NULL && strstr(row->render, filter->query) != NULL;
+}
+
+static void filterPush(size_t** rows, size_t* numberofRows, size_t* capacity, size_t index)
+{
+    if (*numberofRows == *capacity)
+    {
+        *capacity = (*capacity == 0) ? 64 : *capacity * 2;
+        size_t* temp = realloc(*rows, sizeof(size_t) * *capacity);
+        if (temp == NULL)
+            die("realloc");
+        *rows = temp;
+    }
+
+    (*rows)[(*numberofRows)++] = index;
+}
+
+// runs on a worker: rows are only read, the main loop waits for every chunk before it touches the buffer again
+static void filterMatchChunk(void* argument, PoolToken* token)
+{
+    (void)token;
+    FilterChunk* chunk = argument;
+
+    for (size_t i = chunk->first; i < chunk->last; i++)
+    {
+        if (filterRowMatches(chunk->filter, &chunk->tbuf->textRow[i]))
+            filterPush(&chunk->rows, &chunk->numberofRows, &chunk->capacity, i);
+    }
+}
+
+static void filterMatchRows(FilterIndex* filter, TextBuffer* tbuf, size_t first, size_t last)
+{
+    TextBufferRestoreCache(tbuf);
+
+    size_t numberofChunks = (last - first + FILTER_CHUNK_ROWS - 1) / FILTER_CHUNK_ROWS;
+    if (numberofChunks == 0)
+        return;
+
+    FilterChunk* chunks = malloc(sizeof(FilterChunk) * numberofChunks);
+    if (chunks == NULL)
+        die("malloc");
+
+    PoolToken token = POOL_TOKEN_INIT;
+    for (size_t i = 0; i < numberofChunks; i++)
+    {
+        size_t start = first + i * FILTER_CHUNK_ROWS;
+        size_t end = (last - start > FILTER_CHUNK_ROWS) ? start + FILTER_CHUNK_ROWS : last;
+
+        chunks[i] = (FilterChunk){ filter, tbuf, start, end, NULL, 0, 0 };
+        PoolSubmit(POOL_PRIORITY_VIEWPORT, filterMatchChunk, NULL, &chunks[i], &token);
+    }
+
+    PoolWait(&token);
+
+    // chunks cover rows in order, so their matches are joined without sorting
+    for (size_t i = 0; i < numberofChunks; i++)
+    {
+        if (filter->numberofRows + chunks[i].numberofRows > filter->capacity)
+        {
+            filter->capacity = (filter->numberofRows + chunks[i].numberofRows) * 2;
+            size_t* temp = realloc(filter->rows, sizeof(size_t) * filter->capacity);
+            if (temp == NULL)
+                die("realloc");
+            filter->rows = temp;
+        }
+
+        memcpy(&filter->rows[filter->numberofRows], chunks[i].rows, sizeof(size_t) * chunks[i].numberofRows);
+        filter->numberofRows += chunks[i].numberofRows;
+        free(chunks[i].rows);
+    }
+
+    free(chunks);
+}
+
+/******* keeping the row map current ********/
+
+void    FilterIndexFree(FilterIndex* filter)
+{
+    free(filter->query);
+    free(filter->rows);
+    *filter = (FilterIndex)FILTER_INDEX_INIT;
+}
+
+void    FilterIndexSetQuery(FilterIndex* filter, const char* query)
+{
+    free(filter->query);
+    filter->query = NULL;
+    filter->isEnabled = false;
+    filter->isStale = true;
+    filter->heldRow = SIZE_MAX;
+
+    if (query == NULL || query[0] == '\0')
+        return;
+
+    filter->query = strdup(query);
+    if (filter->query == NULL)
+        die("strdup");
+
+    filter->isEnabled = true;
+}
+
+void    FilterIndexInvalidate(FilterIndex* filter)
+{
+    filter->isStale = true;
+}
+
+void    FilterIndexSync(FilterIndex* filter, TextBuffer* tbuf)
+{
+    if (!filter->isEnabled)
+        return;
+
+    if (filter->isStale || filter->numberofChecked > tbuf->numberofTextRows)
+    {
+        filter->numberofRows = 0;
+        filter->numberofChecked = 0;
+        filter->isStale = false;
+    }
+    else if (filter->numberofChecked == tbuf->numberofTextRows)
+        return;
+    else if (filter->numberofChecked > 0)
+    {
+        // rows were appended, and the last one checked may have grown if it had no newline yet
+        size_t last = filter->numberofChecked - 1;
+        if (filter->numberofRows > 0 && filter->rows[filter->numberofRows - 1] == last)
+            filter->numberofRows--;
+        filter->numberofChecked = last;
+    }
+
+    filterMatchRows(filter, tbuf, filter->numberofChecked, tbuf->numberofTextRows);
+    filter->numberofChecked = tbuf->numberofTextRows;
+
+    FilterIndexUpdateRow(filter, tbuf, filter->heldRow);
+}
+
+void    FilterIndexUpdateRow(FilterIndex* filter, TextBuffer* tbuf, size_t index)
+{
+    if (!filter->isEnabled || filter->isStale || index >= filter->numberofChecked || index >= tbuf->numberofTextRows)
+        return;
+
+    TextRowEnsureRender(&tbuf->textRow[index]);
+    bool isShown = (index == filter->heldRow) || filterRowMatches(filter, &tbuf->textRow[index]);
+    size_t line = FilterIndexFindLine(filter, index);
+    bool isPresent = line < filter->numberofRows && filter->rows[line] == index;
+
+    if (isShown && !isPresent)
+    {
+        filterPush(&filter->rows, &filter->numberofRows, &filter->capacity, index);
+        memmove(&filter->rows[line + 1], &filter->rows[line], sizeof(size_t) * (filter->numberofRows - line - 1));
+        filter->rows[line] = index;
+    }
+    else if (!isShown && isPresent)
+    {
+        memmove(&filter->rows[line], &filter->rows[line + 1], sizeof(size_t) * (filter->numberofRows - line - 1));
+        filter->numberofRows--;
+    }
+}
+
+void    FilterIndexInsertRows(FilterIndex* filter, TextBuffer* tbuf, size_t index, size_t count)
+{
+    // rows added past the checked ones are matched by the next sync
+    if (!filter->isEnabled || filter->isStale || index >= filter->numberofChecked)
+        return;
+
+    // matches after the new rows move down by count, only the new rows are matched
+    size_t line = FilterIndexFindLine(filter, index);
+    size_t numberofTail = filter->numberofRows - line;
+    size_t* tail = malloc(sizeof(size_t) * (numberofTail + 1));
+    if (tail == NULL)
+        die("malloc");
+
+    for (size_t i = 0; i < numberofTail; i++)
+        tail[i] = filter->rows[line + i] + count;
+
+    filter->numberofRows = line;
+    filterMatchRows(filter, tbuf, index, index + count);
+
+    for (size_t i = 0; i < numberofTail; i++)
+        filterPush(&filter->rows, &filter->numberofRows, &filter->capacity, tail[i]);
+
+    free(tail);
+    filter->numberofChecked += count;
+    if (filter->heldRow != SIZE_MAX && filter->heldRow >= index)
+        filter->heldRow += count;
+}
+
+void    FilterIndexDeleteRows(FilterIndex* filter, size_t index, size_t count)
+{
+    if (!filter->isEnabled || filter->isStale || index >= filter->numberofChecked)
+        return;
+
+    if (count > filter->numberofChecked - index)
+        count = filter->numberofChecked - index;
+
+    size_t first = FilterIndexFindLine(filter, index);
+    size_t last = FilterIndexFindLine(filter, index + count);
+    for (size_t i = last; i < filter->numberofRows; i++)
+        filter->rows[first + i - last] = filter->rows[i] - count;
+
+    filter->numberofRows -= last - first;
+    filter->numberofChecked -= count;
+    if (filter->heldRow != SIZE_MAX && filter->heldRow >= index + count)
+        filter->heldRow -= count;
+    else if (filter->heldRow != SIZE_MAX && filter->heldRow >= index)
+        filter->heldRow = SIZE_MAX;
+}
+
+void    FilterIndexHoldRow(FilterIndex* filter, TextBuffer* tbuf, size_t index)
+{
+    // the row under the cursor stays in view while it is edited, and is only dropped once the cursor leaves it
+    size_t previous = filter->heldRow;
+    filter->heldRow = index;
+
+    if (previous != index)
+        FilterIndexUpdateRow(filter, tbuf, previous);
+
+    FilterIndexUpdateRow(filter, tbuf, index);
+}
+
+/******* mapping between view lines and text rows ********/
+
+size_t  FilterIndexGetRow(FilterIndex* filter, TextBuffer* tbuf, size_t line)
+{
+    return (line < filter->numberofRows) ? filter->rows[line] : tbuf->numberofTextRows;
+}
+
+size_t  FilterIndexFindLine(FilterIndex* filter, size_t index)
+{
+    size_t low = 0, high = filter->numberofRows;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (filter->rows[middle] < index)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+bool    FilterIndexHasRow(FilterIndex* filter, size_t index)
+{
+    size_t line = FilterIndexFindLine(filter, index);
+    return line < filter->numberofRows && filter->rows[line] == index;
+}
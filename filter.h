@@ -0,0 +1,49 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "buffer.h"
+#include "pool.h"
+
+/******* filtered view: the text rows matching a query, in order ********/
+
+#define FILTER_CHUNK_ROWS    16384
+
+typedef struct
+{
+    char*     query;
+    size_t*   rows;
+    size_t    numberofRows;
+    size_t    capacity;
+    size_t    numberofChecked;
+    size_t    heldRow;
+    bool      isEnabled;
+    bool      isStale;
+    bool      wasWrapped;
+
+} FilterIndex;
+
+#define FILTER_INDEX_INIT { NULL, NULL, 0, 0, 0, SIZE_MAX, false, true, false }
+
+void    FilterIndexFree(FilterIndex* filter);
+
+void    FilterIndexSetQuery(FilterIndex* filter, const char* query);
+
+void    FilterIndexInvalidate(FilterIndex* filter);
+
+void    FilterIndexSync(FilterIndex* filter, TextBuffer* tbuf);
+
+void    FilterIndexUpdateRow(FilterIndex* filter, TextBuffer* tbuf, size_t index);
+
+void    FilterIndexInsertRows(FilterIndex* filter, TextBuffer* tbuf, size_t index, size_t count);
+
+void    FilterIndexDeleteRows(FilterIndex* filter, size_t index, size_t count);
+
+void    FilterIndexHoldRow(FilterIndex* filter, TextBuffer* tbuf, size_t index);
+
+size_t  FilterIndexGetRow(FilterIndex* filter, TextBuffer* tbuf, size_t line);
+
+size_t  FilterIndexFindLine(FilterIndex* filter, size_t index);
+
+bool    FilterIndexHasRow(FilterIndex* filter, size_t index);
+
+#endif // FILTER_H
@@ -0,0 +1,164 @@
+#include "follow.h"
+
+#define FOLLOW_FILE_EVENTS         (IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF)
+#define FOLLOW_DIRECTORY_EVENTS    (IN_CREATE | IN_MOVED_TO)
+
+// a new file under the path replaces the one being read, returns whether it did
+static bool followerReopen(FileFollower* follower)
+{
+    int file = open(follower->path, O_RDONLY);
+    if (file == -1)
+        return false;
+
+    struct stat current, replacement;
+    if (fstat(follower->file, &current) == 0 && fstat(file, &replacement) == 0 &&
+        (current.st_ino != replacement.st_ino || current.st_dev != replacement.st_dev))
+    {
+        inotify_rm_watch(follower->notify, follower->fileWatch);
+        follower->fileWatch = inotify_add_watch(follower->notify, follower->path, FOLLOW_FILE_EVENTS);
+
+        close(follower->file);
+        follower->file = file;
+        return true;
+    }
+
+    close(file);
+    return false;
+}
+
+static void followerSetLineOpen(FileFollower* follower)
+{
+    char last = '\n';
+    follower->lineOpen = (follower->offset > 0 && pread(follower->file, &last, 1, follower->offset - 1) == 1 && last != '\n');
+}
+
+bool       FollowerIsActive(FileFollower* follower)
+{
+    return follower->notify != -1;
+}
+
+int        FollowerStart(FileFollower* follower, const char* path, off_t offset)
+{
+    follower->path = strdup(path);
+    if (follower->path == NULL)
+        die("strdup");
+
+    follower->file = open(path, O_RDONLY);
+    follower->notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (follower->file == -1 || follower->notify == -1)
+    {
+        FollowerStop(follower);
+        return -1;
+    }
+
+    char* directory = strdup(path);
+    if (directory == NULL)
+        die("strdup");
+
+    follower->fileWatch = inotify_add_watch(follower->notify, path, FOLLOW_FILE_EVENTS);
+    follower->directoryWatch = inotify_add_watch(follower->notify, dirname(directory), FOLLOW_DIRECTORY_EVENTS);
+    free(directory);
+
+    if (follower->fileWatch == -1)
+    {
+        FollowerStop(follower);
+        return -1;
+    }
+
+    follower->offset = offset;
+    followerSetLineOpen(follower);
+
+    return 0;
+}
+
+void       FollowerStop(FileFollower* follower)
+{
+    if (follower->file != -1)
+        close(follower->file);
+    if (follower->notify != -1)
+        close(follower->notify);
+
+    free(follower->path);
+
+    follower->notify = -1;
+    follower->fileWatch = -1;
+    follower->directoryWatch = -1;
+    follower->file = -1;
+    follower->offset = 0;
+    follower->path = NULL;
+    follower->lineOpen = false;
+}
+
+int        FollowerProcessEvents(FileFollower* follower)
+{
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool isMoved = false;
+    ssize_t readSize;
+
+    char* name = strrchr(follower->path, '/');
+    name = (name != NULL) ? name + 1 : follower->path;
+
+    while ((readSize = read(follower->notify, events, sizeof(events))) > 0)
+    {
+        for (char* i = events; i < events + readSize; )
+        {
+            struct inotify_event* event = (struct inotify_event*)i;
+
+            if (event->wd == follower->fileWatch && (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF)))
+                isMoved = true;
+            else if (event->wd == follower->directoryWatch && event->len > 0 && !strcmp(event->name, name))
+                isMoved = true;
+
+            i += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    int result = FOLLOW_NONE;
+
+    if (isMoved && followerReopen(follower))
+    {
+        follower->offset = 0;
+        follower->lineOpen = false;
+        result |= FOLLOW_ROTATED;
+    }
+
+    struct stat info;
+    if (fstat(follower->file, &info) == 0)
+    {
+        if (info.st_size < follower->offset)
+        {
+            follower->offset = 0;
+            follower->lineOpen = false;
+            result |= FOLLOW_TRUNCATED;
+        }
+
+        if (info.st_size > follower->offset)
+            result |= FOLLOW_APPENDED;
+    }
+
+    return result;
+}
+
+// the editor wrote the file itself, what is on disk now is already in the buffer
+void       FollowerResync(FileFollower* follower)
+{
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (read(follower->notify, events, sizeof(events)) > 0);
+
+    followerReopen(follower);
+
+    struct stat info;
+    if (fstat(follower->file, &info) == 0)
+        follower->offset = info.st_size;
+
+    followerSetLineOpen(follower);
+}
+
+ssize_t    FollowerRead(FileFollower* follower, char* buffer, size_t size)
+{
+    ssize_t readSize = pread(follower->file, buffer, size, follower->offset);
+    if (readSize > 0)
+        follower->offset += readSize;
+
+    return readSize;
+}
@@ -0,0 +1,44 @@
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include "terminal.h"
+
+/******* following a growing file through inotify ********/
+
+#define FOLLOW_READ_CHUNK    (64 * 1024)
+
+enum FollowEvent
+{
+    FOLLOW_NONE         =    0,
+    FOLLOW_APPENDED     =    1,
+    FOLLOW_TRUNCATED    =    2,
+    FOLLOW_ROTATED      =    4
+};
+
+typedef struct
+{
+    int       notify;
+    int       fileWatch;
+    int       directoryWatch;
+    int       file;
+    off_t     offset;
+    char*     path;
+    bool      lineOpen;
+
+} FileFollower;
+
+#define FILE_FOLLOWER_INIT { -1, -1, -1, -1, 0, NULL, false }
+
+bool       FollowerIsActive(FileFollower* follower);
+
+int        FollowerStart(FileFollower* follower, const char* path, off_t offset);
+
+void       FollowerStop(FileFollower* follower);
+
+int        FollowerProcessEvents(FileFollower* follower);
+
+void       FollowerResync(FileFollower* follower);
+
+ssize_t    FollowerRead(FileFollower* follower, char* buffer, size_t size);
+
+#endif // FOLLOW_H
@@ -0,0 +1,367 @@
+#include "buffer.h"
+
+/******* compiling a syntax definition ********/
+
+static size_t lexerCountBytes(char** words)
+{
+    size_t count = 0;
+    for (size_t i = 0; words != NULL && words[i] != NULL; i++)
+        count += strlen(words[i]);
+
+    return count;
+}
+
+static void lexerAddClasses(SyntaxLexer* lexer, char** words)
+{
+    for (size_t i = 0; words != NULL && words[i] != NULL; i++)
+    {
+        for (const unsigned char* c = (const unsigned char*)words[i]; *c != '\0'; c++)
+        {
+            if (lexer->wordClass[*c] == 0)
+                lexer->wordClass[*c] = lexer->numberofClasses++;
+        }
+    }
+}
+
+static void lexerInsertWords(SyntaxLexer* lexer, char** words, unsigned char type)
+{
+    for (size_t i = 0; words != NULL && words[i] != NULL; i++)
+    {
+        uint32_t state = 0;
+        for (const unsigned char* c = (const unsigned char*)words[i]; *c != '\0'; c++)
+        {
+            uint32_t* next = &lexer->transitions[state * lexer->numberofClasses + lexer->wordClass[*c]];
+            if (*next == 0)
+                *next = lexer->numberofStates++;
+            state = *next;
+        }
+
+        // earlier words win, so keywords keep priority over types
+        if (state != 0 && lexer->accept[state] == HIGHLIGHT_NORMAL)
+            lexer->accept[state] = type;
+    }
+}
+
+void    LexerCompile(Syntax* syn)
+{
+    SyntaxLexer* lexer = calloc(1, sizeof(SyntaxLexer));
+    if (lexer == NULL)
+        die("calloc");
+
+    lexer->flag = (syn->flag & HIGHLIGHT_ALL) ? ~0 : syn->flag;
+    lexer->commentLength = syn->singleLineCommentStarter ? strlen(syn->singleLineCommentStarter) : 0;
+    lexer->multilineStartLength = syn->multilineCommentStart ? strlen(syn->multilineCommentStart) : 0;
+    lexer->multilineEndLength = syn->multilineCommentEnd ? strlen(syn->multilineCommentEnd) : 0;
+
+    for (int c = 0; c < 256; c++)
+    {
+        if (isSeparator(c))
+            lexer->charFlags[c] |= LEXER_CHAR_SEPARATOR;
+        if (isdigit(c))
+            lexer->charFlags[c] |= LEXER_CHAR_DIGIT;
+        if (isalnum(c) || c == '_')
+            lexer->charFlags[c] |= LEXER_CHAR_WORD;
+    }
+
+    lexer->charFlags['"'] |= LEXER_CHAR_SPECIAL;
+    lexer->charFlags['\''] |= LEXER_CHAR_SPECIAL;
+    lexer->charFlags['#'] |= LEXER_CHAR_SPECIAL;
+    if (lexer->commentLength)
+        lexer->charFlags[(unsigned char)syn->singleLineCommentStarter[0]] |= LEXER_CHAR_SPECIAL;
+    if (lexer->multilineStartLength)
+        lexer->charFlags[(unsigned char)syn->multilineCommentStart[0]] |= LEXER_CHAR_SPECIAL;
+
+    // class 0 holds every byte that appears in no word and always leads to the dead state
+    lexer->numberofClasses = 1;
+    lexerAddClasses(lexer, syn->keywords);
+    lexerAddClasses(lexer, syn->types);
+
+    size_t maxStates = 1 + lexerCountBytes(syn->keywords) + lexerCountBytes(syn->types);
+    lexer->transitions = calloc(maxStates * lexer->numberofClasses, sizeof(uint32_t));
+    lexer->accept = calloc(maxStates, sizeof(unsigned char));
+    if (lexer->transitions == NULL || lexer->accept == NULL)
+        die("calloc");
+
+    lexer->numberofStates = 1;
+    lexerInsertWords(lexer, syn->keywords, HIGHLIGHT_KEYWORD);
+    lexerInsertWords(lexer, syn->types, HIGHLIGHT_TYPE);
+
+    uint32_t* transitions = realloc(lexer->transitions, sizeof(uint32_t) * lexer->numberofStates * lexer->numberofClasses);
+    if (transitions != NULL)
+        lexer->transitions = transitions;
+
+    syn->lexer = lexer;
+}
+
+/******* loading syntax definition files ********/
+
+static char* lexerCopy(const char* word)
+{
+    char* copy = strdup(word);
+    if (copy == NULL)
+        die("strdup");
+
+    return copy;
+}
+
+static char** lexerNewWords(void)
+{
+    char** words = calloc(1, sizeof(char*));
+    if (words == NULL)
+        die("calloc");
+
+    return words;
+}
+
+static void lexerAppendWord(char*** words, size_t* count, const char* word)
+{
+    char** temp = realloc(*words, sizeof(char*) * (*count + 2));
+    if (temp == NULL)
+        die("realloc");
+
+    temp[*count] = lexerCopy(word);
+    temp[++(*count)] = NULL;
+    *words = temp;
+}
+
+static void lexerFreeWords(char** words)
+{
+    for (size_t i = 0; words != NULL && words[i] != NULL; i++)
+        free(words[i]);
+
+    free(words);
+}
+
+static void lexerFreeSyntax(Syntax* syn)
+{
+    free(syn->fileType);
+    lexerFreeWords(syn->fileMatch);
+    lexerFreeWords(syn->keywords);
+    lexerFreeWords(syn->types);
+    free(syn->singleLineCommentStarter);
+    free(syn->multilineCommentStart);
+    free(syn->multilineCommentEnd);
+}
+
+static char* lexerNextWord(char** rest)
+{
+    return strtok_r(NULL, " \t", rest);
+}
+
+static int lexerParseFile(const char* path, Syntax* syn)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+
+    *syn = (Syntax){ 0 };
+    syn->fileMatch = lexerNewWords();
+    syn->keywords = lexerNewWords();
+    syn->types = lexerNewWords();
+    size_t numberofMatches = 0, numberofKeywords = 0, numberofTypes = 0;
+
+    char* line = NULL;
+    size_t capacity = 0;
+    while (getline(&line, &capacity, file) != -1)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        char* rest;
+        char* directive = strtok_r(line, " \t", &rest);
+        char* word;
+
+        if (directive == NULL || directive[0] == '#')
+            continue;
+
+        if (!strcmp(directive, "name") && (word = lexerNextWord(&rest)) != NULL)
+        {
+            free(syn->fileType);
+            syn->fileType = lexerCopy(word);
+        }
+        else if (!strcmp(directive, "match"))
+        {
+            while ((word = lexerNextWord(&rest)) != NULL)
+                lexerAppendWord(&syn->fileMatch, &numberofMatches, word);
+        }
+        else if (!strcmp(directive, "keywords"))
+        {
+            while ((word = lexerNextWord(&rest)) != NULL)
+                lexerAppendWord(&syn->keywords, &numberofKeywords, word);
+        }
+        else if (!strcmp(directive, "types"))
+        {
+            while ((word = lexerNextWord(&rest)) != NULL)
+                lexerAppendWord(&syn->types, &numberofTypes, word);
+        }
+        else if (!strcmp(directive, "comment") && (word = lexerNextWord(&rest)) != NULL)
+        {
+            free(syn->singleLineCommentStarter);
+            syn->singleLineCommentStarter = lexerCopy(word);
+        }
+        else if (!strcmp(directive, "multiline") && (word = lexerNextWord(&rest)) != NULL)
+        {
+            free(syn->multilineCommentStart);
+            free(syn->multilineCommentEnd);
+            syn->multilineCommentStart = lexerCopy(word);
+            word = lexerNextWord(&rest);
+            syn->multilineCommentEnd = (word != NULL) ? lexerCopy(word) : NULL;
+        }
+        else if (!strcmp(directive, "highlight"))
+        {
+            while ((word = lexerNextWord(&rest)) != NULL)
+            {
+                if (!strcmp(word, "numbers"))
+                    syn->flag |= HIGHLIGHT_NUMBER;
+                else if (!strcmp(word, "strings"))
+                    syn->flag |= HIGHLIGHT_STRING;
+                else if (!strcmp(word, "characters"))
+                    syn->flag |= HIGHLIGHT_CHARACTER;
+                else if (!strcmp(word, "preprocessor"))
+                    syn->flag |= HIGHLIGHT_PREPROCESSOR;
+                else if (!strcmp(word, "all"))
+                    syn->flag |= HIGHLIGHT_ALL;
+            }
+        }
+    }
+
+    free(line);
+    fclose(file);
+
+    if (syn->fileType == NULL || numberofMatches == 0)
+    {
+        lexerFreeSyntax(syn);
+        return -1;
+    }
+
+    return 0;
+}
+
+static bool lexerHasSyntax(Syntax* syntaxes, size_t count, const char* fileType)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!strcmp(syntaxes[i].fileType, fileType))
+            return true;
+    }
+
+    return false;
+}
+
+static int lexerIsSyntaxFile(const struct dirent* entry)
+{
+    const char* extension = strrchr(entry->d_name, '.');
+    return extension != NULL && !strcmp(extension, ".syntax");
+}
+
+static void lexerAppendSyntax(Syntax** syntaxes, size_t* count, Syntax* syn)
+{
+    Syntax* temp = realloc(*syntaxes, sizeof(Syntax) * (*count + 2));
+    if (temp == NULL)
+        die("realloc");
+
+    temp[(*count)++] = *syn;
+    temp[*count] = (Syntax){ 0 };
+    *syntaxes = temp;
+}
+
+Syntax* LexerLoadSyntaxes(Syntax builtins[])
+{
+    // $NEO_SYNTAX_PATH, then the user's config directory, then ./syntax; the first definition of a name wins
+    char directories[3][PATH_MAX];
+    size_t numberofDirectories = 0;
+
+    const char* environment = getenv("NEO_SYNTAX_PATH");
+    if (environment != NULL)
+        snprintf(directories[numberofDirectories++], PATH_MAX, "%s", environment);
+
+    if ((environment = getenv("XDG_CONFIG_HOME")) != NULL && environment[0] != '\0')
+        snprintf(directories[numberofDirectories++], PATH_MAX, "%s/neo/syntax", environment);
+    else if ((environment = getenv("HOME")) != NULL)
+        snprintf(directories[numberofDirectories++], PATH_MAX, "%s/.config/neo/syntax", environment);
+
+    snprintf(directories[numberofDirectories++], PATH_MAX, "syntax");
+
+    Syntax* syntaxes = NULL;
+    size_t count = 0;
+
+    for (size_t d = 0; d < numberofDirectories; d++)
+    {
+        struct dirent** entries;
+        int numberofEntries = scandir(directories[d], &entries, lexerIsSyntaxFile, alphasort);
+        if (numberofEntries == -1)
+            continue;
+
+        for (int e = 0; e < numberofEntries; e++)
+        {
+            char path[PATH_MAX];
+            Syntax syn;
+            int length = snprintf(path, sizeof(path), "%s/%s", directories[d], entries[e]->d_name);
+
+            if (length < (int)sizeof(path) && lexerParseFile(path, &syn) == 0)
+            {
+                if (lexerHasSyntax(syntaxes, count, syn.fileType))
+                    lexerFreeSyntax(&syn);
+                else
+                    lexerAppendSyntax(&syntaxes, &count, &syn);
+            }
+
+            free(entries[e]);
+        }
+
+        free(entries);
+    }
+
+    for (size_t i = 0; builtins[i].fileType != NULL; i++)
+    {
+        if (!lexerHasSyntax(syntaxes, count, builtins[i].fileType))
+            lexerAppendSyntax(&syntaxes, &count, &builtins[i]);
+    }
+
+    if (syntaxes == NULL)
+    {
+        syntaxes = calloc(1, sizeof(Syntax));
+        if (syntaxes == NULL)
+            die("calloc");
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (syntaxes[i].lexer == NULL)
+            LexerCompile(&syntaxes[i]);
+    }
+
+    return syntaxes;
+}
+
+static bool lexerIsBuiltin(Syntax* syn, Syntax builtins[])
+{
+    for (size_t i = 0; builtins[i].fileType != NULL; i++)
+    {
+        if (syn->fileType == builtins[i].fileType)
+            return true;
+    }
+
+    return false;
+}
+
+void    LexerFreeSyntaxes(Syntax* syntaxes, Syntax builtins[])
+{
+    if (syntaxes == NULL)
+        return;
+
+    // copies of builtins share their static word lists, only the compiled trie is theirs
+    for (size_t i = 0; syntaxes[i].fileType != NULL; i++)
+    {
+        if (syntaxes[i].lexer != NULL)
+        {
+            free(syntaxes[i].lexer->transitions);
+            free(syntaxes[i].lexer->accept);
+            free(syntaxes[i].lexer);
+        }
+
+        if (!lexerIsBuiltin(&syntaxes[i], builtins))
+            lexerFreeSyntax(&syntaxes[i]);
+    }
+
+    free(syntaxes);
+}
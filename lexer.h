@@ -0,0 +1,28 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include "dependencies.h"
+
+/******* syntax definitions compiled into byte tables and a keyword trie ********/
+
+#define LEXER_CHAR_SEPARATOR    1
+#define LEXER_CHAR_DIGIT        2
+#define LEXER_CHAR_WORD         4
+#define LEXER_CHAR_SPECIAL      8
+
+typedef struct
+{
+    int               flag;
+    size_t            commentLength;
+    size_t            multilineStartLength;
+    size_t            multilineEndLength;
+    unsigned char     charFlags[256];
+    unsigned char     wordClass[256];
+    size_t            numberofClasses;
+    uint32_t*         transitions;
+    unsigned char*    accept;
+    size_t            numberofStates;
+
+} SyntaxLexer;
+
+#endif // LEXER_H
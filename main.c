@@ -1,42 +1,132 @@
+#ifndef NEO_BENCH
+
 #include "editor.h"
+#include "record.h"
 #include "syntax.h"
 
 
 EditorConfiguration editor;
+KeyRecorder recorder = KEY_RECORDER_INIT;
+TerminalBackend recordingBackend;
+char* profilePath = NULL;
+Syntax* syntaxes = NULL;
 
 void Kill()
 {
+    RenderStop();
+    DiskStop();
+    PoolStop();
+    RecorderStop(&recorder);
+    if (profilePath != NULL)
+        ProfileDump(profilePath);
+
     EditorKill(&editor);
+    LexerFreeSyntaxes(syntaxes, HLDB);
 }
 
+// the handler may interrupt the main thread half way through changing rows, so the resize waits for the next refresh
 void handleScreenResize()
 {
-    if (EditorGetWindowSize(&editor) == -1)
-        die("EditorGetWindowSize");
-
-    editor.screenRows -= 2;
-    EditorRefreshScreen(&editor);
+    EditorNotifyResize();
 }
 
 int main(int argc, char** argv)
 {
     atexit(Kill);
 
+    // "-" reads standard input, so the terminal has to take its place before raw mode is set up
+    int streamFile = -1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-"))
+        {
+            streamFile = StreamTakeStdin();
+            break;
+        }
+    }
+
     EditorInit(&editor);
+    PoolStart(0);
+    DiskStart();
+    renderer.isSynchronized = TerminalQuerySynchronizedOutput();
+    syntaxes = LexerLoadSyntaxes(HLDB);
     signal(SIGWINCH, handleScreenResize);
 
-    if (argc >= 2)
-        EditorOpenFile(&editor, argv[1], HLDB);
-    else
-        EditorOpenFile(&editor, "text.c", HLDB); // just for testing
+    bool forceViewer = false;
+    bool follow = false;
+    char* recordPath = NULL;
+    char* filenames[argc];
+    int numberofFilenames = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--view"))
+            forceViewer = true;
+        else if (!strcmp(argv[i], "--follow") || !strcmp(argv[i], "-f"))
+            follow = true;
+        else if (!strcmp(argv[i], "--wrap"))
+            editor.wrap.isEnabled = true;
+        else if (!strcmp(argv[i], "--fps") && i + 1 < argc)
+            RenderSetFrameRate(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (!strcmp(argv[i], "--profile") && i + 1 < argc)
+        {
+            profilePath = argv[++i];
+            profile.isEnabled = true;
+        }
+        else
+            filenames[numberofFilenames++] = argv[i];
+    }
+
+    if (numberofFilenames == 0)
+        filenames[numberofFilenames++] = "text.c"; // just for testing
 
-    EditorSetStatusMessage(&editor, "HELP: Ctrl-Q = quit");
+    RenderStart();
+
+    if (recordPath != NULL)
+    {
+        if (RecorderStart(&recorder, recordPath, editor.screenRows + 2, editor.screenColumns) == -1)
+            die("RecorderStart");
+
+        recordingBackend = RecorderBackend(&recorder);
+        TerminalSetBackend(&recordingBackend);
+    }
+
+    for (int i = 0; i < numberofFilenames; i++)
+    {
+        if (i > 0)
+            EditorNewBuffer(&editor);
+
+        if (!strcmp(filenames[i], "-") && streamFile != -1)
+        {
+            EditorOpenStream(&editor, streamFile);
+            streamFile = -1;
+        }
+        else if (!strcmp(filenames[i], "-"))
+            EditorSetStatusMessage(&editor, "Standard input is not a pipe.");
+        else if (forceViewer)
+            EditorOpenFileViewer(&editor, filenames[i], syntaxes);
+        else
+            EditorOpenFile(&editor, filenames[i], syntaxes);
+    }
+
+    EditorTrimBufferCaches(&editor, EDITOR_INACTIVE_CACHE_BUDGET);
+    EditorSwitchBuffer(&editor, 0);
+
+    if (follow)
+        EditorToggleFollow(&editor);
+
+    if (editor.statusMessage[0] == '\0')
+        EditorSetStatusMessage(&editor, "HELP: Ctrl-Q = quit");
 
     while (1)
     {
         EditorRefreshScreen(&editor);
-        EditorProcessKeypress(&editor, HLDB);
+        if (EditorWaitForInput(&editor))
+            EditorProcessKeypress(&editor, syntaxes);
     }
 
     return 0;
 }
+
+#endif // NEO_BENCH
@@ -0,0 +1,318 @@
+#include "pool.h"
+
+ThreadPool pool = { NULL, 0, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, NULL, NULL, -1, 0, false };
+
+static __thread size_t poolWorker = SIZE_MAX;
+
+/******* per worker task deques ********/
+
+static void poolDequePush(PoolDeque* deque, PoolTask* task)
+{
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->size == deque->capacity)
+    {
+        size_t capacity = deque->capacity * 2;
+        PoolTask** tasks = malloc(sizeof(PoolTask*) * capacity);
+        if (tasks == NULL)
+            die("malloc");
+
+        for (size_t i = 0; i < deque->size; i++)
+            tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->head = 0;
+        deque->capacity = capacity;
+    }
+
+    deque->tasks[(deque->head + deque->size) % deque->capacity] = task;
+    deque->size++;
+
+    pthread_mutex_unlock(&deque->lock);
+}
+
+// the owner works through its tasks in submission order and thieves take the newest, which the owner would reach last
+static PoolTask* poolDequeTake(PoolDeque* deque, bool isOwner)
+{
+    pthread_mutex_lock(&deque->lock);
+
+    PoolTask* task = NULL;
+    if (deque->size > 0)
+    {
+        if (isOwner)
+        {
+            task = deque->tasks[deque->head];
+            deque->head = (deque->head + 1) % deque->capacity;
+        }
+        else
+            task = deque->tasks[(deque->head + deque->size - 1) % deque->capacity];
+
+        deque->size--;
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+/******* workers ********/
+
+static void poolSignal()
+{
+    uint64_t value = 1;
+    while (write(pool.notify, &value, sizeof(value)) == -1 && errno == EINTR);
+}
+
+static PoolTask* poolFindTask(size_t worker)
+{
+    for (int priority = 0; priority < POOL_PRIORITIES; priority++)
+    {
+        for (size_t i = 0; i < pool.numberofWorkers; i++)
+        {
+            size_t victim = (worker + i) % pool.numberofWorkers;
+            PoolTask* task = poolDequeTake(&pool.deques[victim * POOL_PRIORITIES + priority], victim == worker);
+            if (task != NULL)
+                return task;
+        }
+    }
+
+    return NULL;
+}
+
+static void* poolWorkerLoop(void* argument)
+{
+    size_t worker = (size_t)(uintptr_t)argument;
+    poolWorker = worker;
+
+    while (true)
+    {
+        pthread_mutex_lock(&pool.lock);
+        while (pool.queued == 0 && !pool.isStopping)
+            pthread_cond_wait(&pool.wake, &pool.lock);
+
+        bool isStopping = pool.isStopping;
+        pthread_mutex_unlock(&pool.lock);
+
+        if (isStopping)
+            break;
+
+        PoolTask* task = poolFindTask(worker);
+        if (task == NULL)
+            continue;
+
+        pthread_mutex_lock(&pool.lock);
+        pool.queued--;
+        pthread_mutex_unlock(&pool.lock);
+
+        if (!PoolIsCancelled(task->token))
+            task->run(task->argument, task->token);
+
+        // completions are handed back to the main loop, which runs them from PoolDispatch
+        pthread_mutex_lock(&pool.lock);
+        task->next = NULL;
+        if (pool.completedTail != NULL)
+            pool.completedTail->next = task;
+        else
+            pool.completed = task;
+        pool.completedTail = task;
+        poolSignal();
+        pthread_mutex_unlock(&pool.lock);
+    }
+
+    return NULL;
+}
+
+static void poolFreeTasks(PoolTask* task)
+{
+    while (task != NULL)
+    {
+        PoolTask* next = task->next;
+        free(task);
+        task = next;
+    }
+}
+
+static void poolRelease(size_t numberofThreads)
+{
+    pthread_mutex_lock(&pool.lock);
+    pool.isStopping = true;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (size_t i = 0; i < numberofThreads; i++)
+        pthread_join(pool.threads[i], NULL);
+
+    // tasks still queued are dropped without their completions
+    for (size_t i = 0; i < pool.numberofWorkers * POOL_PRIORITIES; i++)
+    {
+        PoolDeque* deque = &pool.deques[i];
+        for (size_t j = 0; j < deque->size; j++)
+            free(deque->tasks[(deque->head + j) % deque->capacity]);
+
+        free(deque->tasks);
+        pthread_mutex_destroy(&deque->lock);
+    }
+
+    poolFreeTasks(pool.completed);
+    close(pool.notify);
+    free(pool.deques);
+    free(pool.threads);
+
+    pool.threads = NULL;
+    pool.deques = NULL;
+    pool.numberofWorkers = 0;
+    pool.completed = NULL;
+    pool.completedTail = NULL;
+    pool.queued = 0;
+    pool.notify = -1;
+    pool.isStopping = false;
+}
+
+/******* pool lifetime ********/
+
+int         PoolStart(size_t numberofWorkers)
+{
+    if (numberofWorkers == 0)
+    {
+        // one core is left to the main loop
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        numberofWorkers = (processors > 2) ? (size_t)processors - 1 : 1;
+    }
+
+    if (numberofWorkers > POOL_MAX_WORKERS)
+        numberofWorkers = POOL_MAX_WORKERS;
+
+    pool.notify = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pool.notify == -1)
+        return -1;
+
+    pool.threads = calloc(numberofWorkers, sizeof(pthread_t));
+    pool.deques = calloc(numberofWorkers * POOL_PRIORITIES, sizeof(PoolDeque));
+    if (pool.threads == NULL || pool.deques == NULL)
+        die("calloc");
+
+    for (size_t i = 0; i < numberofWorkers * POOL_PRIORITIES; i++)
+    {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+        pool.deques[i].capacity = POOL_DEQUE_CAPACITY;
+        pool.deques[i].tasks = malloc(sizeof(PoolTask*) * POOL_DEQUE_CAPACITY);
+        if (pool.deques[i].tasks == NULL)
+            die("malloc");
+    }
+
+    pool.numberofWorkers = numberofWorkers;
+    pool.nextWorker = 0;
+    pool.isStopping = false;
+
+    // workers never take signals, SIGWINCH and friends stay on the main thread
+    sigset_t signals, previous;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous);
+
+    size_t started = 0;
+    while (started < numberofWorkers && pthread_create(&pool.threads[started], NULL, poolWorkerLoop, (void*)(uintptr_t)started) == 0)
+        started++;
+
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if (started < numberofWorkers)
+    {
+        poolRelease(started);
+        return -1;
+    }
+
+    return 0;
+}
+
+void        PoolStop()
+{
+    if (pool.threads != NULL)
+        poolRelease(pool.numberofWorkers);
+}
+
+/******* submitting and collecting tasks ********/
+
+void        PoolSubmit(int priority, PoolFunction run, PoolFunction complete, void* argument, PoolToken* token)
+{
+    if (pool.numberofWorkers == 0)
+    {
+        // without workers the task runs inline and completes right away
+        if (!PoolIsCancelled(token))
+            run(argument, token);
+        if (complete != NULL)
+            complete(argument, token);
+        return;
+    }
+
+    PoolTask* task = malloc(sizeof(PoolTask));
+    if (task == NULL)
+        die("malloc");
+
+    *task = (PoolTask){ run, complete, argument, token, NULL };
+    if (token != NULL)
+        atomic_fetch_add(&token->pending, 1);
+
+    // a worker keeps what it submits, the main loop spreads its tasks over all workers
+    size_t worker = (poolWorker != SIZE_MAX) ? poolWorker : pool.nextWorker++ % pool.numberofWorkers;
+    poolDequePush(&pool.deques[worker * POOL_PRIORITIES + priority], task);
+
+    pthread_mutex_lock(&pool.lock);
+    pool.queued++;
+    pthread_cond_signal(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+void        PoolCancel(PoolToken* token)
+{
+    atomic_store(&token->isCancelled, true);
+}
+
+bool        PoolIsCancelled(PoolToken* token)
+{
+    return token != NULL && atomic_load(&token->isCancelled);
+}
+
+size_t      PoolDispatch()
+{
+    if (pool.numberofWorkers == 0)
+        return 0;
+
+    pthread_mutex_lock(&pool.lock);
+    PoolTask* task = pool.completed;
+    pool.completed = NULL;
+    pool.completedTail = NULL;
+
+    uint64_t value;
+    while (read(pool.notify, &value, sizeof(value)) == -1 && errno == EINTR);
+    pthread_mutex_unlock(&pool.lock);
+
+    size_t count = 0;
+    while (task != NULL)
+    {
+        PoolTask* next = task->next;
+
+        // pending drops first so a completion may free the token it belongs to
+        if (task->token != NULL)
+            atomic_fetch_sub(&task->token->pending, 1);
+        if (task->complete != NULL)
+            task->complete(task->argument, task->token);
+
+        free(task);
+        task = next;
+        count++;
+    }
+
+    return count;
+}
+
+void        PoolWait(PoolToken* token)
+{
+    while (atomic_load(&token->pending) > 0)
+    {
+        struct pollfd descriptor = { pool.notify, POLLIN, 0 };
+        if (poll(&descriptor, 1, -1) == -1 && errno != EINTR)
+            die("poll");
+
+        PoolDispatch();
+    }
+}
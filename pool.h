@@ -0,0 +1,81 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "terminal.h"
+
+/******* shared worker pool for background editor work ********/
+
+#define POOL_MAX_WORKERS       16
+#define POOL_DEQUE_CAPACITY    64
+
+enum PoolPriority
+{
+    POOL_PRIORITY_VIEWPORT = 0,
+    POOL_PRIORITY_BACKGROUND,
+    POOL_PRIORITIES
+};
+
+typedef struct
+{
+    atomic_bool      isCancelled;
+    atomic_size_t    pending;
+
+} PoolToken;
+
+#define POOL_TOKEN_INIT { false, 0 }
+
+typedef void (*PoolFunction)(void* argument, PoolToken* token);
+
+typedef struct PoolTask
+{
+    PoolFunction         run;
+    PoolFunction         complete;
+    void*                argument;
+    PoolToken*           token;
+    struct PoolTask*     next;
+
+} PoolTask;
+
+typedef struct
+{
+    pthread_mutex_t    lock;
+    PoolTask**         tasks;
+    size_t             head;
+    size_t             size;
+    size_t             capacity;
+
+} PoolDeque;
+
+typedef struct
+{
+    pthread_t*         threads;
+    size_t             numberofWorkers;
+    PoolDeque*         deques;
+    pthread_mutex_t    lock;
+    pthread_cond_t     wake;
+    size_t             queued;
+    PoolTask*          completed;
+    PoolTask*          completedTail;
+    int                notify;
+    size_t             nextWorker;
+    bool               isStopping;
+
+} ThreadPool;
+
+extern ThreadPool pool;
+
+int         PoolStart(size_t numberofWorkers);
+
+void        PoolStop();
+
+void        PoolSubmit(int priority, PoolFunction run, PoolFunction complete, void* argument, PoolToken* token);
+
+void        PoolCancel(PoolToken* token);
+
+bool        PoolIsCancelled(PoolToken* token);
+
+size_t      PoolDispatch();
+
+void        PoolWait(PoolToken* token);
+
+#endif // POOL_H
@@ -0,0 +1,93 @@
+#include "profile.h"
+
+Profile profile = { 0 };
+
+static const char* sectionNames[PROFILE_SECTIONS] = { "frame", "input", "syntax", "draw", "write" };
+
+uint64_t    ProfileStart()
+{
+    return profile.isEnabled ? MonotonicNanoseconds() : 0;
+}
+
+void        ProfileStop(int section, uint64_t start)
+{
+    if (profile.isEnabled && start != 0)
+        profile.current[section] += MonotonicNanoseconds() - start;
+}
+
+void        ProfileBeginFrame()
+{
+    if (profile.isEnabled && profile.frameStart == 0)
+        profile.frameStart = MonotonicNanoseconds();
+}
+
+void        ProfileEndFrame()
+{
+    if (!profile.isEnabled || profile.frameStart == 0)
+        return;
+
+    profile.current[PROFILE_FRAME] = MonotonicNanoseconds() - profile.frameStart;
+    profile.frameStart = 0;
+
+    // the render thread writes frames on its own, this frame gets whatever it spent writing since the last one
+    size_t writeTime = profile.writeTime;
+    profile.current[PROFILE_WRITE] = writeTime - profile.frameCounters[3];
+    profile.frameCounters[3] = writeTime;
+
+    size_t slot = profile.numberofFrames % PROFILE_HISTORY;
+    for (int section = 0; section < PROFILE_SECTIONS; section++)
+    {
+        profile.history[section][slot] = profile.current[section];
+        profile.current[section] = 0;
+    }
+
+    profile.numberofFrames++;
+    profile.lastAllocations = profile.allocations - profile.frameCounters[0];
+    profile.lastBytesWritten = profile.bytesWritten - profile.frameCounters[1];
+    profile.lastRowsHighlighted = profile.rowsHighlighted - profile.frameCounters[2];
+    profile.frameCounters[0] = profile.allocations;
+    profile.frameCounters[1] = profile.bytesWritten;
+    profile.frameCounters[2] = profile.rowsHighlighted;
+}
+
+uint64_t    ProfileLast(int section)
+{
+    if (profile.numberofFrames == 0)
+        return 0;
+
+    return profile.history[section][(profile.numberofFrames - 1) % PROFILE_HISTORY];
+}
+
+uint64_t    ProfilePercentile(int section, double percentile)
+{
+    size_t count = (profile.numberofFrames < PROFILE_HISTORY) ? profile.numberofFrames : PROFILE_HISTORY;
+
+    uint64_t samples[PROFILE_HISTORY];
+    memcpy(samples, profile.history[section], sizeof(uint64_t) * count);
+
+    LatencySamples latency = { samples, count, PROFILE_HISTORY };
+    return LatencySamplesPercentile(&latency, percentile);
+}
+
+int         ProfileDump(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+        return -1;
+
+    fprintf(file, "frames            %zu\n", profile.numberofFrames);
+    fprintf(file, "allocations       %zu\n", profile.allocations);
+    fprintf(file, "bytes written     %zu\n", profile.bytesWritten);
+    fprintf(file, "frames merged     %zu\n", profile.framesMerged);
+    fprintf(file, "frames dropped    %zu\n", profile.framesDropped);
+    fprintf(file, "rows highlighted  %zu\n", profile.rowsHighlighted);
+    fprintf(file, "\n%-8s %10s %10s %10s %10s   (last %d frames, us)\n", "section", "last", "p50", "p99", "max", PROFILE_HISTORY);
+
+    for (int section = 0; section < PROFILE_SECTIONS; section++)
+        fprintf(file, "%-8s %10.1f %10.1f %10.1f %10.1f\n", sectionNames[section],
+                ProfileLast(section) / 1e3, ProfilePercentile(section, 50) / 1e3,
+                ProfilePercentile(section, 99) / 1e3, ProfilePercentile(section, 100) / 1e3);
+
+    fclose(file);
+    return 0;
+}
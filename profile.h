@@ -0,0 +1,57 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "stats.h"
+
+/******* hot path instrumentation ********/
+
+#define PROFILE_HISTORY 256
+
+enum ProfileSection
+{
+    PROFILE_FRAME = 0,
+    PROFILE_INPUT,
+    PROFILE_SYNTAX,
+    PROFILE_DRAW,
+    PROFILE_WRITE,
+    PROFILE_SECTIONS
+};
+
+typedef struct
+{
+    bool             isEnabled;
+    bool             isOverlayVisible;
+    uint64_t         frameStart;
+    uint64_t         current[PROFILE_SECTIONS];
+    uint64_t         history[PROFILE_SECTIONS][PROFILE_HISTORY];
+    size_t           numberofFrames;
+    atomic_size_t    allocations;
+    atomic_size_t    bytesWritten;
+    atomic_size_t    writeTime;
+    atomic_size_t    framesMerged;
+    atomic_size_t    framesDropped;
+    size_t           rowsHighlighted;
+    size_t           lastAllocations;
+    size_t           lastBytesWritten;
+    size_t           lastRowsHighlighted;
+    size_t           frameCounters[4];
+
+} Profile;
+
+extern Profile profile;
+
+uint64_t    ProfileStart();
+
+void        ProfileStop(int section, uint64_t start);
+
+void        ProfileBeginFrame();
+
+void        ProfileEndFrame();
+
+uint64_t    ProfileLast(int section);
+
+uint64_t    ProfilePercentile(int section, double percentile);
+
+int         ProfileDump(const char* path);
+
+#endif // PROFILE_H
@@ -0,0 +1,210 @@
+#include "record.h"
+
+/******* recording ********/
+
+int                RecorderStart(KeyRecorder* recorder, const char* path, short unsigned int screenRows, short unsigned int screenColumns)
+{
+    int file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file == -1)
+        return -1;
+
+    char header[RECORDING_MAGIC_SIZE + 4];
+    memcpy(header, RECORDING_MAGIC, RECORDING_MAGIC_SIZE);
+    memcpy(&header[RECORDING_MAGIC_SIZE], &screenRows, 2);
+    memcpy(&header[RECORDING_MAGIC_SIZE + 2], &screenColumns, 2);
+
+    if (write(file, header, sizeof(header)) != sizeof(header))
+    {
+        close(file);
+        return -1;
+    }
+
+    recorder->file = file;
+    recorder->startTime = MonotonicNanoseconds();
+    return 0;
+}
+
+void               RecorderAppend(KeyRecorder* recorder, const char* data, size_t size)
+{
+    if (recorder->file == -1 || size == 0)
+        return;
+
+    char event[RECORDING_EVENT_HEADER + 16];
+    uint64_t time = MonotonicNanoseconds() - recorder->startTime;
+    uint32_t eventSize = size;
+
+    memcpy(event, &time, 8);
+    memcpy(&event[8], &eventSize, 4);
+
+    if (size <= 16)
+    {
+        memcpy(&event[RECORDING_EVENT_HEADER], data, size);
+        if (write(recorder->file, event, RECORDING_EVENT_HEADER + size) == -1)
+            RecorderStop(recorder);
+    }
+    else if (write(recorder->file, event, RECORDING_EVENT_HEADER) == -1 || write(recorder->file, data, size) == -1)
+        RecorderStop(recorder);
+}
+
+void               RecorderStop(KeyRecorder* recorder)
+{
+    if (recorder->file != -1)
+        close(recorder->file);
+
+    recorder->file = -1;
+}
+
+static ssize_t recorderRead(void* context, char* data, size_t size)
+{
+    ssize_t readSize = read(STDIN_FILENO, data, size);
+    if (readSize > 0)
+        RecorderAppend(context, data, readSize);
+
+    return readSize;
+}
+
+static ssize_t recorderWrite(void* context, const char* data, size_t size)
+{
+    (void)context;
+    return write(STDOUT_FILENO, data, size);
+}
+
+TerminalBackend    RecorderBackend(KeyRecorder* recorder)
+{
+    return (TerminalBackend){ recorderRead, recorderWrite, recorder };
+}
+
+/******* replay ********/
+
+int                ReplayLoad(KeyReplay* replay, const char* path)
+{
+    int file = open(path, O_RDONLY);
+    if (file == -1)
+        return -1;
+
+    struct stat info;
+    if (fstat(file, &info) == -1 || info.st_size < RECORDING_MAGIC_SIZE + 4)
+    {
+        close(file);
+        return -1;
+    }
+
+    char* data = malloc(info.st_size);
+    if (data == NULL)
+        die("malloc");
+
+    ssize_t readSize = 0;
+    size_t size = 0;
+    while (size < (size_t)info.st_size && (readSize = read(file, &data[size], info.st_size - size)) > 0)
+        size += readSize;
+
+    close(file);
+
+    if (readSize == -1 || memcmp(data, RECORDING_MAGIC, RECORDING_MAGIC_SIZE))
+    {
+        free(data);
+        return -1;
+    }
+
+    replay->data = data;
+    replay->size = size;
+    memcpy(&replay->screenRows, &data[RECORDING_MAGIC_SIZE], 2);
+    memcpy(&replay->screenColumns, &data[RECORDING_MAGIC_SIZE + 2], 2);
+    replay->position = RECORDING_MAGIC_SIZE + 4;
+    replay->eventOffset = 0;
+    replay->sleptTime = 0;
+    replay->bytesWritten = 0;
+    return 0;
+}
+
+static bool replayNextEvent(KeyReplay* replay, size_t position, uint64_t* time, uint32_t* size)
+{
+    if (position + RECORDING_EVENT_HEADER > replay->size)
+        return false;
+
+    memcpy(time, &replay->data[position], 8);
+    memcpy(size, &replay->data[position + 8], 4);
+    return position + RECORDING_EVENT_HEADER + *size <= replay->size;
+}
+
+bool               ReplayIsFinished(KeyReplay* replay)
+{
+    // the quit keystrokes that ended the session are not replayed
+    uint64_t time;
+    uint32_t size;
+    for (size_t position = replay->position; replayNextEvent(replay, position, &time, &size); position += RECORDING_EVENT_HEADER + size)
+    {
+        const char* event = &replay->data[position + RECORDING_EVENT_HEADER];
+        for (size_t i = (position == replay->position) ? replay->eventOffset : 0; i < size; i++)
+            if (event[i] != CTRL_KEY('q'))
+                return false;
+    }
+
+    return true;
+}
+
+void               ReplayFree(KeyReplay* replay)
+{
+    free(replay->data);
+    replay->data = NULL;
+    replay->size = 0;
+    replay->position = 0;
+    replay->eventOffset = 0;
+}
+
+static ssize_t replayRead(void* context, char* data, size_t size)
+{
+    KeyReplay* replay = context;
+
+    uint64_t time;
+    uint32_t eventSize;
+    if (!replayNextEvent(replay, replay->position, &time, &eventSize))
+    {
+        // an exhausted recording cancels whatever prompt is still open
+        *data = '\x1b';
+        return 1;
+    }
+
+    if (replay->isRealTime && replay->eventOffset == 0)
+    {
+        uint64_t now = MonotonicNanoseconds();
+        uint64_t due = replay->startTime + time;
+        if (due > now)
+        {
+            uint64_t wait = due - now;
+            struct timespec delay = { wait / 1000000000, wait % 1000000000 };
+            nanosleep(&delay, NULL);
+            replay->sleptTime += wait;
+        }
+    }
+
+    size_t remaining = eventSize - replay->eventOffset;
+    if (size > remaining)
+        size = remaining;
+
+    memcpy(data, &replay->data[replay->position + RECORDING_EVENT_HEADER + replay->eventOffset], size);
+    replay->eventOffset += size;
+
+    if (replay->eventOffset == eventSize)
+    {
+        replay->position += RECORDING_EVENT_HEADER + eventSize;
+        replay->eventOffset = 0;
+    }
+
+    return size;
+}
+
+static ssize_t replayWrite(void* context, const char* data, size_t size)
+{
+    KeyReplay* replay = context;
+    (void)data;
+    replay->bytesWritten += size;
+    return size;
+}
+
+TerminalBackend    ReplayBackend(KeyReplay* replay)
+{
+    replay->startTime = MonotonicNanoseconds();
+    replay->sleptTime = 0;
+    return (TerminalBackend){ replayRead, replayWrite, replay };
+}
@@ -0,0 +1,54 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include "stats.h"
+
+/******* keystroke recording and replay ********/
+
+#define RECORDING_MAGIC          "NEOREC1\n"
+#define RECORDING_MAGIC_SIZE     8
+#define RECORDING_EVENT_HEADER   12
+
+typedef struct
+{
+    int         file;
+    uint64_t    startTime;
+
+} KeyRecorder;
+
+#define KEY_RECORDER_INIT { -1, 0 }
+
+typedef struct
+{
+    char*                 data;
+    size_t                size;
+    size_t                position;
+    size_t                eventOffset;
+    short unsigned int    screenRows;
+    short unsigned int    screenColumns;
+    bool                  isRealTime;
+    uint64_t              startTime;
+    uint64_t              sleptTime;
+    size_t                bytesWritten;
+
+} KeyReplay;
+
+#define KEY_REPLAY_INIT { NULL, 0, 0, 0, 0, 0, false, 0, 0, 0 }
+
+int                RecorderStart(KeyRecorder* recorder, const char* path, short unsigned int screenRows, short unsigned int screenColumns);
+
+void               RecorderAppend(KeyRecorder* recorder, const char* data, size_t size);
+
+void               RecorderStop(KeyRecorder* recorder);
+
+TerminalBackend    RecorderBackend(KeyRecorder* recorder);
+
+int                ReplayLoad(KeyReplay* replay, const char* path);
+
+bool               ReplayIsFinished(KeyReplay* replay);
+
+void               ReplayFree(KeyReplay* replay);
+
+TerminalBackend    ReplayBackend(KeyReplay* replay);
+
+#endif // RECORD_H
@@ -0,0 +1,242 @@
+#include "render.h"
+
+Renderer renderer = { NULL, NULL, false, false, false, 0, -1, 1000000000 / RENDER_DEFAULT_FRAME_RATE, false, false };
+
+/******* frames ********/
+
+RenderFrame*    RenderFrameNew(size_t numberofLines, size_t screenColumns)
+{
+    RenderFrame* frame = malloc(sizeof(RenderFrame));
+    if (frame == NULL)
+        die("malloc");
+
+    frame->lineEnds = calloc(numberofLines + 1, sizeof(size_t));
+    if (frame->lineEnds == NULL)
+        die("calloc");
+
+    frame->text = (ScreenBuffer)SCREEN_BUFFER_INIT;
+    frame->numberofLines = numberofLines;
+    frame->screenColumns = screenColumns;
+    frame->cursorX = 0;
+    frame->cursorY = 0;
+    return frame;
+}
+
+void            RenderFrameFree(RenderFrame* frame)
+{
+    if (frame == NULL)
+        return;
+
+    ScreenBufferFree(&frame->text);
+    free(frame->lineEnds);
+    free(frame);
+}
+
+static size_t renderLineStart(RenderFrame* frame, size_t line)
+{
+    return (line == 0) ? 0 : frame->lineEnds[line - 1];
+}
+
+static bool renderLineEquals(RenderFrame* frame, RenderFrame* other, size_t line)
+{
+    size_t start = renderLineStart(frame, line), otherStart = renderLineStart(other, line);
+    size_t size = frame->lineEnds[line] - start;
+
+    return size == other->lineEnds[line] - otherStart && memcmp(&frame->text.string[start], &other->text.string[otherStart], size) == 0;
+}
+
+// markers drawn after the last line can land anywhere on the screen
+static bool renderOverlayEquals(RenderFrame* frame, RenderFrame* other)
+{
+    size_t start = frame->lineEnds[frame->numberofLines - 1], otherStart = other->lineEnds[other->numberofLines - 1];
+    size_t size = frame->text.size - start;
+
+    return size == other->text.size - otherStart && memcmp(&frame->text.string[start], &other->text.string[otherStart], size) == 0;
+}
+
+/******* writing frames ********/
+
+static void renderDraw(RenderFrame* frame)
+{
+    RenderFrame* shown = renderer.shown;
+    bool isInvalid = atomic_exchange(&renderer.isInvalid, false);
+
+    bool isFull = isInvalid || shown == NULL || frame->numberofLines == 0 ||
+                  shown->numberofLines != frame->numberofLines || shown->screenColumns != frame->screenColumns ||
+                  !renderOverlayEquals(frame, shown);
+
+    // a synchronized update is painted by the terminal in one go, otherwise the cursor is hidden while lines change
+    ScreenBuffer sbuf = SCREEN_BUFFER_INIT;
+    if (renderer.isSynchronized)
+        ScreenBufferAppend(&sbuf, "\x1b[?2026h", 8);
+    else
+        ScreenBufferAppend(&sbuf, "\x1b[?25l", 6);
+
+    char buffer[32];
+    for (size_t i = 0; i < frame->numberofLines; i++)
+    {
+        if (!isFull && renderLineEquals(frame, shown, i))
+            continue;
+
+        size_t start = renderLineStart(frame, i);
+        int len = snprintf(buffer, sizeof(buffer), "\x1b[%zu;1H", i + 1);
+        ScreenBufferAppend(&sbuf, buffer, len);
+        ScreenBufferAppend(&sbuf, &frame->text.string[start], frame->lineEnds[i] - start);
+    }
+
+    // markers are redrawn every time, a rewritten line would otherwise wipe the ones on it
+    if (frame->numberofLines > 0)
+    {
+        size_t start = frame->lineEnds[frame->numberofLines - 1];
+        ScreenBufferAppend(&sbuf, &frame->text.string[start], frame->text.size - start);
+    }
+
+    int len = snprintf(buffer, sizeof(buffer), "\x1b[%zu;%zuH", frame->cursorY + 1, frame->cursorX + 1);
+    ScreenBufferAppend(&sbuf, buffer, len);
+    if (renderer.isSynchronized)
+        ScreenBufferAppend(&sbuf, "\x1b[?2026l", 8);
+    else
+        ScreenBufferAppend(&sbuf, "\x1b[?25h", 6);
+
+    atomic_store(&renderer.isWriting, true);
+    uint64_t writeStart = ProfileStart();
+    TerminalWrite(sbuf.string, sbuf.size);
+    if (writeStart != 0)
+        profile.writeTime += MonotonicNanoseconds() - writeStart;
+    atomic_store(&renderer.isWriting, false);
+    ScreenBufferFree(&sbuf);
+
+    RenderFrameFree(shown);
+    renderer.shown = frame;
+}
+
+static void renderSignal()
+{
+    uint64_t value = 1;
+    while (write(renderer.wake, &value, sizeof(value)) == -1 && errno == EINTR);
+}
+
+static void* renderLoop(void* argument)
+{
+    (void)argument;
+    uint64_t nextFrameTime = 0;
+
+    while (true)
+    {
+        // a frame waiting before its slot is left in place, anything published until then replaces it
+        int timeout = -1;
+        if (atomic_load(&renderer.pending) != NULL)
+        {
+            uint64_t now = MonotonicNanoseconds();
+            timeout = (now >= nextFrameTime) ? 0 : (int)((nextFrameTime - now + 999999) / 1000000);
+        }
+
+        struct pollfd descriptor = { renderer.wake, POLLIN, 0 };
+        if (poll(&descriptor, 1, timeout) == -1 && errno != EINTR)
+            break;
+
+        uint64_t value;
+        if (descriptor.revents & POLLIN)
+            while (read(renderer.wake, &value, sizeof(value)) == -1 && errno == EINTR);
+
+        if (atomic_load(&renderer.isStopping))
+            break;
+
+        uint64_t frameTime = MonotonicNanoseconds();
+        if (frameTime < nextFrameTime)
+            continue;
+
+        // only the newest frame is ever taken, the ones it replaced were already dropped by RenderPublish
+        RenderFrame* frame = atomic_exchange(&renderer.pending, NULL);
+        if (frame != NULL)
+        {
+            renderDraw(frame);
+            nextFrameTime = frameTime + renderer.frameInterval;
+        }
+    }
+
+    return NULL;
+}
+
+/******* render thread lifetime ********/
+
+int             RenderStart()
+{
+    renderer.wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (renderer.wake == -1)
+        return -1;
+
+    atomic_store(&renderer.isStopping, false);
+
+    // the render thread never takes signals, SIGWINCH stays on the main thread
+    sigset_t signals, previous;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous);
+
+    int status = pthread_create(&renderer.thread, NULL, renderLoop, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if (status != 0)
+    {
+        close(renderer.wake);
+        renderer.wake = -1;
+        return -1;
+    }
+
+    renderer.isRunning = true;
+    return 0;
+}
+
+void            RenderStop()
+{
+    if (renderer.isRunning)
+    {
+        atomic_store(&renderer.isStopping, true);
+        renderSignal();
+        pthread_join(renderer.thread, NULL);
+
+        close(renderer.wake);
+        renderer.wake = -1;
+        renderer.isRunning = false;
+    }
+
+    RenderFrameFree(atomic_exchange(&renderer.pending, NULL));
+    RenderFrameFree(renderer.shown);
+    renderer.shown = NULL;
+}
+
+/******* handing frames over ********/
+
+void            RenderSetFrameRate(unsigned int frameRate)
+{
+    renderer.frameInterval = (frameRate == 0) ? 0 : 1000000000 / frameRate;
+}
+
+void            RenderPublish(RenderFrame* frame)
+{
+    if (!renderer.isRunning)
+    {
+        renderDraw(frame);
+        return;
+    }
+
+    // a frame the render thread has not picked up yet is stale and is replaced, it was either
+    // waiting for its slot under the frame rate cap or held back by a terminal still taking the last one
+    RenderFrame* stale = atomic_exchange(&renderer.pending, frame);
+    if (stale != NULL)
+    {
+        if (atomic_load(&renderer.isWriting))
+            atomic_fetch_add(&profile.framesDropped, 1);
+        else
+            atomic_fetch_add(&profile.framesMerged, 1);
+
+        RenderFrameFree(stale);
+    }
+
+    renderSignal();
+}
+
+void            RenderInvalidate()
+{
+    atomic_store(&renderer.isInvalid, true);
+}
@@ -0,0 +1,52 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "buffer.h"
+
+/******* screen snapshots handed to the render thread ********/
+
+#define RENDER_DEFAULT_FRAME_RATE    60
+
+typedef struct
+{
+    ScreenBuffer    text;
+    size_t*         lineEnds;
+    size_t          numberofLines;
+    size_t          screenColumns;
+    size_t          cursorX;
+    size_t          cursorY;
+
+} RenderFrame;
+
+typedef struct
+{
+    _Atomic(RenderFrame*)    pending;
+    RenderFrame*             shown;
+    atomic_bool              isInvalid;
+    atomic_bool              isStopping;
+    atomic_bool              isWriting;
+    pthread_t                thread;
+    int                      wake;
+    uint64_t                 frameInterval;
+    bool                     isSynchronized;
+    bool                     isRunning;
+
+} Renderer;
+
+extern Renderer renderer;
+
+RenderFrame*    RenderFrameNew(size_t numberofLines, size_t screenColumns);
+
+void            RenderFrameFree(RenderFrame* frame);
+
+int             RenderStart();
+
+void            RenderStop();
+
+void            RenderSetFrameRate(unsigned int frameRate);
+
+void            RenderPublish(RenderFrame* frame);
+
+void            RenderInvalidate();
+
+#endif // RENDER_H
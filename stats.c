@@ -0,0 +1,97 @@
+#include "stats.h"
+
+uint64_t    MonotonicNanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void        LatencySamplesAdd(LatencySamples* latency, uint64_t nanoseconds)
+{
+    if (latency->count == latency->capacity)
+    {
+        latency->capacity = (latency->capacity == 0) ? 256 : latency->capacity * 2;
+        uint64_t* temp = realloc(latency->samples, sizeof(uint64_t) * latency->capacity);
+        if (temp == NULL)
+            die("realloc");
+        latency->samples = temp;
+    }
+
+    latency->samples[latency->count] = nanoseconds;
+    latency->count++;
+}
+
+static int compareSamples(const void* a, const void* b)
+{
+    uint64_t first = *(const uint64_t*)a;
+    uint64_t second = *(const uint64_t*)b;
+    return (first > second) - (first < second);
+}
+
+uint64_t    LatencySamplesPercentile(LatencySamples* latency, double percentile)
+{
+    if (latency->count == 0)
+        return 0;
+
+    qsort(latency->samples, latency->count, sizeof(uint64_t), compareSamples);
+
+    size_t index = (size_t)(percentile / 100.0 * (latency->count - 1) + 0.5);
+    if (index >= latency->count)
+        index = latency->count - 1;
+
+    return latency->samples[index];
+}
+
+uint64_t    LatencySamplesTotal(LatencySamples* latency)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < latency->count; i++)
+        total += latency->samples[i];
+
+    return total;
+}
+
+void        LatencySamplesPrintHistogram(LatencySamples* latency, FILE* output)
+{
+    // power-of-two microsecond buckets, the last one catches everything above a second
+    size_t buckets[22] = { 0 };
+    size_t largest = 0;
+
+    for (size_t i = 0; i < latency->count; i++)
+    {
+        uint64_t microseconds = latency->samples[i] / 1000;
+        size_t bucket = 0;
+        while (bucket < 21 && microseconds >= (1ULL << bucket))
+            bucket++;
+
+        buckets[bucket]++;
+        if (buckets[bucket] > largest)
+            largest = buckets[bucket];
+    }
+
+    for (size_t bucket = 0; bucket < 22; bucket++)
+    {
+        if (buckets[bucket] == 0)
+            continue;
+
+        unsigned long long low = (bucket == 0) ? 0 : 1ULL << (bucket - 1);
+        char range[32];
+        if (bucket == 21)
+            snprintf(range, sizeof(range), ">= %llu us", low);
+        else
+            snprintf(range, sizeof(range), "%llu-%llu us", low, 1ULL << bucket);
+
+        int barLength = (int)(buckets[bucket] * 40 / largest);
+        fprintf(output, "%16s %8zu |%.*s\n", range, buckets[bucket], barLength ? barLength : 1,
+                "########################################");
+    }
+}
+
+void        LatencySamplesFree(LatencySamples* latency)
+{
+    free(latency->samples);
+    latency->samples = NULL;
+    latency->count = 0;
+    latency->capacity = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "terminal.h"
+
+/******* timing and latency statistics ********/
+
+typedef struct
+{
+    uint64_t*    samples;
+    size_t       count;
+    size_t       capacity;
+
+} LatencySamples;
+
+#define LATENCY_SAMPLES_INIT { NULL, 0, 0 }
+
+uint64_t    MonotonicNanoseconds();
+
+void        LatencySamplesAdd(LatencySamples* latency, uint64_t nanoseconds);
+
+uint64_t    LatencySamplesPercentile(LatencySamples* latency, double percentile);
+
+uint64_t    LatencySamplesTotal(LatencySamples* latency);
+
+void        LatencySamplesPrintHistogram(LatencySamples* latency, FILE* output);
+
+void        LatencySamplesFree(LatencySamples* latency);
+
+#endif // STATS_H
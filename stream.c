@@ -0,0 +1,249 @@
+#include "stream.h"
+
+/******* standard input ********/
+
+int          StreamTakeStdin(void)
+{
+    if (isatty(STDIN_FILENO))
+        return -1;
+
+    // keep the pipe on a new descriptor and give standard input back to the terminal for raw mode
+    int file = dup(STDIN_FILENO);
+    if (file == -1)
+        return -1;
+
+    int terminal = open("/dev/tty", O_RDWR | O_CLOEXEC);
+    if (terminal == -1 || dup2(terminal, STDIN_FILENO) == -1)
+    {
+        close(file);
+        if (terminal != -1)
+            close(terminal);
+        return -1;
+    }
+
+    close(terminal);
+    return file;
+}
+
+/******* reader thread ********/
+
+static void streamSignal(int event)
+{
+    uint64_t value = 1;
+    while (write(event, &value, sizeof(value)) == -1 && errno == EINTR);
+}
+
+static void streamDrain(int event)
+{
+    uint64_t value;
+    while (read(event, &value, sizeof(value)) == -1 && errno == EINTR);
+}
+
+static void streamPush(StreamReader* stream, StreamChunk* chunk, bool isFinished, int error)
+{
+    pthread_mutex_lock(&stream->lock);
+
+    if (chunk != NULL)
+    {
+        if (stream->tail != NULL)
+            stream->tail->next = chunk;
+        else
+            stream->head = chunk;
+
+        stream->tail = chunk;
+        stream->queuedBytes += chunk->size;
+        stream->totalBytes += chunk->size;
+    }
+
+    stream->isFinished = isFinished;
+    stream->error = error;
+    streamSignal(stream->notify);
+
+    pthread_mutex_unlock(&stream->lock);
+}
+
+static void* streamReadLoop(void* argument)
+{
+    StreamReader* stream = argument;
+
+    while (true)
+    {
+        pthread_mutex_lock(&stream->lock);
+        bool isStopping = stream->isStopping;
+        bool isFull = stream->queuedBytes >= STREAM_QUEUE_BUDGET;
+        pthread_mutex_unlock(&stream->lock);
+
+        if (isStopping)
+            break;
+
+        // while the queue is full only a wake from StreamTake or StreamStop is waited for
+        struct pollfd descriptors[2] = {
+            { stream->wake, POLLIN, 0 },
+            { stream->file, POLLIN, 0 }
+        };
+
+        if (poll(descriptors, isFull ? 1 : 2, -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+
+            streamPush(stream, NULL, true, errno);
+            break;
+        }
+
+        if (descriptors[0].revents & POLLIN)
+        {
+            streamDrain(stream->wake);
+            continue;
+        }
+
+        StreamChunk* chunk = malloc(sizeof(StreamChunk) + STREAM_READ_CHUNK);
+        if (chunk == NULL)
+            die("malloc");
+
+        chunk->next = NULL;
+        chunk->size = 0;
+
+        // batch whatever the pipe already holds so a fast writer is ingested in large chunks
+        ssize_t readSize;
+        struct pollfd pending = { stream->file, POLLIN, 0 };
+        do
+        {
+            readSize = read(stream->file, &chunk->data[chunk->size], STREAM_READ_CHUNK - chunk->size);
+            if (readSize > 0)
+                chunk->size += readSize;
+        }
+        while ((readSize > 0 || (readSize == -1 && errno == EINTR)) && chunk->size < STREAM_READ_CHUNK && poll(&pending, 1, 0) == 1);
+
+        bool isFinished = (readSize == 0 || (readSize == -1 && errno != EINTR && errno != EAGAIN));
+        int error = (readSize == -1 && isFinished) ? errno : 0;
+
+        if (chunk->size == 0)
+        {
+            free(chunk);
+            chunk = NULL;
+        }
+        else if (chunk->size < STREAM_READ_CHUNK)
+        {
+            // a slow writer yields many small chunks, only their data stays allocated while queued
+            StreamChunk* temp = realloc(chunk, sizeof(StreamChunk) + chunk->size);
+            if (temp != NULL)
+                chunk = temp;
+        }
+
+        if (chunk != NULL || isFinished)
+            streamPush(stream, chunk, isFinished, error);
+
+        if (isFinished)
+            break;
+    }
+
+    return NULL;
+}
+
+/******* stream lifetime ********/
+
+StreamReader* StreamStart(int file)
+{
+    StreamReader* stream = calloc(1, sizeof(StreamReader));
+    if (stream == NULL)
+        die("calloc");
+
+    stream->file = file;
+    stream->notify = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    stream->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pthread_mutex_init(&stream->lock, NULL);
+
+    // the reader never takes signals, SIGWINCH stays on the main thread
+    sigset_t signals, previous;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous);
+
+    int status = (stream->notify == -1 || stream->wake == -1) ? -1 : pthread_create(&stream->thread, NULL, streamReadLoop, stream);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if (status != 0)
+    {
+        if (stream->notify != -1)
+            close(stream->notify);
+        if (stream->wake != -1)
+            close(stream->wake);
+
+        pthread_mutex_destroy(&stream->lock);
+        free(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+void         StreamStop(StreamReader* stream)
+{
+    if (stream == NULL)
+        return;
+
+    pthread_mutex_lock(&stream->lock);
+    stream->isStopping = true;
+    pthread_mutex_unlock(&stream->lock);
+
+    streamSignal(stream->wake);
+    pthread_join(stream->thread, NULL);
+
+    StreamFreeChunks(stream->head);
+    close(stream->file);
+    close(stream->notify);
+    close(stream->wake);
+    pthread_mutex_destroy(&stream->lock);
+    free(stream);
+}
+
+/******* handing chunks to the editor ********/
+
+StreamChunk* StreamTake(StreamReader* stream, size_t budget, bool* isFinished)
+{
+    pthread_mutex_lock(&stream->lock);
+
+    bool wasFull = stream->queuedBytes >= STREAM_QUEUE_BUDGET;
+    StreamChunk* chunks = stream->head;
+    StreamChunk* last = NULL;
+    size_t size = 0;
+
+    while (stream->head != NULL && (last == NULL || size < budget))
+    {
+        last = stream->head;
+        size += last->size;
+        stream->head = last->next;
+    }
+
+    if (last != NULL)
+        last->next = NULL;
+    else
+        chunks = NULL;
+
+    if (stream->head == NULL)
+        stream->tail = NULL;
+
+    stream->queuedBytes -= size;
+
+    // the notification stays raised while chunks are left for the next pass
+    if (stream->head == NULL && !stream->isFinished)
+        streamDrain(stream->notify);
+
+    *isFinished = (stream->head == NULL && stream->isFinished);
+
+    if (wasFull && stream->queuedBytes < STREAM_QUEUE_BUDGET)
+        streamSignal(stream->wake);
+
+    pthread_mutex_unlock(&stream->lock);
+    return chunks;
+}
+
+void         StreamFreeChunks(StreamChunk* chunks)
+{
+    while (chunks != NULL)
+    {
+        StreamChunk* next = chunks->next;
+        free(chunks);
+        chunks = next;
+    }
+}
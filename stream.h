@@ -0,0 +1,48 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "terminal.h"
+
+/******* reading a pipe into the editor on a background thread ********/
+
+#define STREAM_READ_CHUNK       (1024 * 1024)
+#define STREAM_QUEUE_BUDGET     (64L * 1024 * 1024)
+#define STREAM_INGEST_BUDGET    (1024 * 1024)
+
+typedef struct StreamChunk
+{
+    struct StreamChunk*    next;
+    size_t                 size;
+    char                   data[];
+
+} StreamChunk;
+
+typedef struct
+{
+    int                file;
+    int                notify;
+    int                wake;
+    pthread_t          thread;
+    pthread_mutex_t    lock;
+    StreamChunk*       head;
+    StreamChunk*       tail;
+    size_t             queuedBytes;
+    size_t             totalBytes;
+    int                error;
+    bool               isFinished;
+    bool               isStopping;
+    bool               lineOpen;
+
+} StreamReader;
+
+int          StreamTakeStdin(void);
+
+StreamReader* StreamStart(int file);
+
+void         StreamStop(StreamReader* stream);
+
+StreamChunk* StreamTake(StreamReader* stream, size_t budget, bool* isFinished);
+
+void         StreamFreeChunks(StreamChunk* chunks);
+
+#endif // STREAM_H
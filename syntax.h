@@ -1,6 +1,8 @@
 #ifndef SYNTAX_H
 #define SYNTAX_H
 
+/******* built-in definitions, used for languages without a file in syntax/ ********/
+
 char* CfileExtensions[] = {".c", ".h", NULL};
 
 char* CppfileExtensions[] = {".cpp", ".hpp",NULL};
@@ -45,7 +47,8 @@ Syntax HLDB[] =
         Ckeywords,
         Ctypes,
         "//", "/*", "*/",
-        HIGHLIGHT_ALL
+        HIGHLIGHT_ALL,
+        NULL
     },
     {
         "C++",
@@ -53,7 +56,8 @@ Syntax HLDB[] =
         Cppkeywords,
         Cpptypes,
         "//", "/*", "*/",
-        HIGHLIGHT_ALL
+        HIGHLIGHT_ALL,
+        NULL
     },
     {
         NULL,
@@ -63,7 +67,8 @@ Syntax HLDB[] =
         NULL,
         NULL,
         NULL,
-        0
+        0,
+        NULL
     }
 };
 
@@ -1,9 +1,65 @@
 #include "terminal.h"
+#include "profile.h"
+
+static TerminalBackend* terminalBackend = NULL;
+
+void TerminalSetBackend(TerminalBackend* backend)
+{
+    terminalBackend = backend;
+}
+
+ssize_t TerminalRead(char* data, size_t size)
+{
+    if (terminalBackend != NULL)
+        return terminalBackend->read(terminalBackend->context, data, size);
+
+    return read(STDIN_FILENO, data, size);
+}
+
+ssize_t TerminalWrite(const char* data, size_t size)
+{
+    profile.bytesWritten += size;
+
+    if (terminalBackend != NULL)
+        return terminalBackend->write(terminalBackend->context, data, size);
+
+    return write(STDOUT_FILENO, data, size);
+}
+
+// replayed and benchmarked keys have no descriptor to wait on
+int TerminalInputDescriptor()
+{
+    return (terminalBackend == NULL) ? STDIN_FILENO : -1;
+}
+
+// the cursor position report comes after the mode report, so a terminal that ignores the query still ends the read
+bool TerminalQuerySynchronizedOutput()
+{
+    if (TerminalWrite("\x1b[?2026$p\x1b[6n", 13) != 13)
+        return false;
+
+    char buffer[64];
+    unsigned int i = 0;
+    while (i < sizeof(buffer) - 1)
+    {
+        if (TerminalRead(&buffer[i], 1) != 1)
+            break;
+        if (buffer[i] == 'R')
+            break;
+        i++;
+    }
+    buffer[i] = '\0';
+
+    // 1 and 2 report the mode as set or reset, anything else means it cannot be switched
+    int mode;
+    char* report = strstr(buffer, "\x1b[?2026;");
+    return report != NULL && sscanf(report, "\x1b[?2026;%d$y", &mode) == 1 && (mode == 1 || mode == 2);
+}
 
 void die(const char* source)
 {
-    write(STDOUT_FILENO, "\x1b[2J", 4);
-    write(STDOUT_FILENO, "\x1b[H", 3);
+    TerminalWrite("\x1b[2J", 4);
+    TerminalWrite("\x1b[H", 3);
 
     perror(source);
     exit(1);
@@ -13,7 +69,7 @@ short int readKeypress()
 {
     int readSize;
     char input;
-    while ((readSize = read(STDIN_FILENO, &input, 1)) != 1)
+    while ((readSize = TerminalRead(&input, 1)) != 1)
     {
         if (readSize == -1 && errno != EAGAIN)
             die("read");
@@ -23,16 +79,16 @@ short int readKeypress()
     {
         char sequence[3];
 
-        if (read(STDIN_FILENO, &sequence[0], 1) != 1)
+        if (TerminalRead(&sequence[0], 1) != 1)
             return '\x1b';
-        if (read(STDIN_FILENO, &sequence[1], 1) != 1)
+        if (TerminalRead(&sequence[1], 1) != 1)
             return '\x1b';
 
         if (sequence[0] == '[')
         {
             if (sequence[1] >= '0' && sequence[1] <= '9')
             {
-                if (read(STDIN_FILENO, &sequence[2], 1) != 1)
+                if (TerminalRead(&sequence[2], 1) != 1)
                     return '\x1b';
                 if (sequence[2] == '~')
                 {
@@ -54,6 +110,41 @@ short int readKeypress()
                             return END_KEY;
                     }
                 }
+                else if (sequence[1] == '1' && sequence[2] == ';')
+                {
+                    char modifier[2];
+                    if (TerminalRead(&modifier[0], 1) != 1 || TerminalRead(&modifier[1], 1) != 1)
+                        return '\x1b';
+
+                    if (modifier[0] == '2')
+                    {
+                        switch (modifier[1])
+                        {
+                            case 'A':
+                                return SHIFT_ARROW_UP;
+                            case 'B':
+                                return SHIFT_ARROW_DOWN;
+                            case 'C':
+                                return SHIFT_ARROW_RIGHT;
+                            case 'D':
+                                return SHIFT_ARROW_LEFT;
+                            case 'H':
+                                return SHIFT_HOME_KEY;
+                            case 'F':
+                                return SHIFT_END_KEY;
+                        }
+                    }
+                    else if (modifier[0] == '5')
+                    {
+                        switch (modifier[1])
+                        {
+                            case 'H':
+                                return CTRL_HOME_KEY;
+                            case 'F':
+                                return CTRL_END_KEY;
+                        }
+                    }
+                }
             }
             else
             {
@@ -16,9 +16,37 @@ enum Key
     HOME_KEY,
     END_KEY,
     PAGE_UP,
-    PAGE_DOWN
+    PAGE_DOWN,
+    SHIFT_ARROW_LEFT,
+    SHIFT_ARROW_RIGHT,
+    SHIFT_ARROW_UP,
+    SHIFT_ARROW_DOWN,
+    SHIFT_HOME_KEY,
+    SHIFT_END_KEY,
+    CTRL_HOME_KEY,
+    CTRL_END_KEY
 };
 
+/******* terminal input and output ********/
+
+typedef struct
+{
+    ssize_t    (*read)(void* context, char* data, size_t size);
+    ssize_t    (*write)(void* context, const char* data, size_t size);
+    void*      context;
+
+} TerminalBackend;
+
+void         TerminalSetBackend(TerminalBackend* backend);
+
+ssize_t      TerminalRead(char* data, size_t size);
+
+ssize_t      TerminalWrite(const char* data, size_t size);
+
+int          TerminalInputDescriptor();
+
+bool         TerminalQuerySynchronizedOutput();
+
 /******* initializing the terminal ********/
 
 void         die(const char* source);
@@ -0,0 +1,359 @@
+#include "transform.h"
+
+/******* moving rows without touching their text ********/
+
+static void transformRenumber(TextBuffer* tbuf, size_t first)
+{
+    for (size_t i = first; i < tbuf->numberofTextRows; i++)
+        tbuf->textRow[i].index = i;
+
+    if (first == 0 && tbuf->numberofTextRows > 0)
+        tbuf->textRow[0].incomingComment = false;
+
+    // rows keep their highlighting, the next draw re-derives it in one pass wherever a row's incoming comment state changed
+    TextBufferUpdateSyntax(tbuf, first);
+}
+
+static void transformPermute(TextBuffer* tbuf, size_t first, const size_t* order, size_t count)
+{
+    TextRow* rows = malloc(sizeof(TextRow) * count);
+    if (rows == NULL)
+        die("malloc");
+
+    for (size_t i = 0; i < count; i++)
+        rows[i] = tbuf->textRow[first + order[i]];
+
+    memcpy(&tbuf->textRow[first], rows, sizeof(TextRow) * count);
+    free(rows);
+
+    transformRenumber(tbuf, first);
+}
+
+static size_t transformCompact(TextBuffer* tbuf, size_t first, size_t last, const bool* isKept)
+{
+    size_t target = first;
+    for (size_t i = first; i < last; i++)
+    {
+        if (isKept[i - first])
+            tbuf->textRow[target++] = tbuf->textRow[i];
+        else
+            TextRowFree(&tbuf->textRow[i]);
+    }
+
+    size_t removed = last - target;
+    if (removed == 0)
+        return 0;
+
+    memmove(&tbuf->textRow[target], &tbuf->textRow[last], sizeof(TextRow) * (tbuf->numberofTextRows - last));
+    tbuf->numberofTextRows -= removed;
+
+    transformRenumber(tbuf, first);
+    return removed;
+}
+
+/******* parallel merge sort ********/
+
+typedef struct
+{
+    TextBuffer*    tbuf;
+    size_t         first;
+    int            flags;
+    double*        keys;
+    size_t*        order;
+    size_t*        scratch;
+
+} TransformSort;
+
+typedef struct
+{
+    TransformSort*    sort;
+    const size_t*     source;
+    size_t*           target;
+    size_t            start;
+    size_t            middle;
+    size_t            end;
+
+} TransformTask;
+
+static double transformNumber(const char* text, size_t size)
+{
+    // a leading decimal number like sort -n reads it, lines without one count as zero
+    size_t i = 0;
+    while (i < size && isspace((unsigned char)text[i]))
+        i++;
+
+    bool isNegative = (i < size && text[i] == '-');
+    if (i < size && (text[i] == '-' || text[i] == '+'))
+        i++;
+
+    double value = 0;
+    for (; i < size && isdigit((unsigned char)text[i]); i++)
+        value = value * 10 + (text[i] - '0');
+
+    if (i < size && text[i] == '.')
+    {
+        double scale = 0.1;
+        for (i++; i < size && isdigit((unsigned char)text[i]); i++, scale /= 10)
+            value += (text[i] - '0') * scale;
+    }
+
+    return isNegative ? -value : value;
+}
+
+static int transformCompare(TransformSort* sort, size_t a, size_t b)
+{
+    int result;
+    if (sort->flags & TRANSFORM_NUMERIC)
+        result = (sort->keys[a] > sort->keys[b]) - (sort->keys[a] < sort->keys[b]);
+    else
+    {
+        TextRow* left = &sort->tbuf->textRow[sort->first + a];
+        TextRow* right = &sort->tbuf->textRow[sort->first + b];
+
+        result = memcmp(left->text, right->text, (left->textSize < right->textSize) ? left->textSize : right->textSize);
+        if (result == 0)
+            result = (left->textSize > right->textSize) - (left->textSize < right->textSize);
+    }
+
+    return (sort->flags & TRANSFORM_REVERSE) ? -result : result;
+}
+
+// equal rows always take the left side first, so every mode keeps equal lines in their original order
+static void transformMerge(TransformSort* sort, const size_t* source, size_t* target, size_t start, size_t middle, size_t end)
+{
+    size_t left = start, right = middle, out = start;
+    while (left < middle && right < end)
+        target[out++] = (transformCompare(sort, source[right], source[left]) < 0) ? source[right++] : source[left++];
+
+    memcpy(&target[out], &source[left], sizeof(size_t) * (middle - left));
+    out += middle - left;
+    memcpy(&target[out], &source[right], sizeof(size_t) * (end - right));
+}
+
+// merges runs of width rows pairwise from one array into the other until a single run is left, returns where it ended up
+static size_t* transformMergeRuns(TransformSort* sort, size_t start, size_t end, size_t width)
+{
+    size_t* source = sort->order;
+    size_t* target = sort->scratch;
+
+    for (; width < end - start; width *= 2)
+    {
+        for (size_t left = start; left < end; left += 2 * width)
+        {
+            size_t middle = (end - left > width) ? left + width : end;
+            size_t right = (end - middle > width) ? middle + width : end;
+            transformMerge(sort, source, target, left, middle, right);
+        }
+
+        size_t* temp = source;
+        source = target;
+        target = temp;
+    }
+
+    return source;
+}
+
+// runs on a worker: each chunk owns its slice of keys, order and scratch, rows are only read
+static void transformSortChunk(void* argument, PoolToken* token)
+{
+    (void)token;
+    TransformTask* task = argument;
+    TransformSort* sort = task->sort;
+
+    for (size_t i = task->start; i < task->end; i++)
+    {
+        sort->order[i] = i;
+        if (sort->flags & TRANSFORM_NUMERIC)
+            sort->keys[i] = transformNumber(sort->tbuf->textRow[sort->first + i].text, sort->tbuf->textRow[sort->first + i].textSize);
+    }
+
+    // short runs are insertion sorted in place before merging
+    for (size_t run = task->start; run < task->end; run += TRANSFORM_RUN_ROWS)
+    {
+        size_t runEnd = (task->end - run > TRANSFORM_RUN_ROWS) ? run + TRANSFORM_RUN_ROWS : task->end;
+        for (size_t i = run + 1; i < runEnd; i++)
+        {
+            size_t current = sort->order[i];
+            size_t j = i;
+            for (; j > run && transformCompare(sort, sort->order[j - 1], current) > 0; j--)
+                sort->order[j] = sort->order[j - 1];
+            sort->order[j] = current;
+        }
+    }
+
+    size_t* sorted = transformMergeRuns(sort, task->start, task->end, TRANSFORM_RUN_ROWS);
+    if (sorted != sort->order)
+        memcpy(&sort->order[task->start], &sorted[task->start], sizeof(size_t) * (task->end - task->start));
+}
+
+static void transformMergeTask(void* argument, PoolToken* token)
+{
+    (void)token;
+    TransformTask* task = argument;
+    transformMerge(task->sort, task->source, task->target, task->start, task->middle, task->end);
+}
+
+void    TransformSortRows(TextBuffer* tbuf, size_t first, size_t last, int flags)
+{
+    if (last > tbuf->numberofTextRows)
+        last = tbuf->numberofTextRows;
+
+    if (last <= first + 1)
+        return;
+
+    size_t count = last - first;
+    size_t numberofChunks = (count + TRANSFORM_CHUNK_ROWS - 1) / TRANSFORM_CHUNK_ROWS;
+
+    TransformSort sort = { tbuf, first, flags, NULL, malloc(sizeof(size_t) * count), malloc(sizeof(size_t) * count) };
+    TransformTask* tasks = malloc(sizeof(TransformTask) * numberofChunks);
+    if (sort.order == NULL || sort.scratch == NULL || tasks == NULL)
+        die("malloc");
+
+    if (flags & TRANSFORM_NUMERIC)
+    {
+        sort.keys = malloc(sizeof(double) * count);
+        if (sort.keys == NULL)
+            die("malloc");
+    }
+
+    // chunks are sorted on the pool, then merged pairwise a round at a time with every merge of a round on its own worker
+    PoolToken token = POOL_TOKEN_INIT;
+    for (size_t i = 0; i < numberofChunks; i++)
+    {
+        size_t start = i * TRANSFORM_CHUNK_ROWS;
+        size_t end = (count - start > TRANSFORM_CHUNK_ROWS) ? start + TRANSFORM_CHUNK_ROWS : count;
+
+        tasks[i] = (TransformTask){ &sort, NULL, NULL, start, end, end };
+        PoolSubmit(POOL_PRIORITY_VIEWPORT, transformSortChunk, NULL, &tasks[i], &token);
+    }
+
+    PoolWait(&token);
+
+    size_t* source = sort.order;
+    size_t* target = sort.scratch;
+    for (size_t width = TRANSFORM_CHUNK_ROWS; width < count; width *= 2)
+    {
+        size_t numberofTasks = 0;
+        for (size_t left = 0; left < count; left += 2 * width)
+        {
+            size_t middle = (count - left > width) ? left + width : count;
+            size_t right = (count - middle > width) ? middle + width : count;
+
+            tasks[numberofTasks] = (TransformTask){ &sort, source, target, left, middle, right };
+            PoolSubmit(POOL_PRIORITY_VIEWPORT, transformMergeTask, NULL, &tasks[numberofTasks], &token);
+            numberofTasks++;
+        }
+
+        PoolWait(&token);
+
+        size_t* temp = source;
+        source = target;
+        target = temp;
+    }
+
+    transformPermute(tbuf, first, source, count);
+
+    free(sort.keys);
+    free(sort.order);
+    free(sort.scratch);
+    free(tasks);
+}
+
+/******* removing and reversing rows ********/
+
+size_t  TransformUniqueRows(TextBuffer* tbuf, size_t first, size_t last)
+{
+    if (last > tbuf->numberofTextRows)
+        last = tbuf->numberofTextRows;
+
+    if (last <= first + 1)
+        return 0;
+
+    // the first occurrence of every line is kept, found through an open addressed table of row positions plus one
+    size_t count = last - first;
+    size_t capacity = 64;
+    while (capacity < count * 2)
+        capacity *= 2;
+
+    size_t* slots = calloc(capacity, sizeof(size_t));
+    bool* isKept = malloc(sizeof(bool) * count);
+    if (slots == NULL)
+        die("calloc");
+    if (isKept == NULL)
+        die("malloc");
+
+    for (size_t i = 0; i < count; i++)
+    {
+        TextRow* row = &tbuf->textRow[first + i];
+
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t j = 0; j < row->textSize; j++)
+            hash = (hash ^ (unsigned char)row->text[j]) * 1099511628211ULL;
+
+        size_t slot = hash & (capacity - 1);
+        isKept[i] = true;
+        for (; slots[slot] != 0; slot = (slot + 1) & (capacity - 1))
+        {
+            TextRow* other = &tbuf->textRow[first + slots[slot] - 1];
+            if (other->textSize == row->textSize && memcmp(other->text, row->text, row->textSize) == 0)
+            {
+                isKept[i] = false;
+                break;
+            }
+        }
+
+        if (isKept[i])
+            slots[slot] = i + 1;
+    }
+
+    size_t removed = transformCompact(tbuf, first, last, isKept);
+
+    free(slots);
+    free(isKept);
+    return removed;
+}
+
+void    TransformReverseRows(TextBuffer* tbuf, size_t first, size_t last)
+{
+    if (last > tbuf->numberofTextRows)
+        last = tbuf->numberofTextRows;
+
+    if (last <= first + 1)
+        return;
+
+    for (size_t i = first, j = last - 1; i < j; i++, j--)
+    {
+        TextRow temp = tbuf->textRow[i];
+        tbuf->textRow[i] = tbuf->textRow[j];
+        tbuf->textRow[j] = temp;
+    }
+
+    transformRenumber(tbuf, first);
+}
+
+size_t  TransformDeleteRows(TextBuffer* tbuf, size_t first, size_t last, const char* query, bool isMatching)
+{
+    if (last > tbuf->numberofTextRows)
+        last = tbuf->numberofTextRows;
+
+    if (last <= first)
+        return 0;
+
+    // matched against the rendered row, the same text the filtered view and search look at
+    TextBufferRestoreCache(tbuf);
+    bool* isKept = malloc(sizeof(bool) * (last - first));
+    if (isKept == NULL)
+        die("malloc");
+
+    for (size_t i = first; i < last; i++)
+    {
+        TextRow* row = &tbuf->textRow[i];
+        bool isMatch = row->render != NULL && strstr(row->render, query) != NULL;
+        isKept[i - first] = (isMatch != isMatching);
+    }
+
+    size_t removed = transformCompact(tbuf, first, last, isKept);
+
+    free(isKept);
+    return removed;
+}
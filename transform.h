@@ -0,0 +1,26 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "buffer.h"
+#include "pool.h"
+
+/******* reordering and removing whole rows of a text buffer ********/
+
+#define TRANSFORM_CHUNK_ROWS     16384
+#define TRANSFORM_RUN_ROWS       32
+
+enum TransformFlag
+{
+    TRANSFORM_NUMERIC    =    1,
+    TRANSFORM_REVERSE    =    2
+};
+
+void    TransformSortRows(TextBuffer* tbuf, size_t first, size_t last, int flags);
+
+size_t  TransformUniqueRows(TextBuffer* tbuf, size_t first, size_t last);
+
+void    TransformReverseRows(TextBuffer* tbuf, size_t first, size_t last);
+
+size_t  TransformDeleteRows(TextBuffer* tbuf, size_t first, size_t last, const char* query, bool isMatching);
+
+#endif // TRANSFORM_H
@@ -0,0 +1,16 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include "dependencies.h"
+
+/******* UTF-8 decoding and display width ********/
+
+#define UTF8_REPLACEMENT_CHARACTER 0xFFFD
+
+size_t  Utf8Decode(const char* text, size_t size, unsigned int* codepoint);
+
+bool    Utf8IsContinuation(char byte);
+
+int     Utf8CharWidth(unsigned int codepoint);
+
+#endif // UTF8_H
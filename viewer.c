@@ -0,0 +1,439 @@
+#include "viewer.h"
+
+/******* index cache ********/
+
+static uint64_t viewerFingerprint(FileViewer* viewer, off_t size)
+{
+    off_t start = (size > CACHE_FINGERPRINT_SIZE) ? size - CACHE_FINGERPRINT_SIZE : 0;
+    ssize_t readSize = pread(viewer->file, viewer->readBuffer, size - start, start);
+
+    return CacheFingerprint(viewer->readBuffer, (readSize > 0) ? readSize : 0, CACHE_FINGERPRINT_INIT);
+}
+
+static void viewerLoadCache(FileViewer* viewer, struct stat* info)
+{
+    IndexCache cache = INDEX_CACHE_INIT;
+    if (viewer->cachePath == NULL || CacheOpen(&cache, viewer->cachePath, viewer->path) == -1)
+        return;
+
+    // an unchanged file is taken whole, a grown one only if the bytes indexed last time still end the same way
+    CacheHeader* header = cache.header;
+    bool isSameFile = header->stride == VIEWER_INDEX_STRIDE && header->device == (uint64_t)info->st_dev && header->inode == (uint64_t)info->st_ino;
+    bool isUnchanged = isSameFile && header->fileSize == (uint64_t)info->st_size &&
+                       header->modifiedSeconds == info->st_mtim.tv_sec && header->modifiedNanoseconds == info->st_mtim.tv_nsec;
+    bool isAppended = isSameFile && header->fileSize < (uint64_t)info->st_size &&
+                      viewerFingerprint(viewer, header->fileSize) == header->fingerprint;
+
+    if (isUnchanged || isAppended)
+    {
+        while (viewer->checkpointCapacity < header->numberofCheckpoints)
+            viewer->checkpointCapacity *= 2;
+
+        off_t* temp = realloc(viewer->checkpoints, sizeof(off_t) * viewer->checkpointCapacity);
+        if (temp == NULL)
+            die("realloc");
+        viewer->checkpoints = temp;
+
+        bool* states = realloc(viewer->commentStates, sizeof(bool) * viewer->checkpointCapacity);
+        if (states == NULL)
+            die("realloc");
+        viewer->commentStates = states;
+
+        memcpy(viewer->checkpoints, cache.checkpoints, sizeof(off_t) * header->numberofCheckpoints);
+        memcpy(viewer->commentStates, cache.states, sizeof(bool) * header->numberofStates);
+
+        viewer->numberofCheckpoints = header->numberofCheckpoints;
+        viewer->numberofStates = header->numberofStates;
+        viewer->stateSyntax = header->stateSyntax;
+        viewer->numberofLines = header->numberofLines;
+        viewer->lineOpen = header->lineOpen;
+        viewer->fileSize = header->fileSize;
+        viewer->cachedSize = viewer->fileSize;
+        viewer->cachedStates = viewer->numberofStates;
+    }
+
+    CacheClose(&cache);
+}
+
+static void viewerSaveCache(FileViewer* viewer)
+{
+    if (viewer->cachePath == NULL || viewer->fileSize == 0 ||
+        (viewer->fileSize == viewer->cachedSize && viewer->numberofStates <= viewer->cachedStates))
+        return;
+
+    struct stat info;
+    if (fstat(viewer->file, &info) == -1)
+        return;
+
+    // a file that moved on since it was indexed gets no modification time, the next open checks its tail instead
+    bool isCurrent = (info.st_size == viewer->fileSize);
+
+    CacheHeader header = { 0 };
+    header.stride = VIEWER_INDEX_STRIDE;
+    header.device = info.st_dev;
+    header.inode = info.st_ino;
+    header.fileSize = viewer->fileSize;
+    header.modifiedSeconds = isCurrent ? info.st_mtim.tv_sec : 0;
+    header.modifiedNanoseconds = isCurrent ? info.st_mtim.tv_nsec : -1;
+    header.fingerprint = viewerFingerprint(viewer, viewer->fileSize);
+    header.numberofLines = viewer->numberofLines;
+    header.numberofCheckpoints = viewer->numberofCheckpoints;
+    header.numberofStates = viewer->numberofStates;
+    header.stateSyntax = viewer->stateSyntax;
+    header.lineOpen = viewer->lineOpen;
+
+    if (CacheWrite(viewer->cachePath, &header, viewer->path, viewer->checkpoints, viewer->commentStates) == 0)
+    {
+        viewer->cachedSize = viewer->fileSize;
+        viewer->cachedStates = viewer->numberofStates;
+    }
+}
+
+/******* line index ********/
+
+bool    ViewerIsActive(FileViewer* viewer)
+{
+    return viewer->file != -1;
+}
+
+int     ViewerOpen(FileViewer* viewer, const char* filename)
+{
+    int file = open(filename, O_RDONLY);
+    if (file == -1)
+        return -1;
+
+    struct stat info;
+    if (fstat(file, &info) == -1)
+    {
+        close(file);
+        return -1;
+    }
+
+    viewer->file = file;
+    viewer->fileSize = 0;
+    viewer->firstLine = 0;
+    viewer->numberofLines = 0;
+    viewer->lineOpen = false;
+    viewer->checkpointCapacity = 64;
+
+    viewer->readBuffer = malloc(VIEWER_READ_CHUNK);
+    if (viewer->readBuffer == NULL)
+        die("malloc");
+
+    viewer->checkpoints = malloc(sizeof(off_t) * viewer->checkpointCapacity);
+    if (viewer->checkpoints == NULL)
+        die("malloc");
+
+    viewer->commentStates = malloc(sizeof(bool) * viewer->checkpointCapacity);
+    if (viewer->commentStates == NULL)
+        die("malloc");
+
+    viewer->checkpoints[0] = 0;
+    viewer->numberofCheckpoints = 1;
+    viewer->commentStates[0] = false;
+    viewer->numberofStates = 1;
+    viewer->stateSyntax = 0;
+
+    viewer->path = realpath(filename, NULL);
+    viewer->cachePath = (viewer->path != NULL) ? CacheGetPath(viewer->path) : NULL;
+    viewer->cachedSize = 0;
+    viewer->cachedStates = 1;
+    viewerLoadCache(viewer, &info);
+
+    ssize_t readSize = 0;
+    while (viewer->fileSize < info.st_size && (readSize = pread(file, viewer->readBuffer, VIEWER_READ_CHUNK, viewer->fileSize)) > 0)
+        ViewerIndexChunk(viewer, viewer->readBuffer, readSize);
+
+    if (readSize == -1)
+    {
+        free(viewer->cachePath);
+        viewer->cachePath = NULL;
+        ViewerClose(viewer);
+        return -1;
+    }
+
+    viewerSaveCache(viewer);
+    return 0;
+}
+
+void    ViewerIndexChunk(FileViewer* viewer, const char* data, size_t size)
+{
+    if (size == 0)
+        return;
+
+    if (viewer->lineOpen)
+        viewer->numberofLines--;
+
+    const char* start = data;
+    const char* end = data + size;
+    const char* newline;
+
+    while ((newline = memchr(start, '\n', end - start)) != NULL)
+    {
+        viewer->numberofLines++;
+        if (viewer->numberofLines % VIEWER_INDEX_STRIDE == 0)
+        {
+            if (viewer->numberofCheckpoints == viewer->checkpointCapacity)
+            {
+                viewer->checkpointCapacity *= 2;
+                off_t* temp = realloc(viewer->checkpoints, sizeof(off_t) * viewer->checkpointCapacity);
+                if (temp == NULL)
+                    die("realloc");
+                viewer->checkpoints = temp;
+
+                bool* states = realloc(viewer->commentStates, sizeof(bool) * viewer->checkpointCapacity);
+                if (states == NULL)
+                    die("realloc");
+                viewer->commentStates = states;
+            }
+
+            viewer->checkpoints[viewer->numberofCheckpoints] = viewer->fileSize + (newline - data) + 1;
+            viewer->numberofCheckpoints++;
+        }
+        start = newline + 1;
+    }
+
+    viewer->fileSize += size;
+    viewer->lineOpen = (data[size - 1] != '\n');
+    if (viewer->lineOpen)
+        viewer->numberofLines++;
+}
+
+void    ViewerClose(FileViewer* viewer)
+{
+    if (viewer->file != -1)
+    {
+        viewerSaveCache(viewer);
+        close(viewer->file);
+    }
+
+    free(viewer->checkpoints);
+    free(viewer->commentStates);
+    free(viewer->readBuffer);
+    free(viewer->path);
+    free(viewer->cachePath);
+
+    viewer->file = -1;
+    viewer->checkpoints = NULL;
+    viewer->commentStates = NULL;
+    viewer->readBuffer = NULL;
+    viewer->path = NULL;
+    viewer->cachePath = NULL;
+    viewer->numberofStates = 0;
+    viewer->stateSyntax = 0;
+    viewer->cachedSize = 0;
+    viewer->cachedStates = 0;
+    viewer->numberofCheckpoints = 0;
+    viewer->checkpointCapacity = 0;
+    viewer->numberofLines = 0;
+    viewer->firstLine = 0;
+    viewer->lineOpen = false;
+}
+
+// walks count lines on from position, carrying the comment state through them when one is asked for
+static off_t viewerWalkLines(FileViewer* viewer, off_t position, size_t count, Syntax* syn, bool* inComment)
+{
+    ssize_t readSize;
+    while (count > 0 && (readSize = pread(viewer->file, viewer->readBuffer, VIEWER_READ_CHUNK, position)) > 0)
+    {
+        char* start = viewer->readBuffer;
+        char* end = viewer->readBuffer + readSize;
+        char* newline;
+
+        while (count > 0 && (newline = memchr(start, '\n', end - start)) != NULL)
+        {
+            if (inComment != NULL)
+                *inComment = TextScanCommentState(syn, start, newline - start, *inComment);
+
+            count--;
+            start = newline + 1;
+        }
+
+        // a line cut by the chunk is read again from its start, unless it is longer than the whole chunk
+        if (count == 0 || (inComment != NULL && start > viewer->readBuffer))
+        {
+            position += start - viewer->readBuffer;
+            continue;
+        }
+
+        if (inComment != NULL)
+            *inComment = TextScanCommentState(syn, start, end - start, *inComment);
+
+        position += readSize;
+    }
+
+    return (position > viewer->fileSize) ? viewer->fileSize : position;
+}
+
+// states depend on how comments and quotes are spelled, a syntax without block comments needs none
+static uint64_t viewerSyntaxFingerprint(Syntax* syn)
+{
+    if (syn == NULL || syn->multilineCommentStart == NULL || syn->multilineCommentEnd == NULL ||
+        syn->multilineCommentStart[0] == '\0' || syn->multilineCommentEnd[0] == '\0')
+        return 0;
+
+    uint64_t hash = CACHE_FINGERPRINT_INIT;
+    if (syn->singleLineCommentStarter != NULL)
+        hash = CacheFingerprint(syn->singleLineCommentStarter, strlen(syn->singleLineCommentStarter) + 1, hash);
+
+    hash = CacheFingerprint(syn->multilineCommentStart, strlen(syn->multilineCommentStart) + 1, hash);
+    hash = CacheFingerprint(syn->multilineCommentEnd, strlen(syn->multilineCommentEnd) + 1, hash);
+    return CacheFingerprint((const char*)&syn->flag, sizeof(syn->flag), hash);
+}
+
+static void viewerScanStates(FileViewer* viewer, Syntax* syn, uint64_t stateSyntax, size_t checkpoint)
+{
+    if (viewer->stateSyntax != stateSyntax)
+    {
+        viewer->stateSyntax = stateSyntax;
+        viewer->numberofStates = 1;
+        viewer->cachedStates = 0;
+    }
+
+    // each checkpoint's state is the one before it carried through a stride of lines, so they only ever grow
+    for (; viewer->numberofStates <= checkpoint; viewer->numberofStates++)
+    {
+        size_t previous = viewer->numberofStates - 1;
+        bool inComment = viewer->commentStates[previous];
+
+        viewerWalkLines(viewer, viewer->checkpoints[previous], VIEWER_INDEX_STRIDE, syn, &inComment);
+        viewer->commentStates[previous + 1] = inComment;
+    }
+}
+
+static off_t viewerSeekLine(FileViewer* viewer, size_t line, Syntax* syn, bool* inComment)
+{
+    size_t checkpoint = line / VIEWER_INDEX_STRIDE;
+    if (checkpoint >= viewer->numberofCheckpoints)
+        checkpoint = viewer->numberofCheckpoints - 1;
+
+    uint64_t stateSyntax = viewerSyntaxFingerprint(syn);
+    if (inComment != NULL && stateSyntax != 0)
+    {
+        viewerScanStates(viewer, syn, stateSyntax, checkpoint);
+        *inComment = viewer->commentStates[checkpoint];
+    }
+    else
+    {
+        inComment = NULL;
+    }
+
+    return viewerWalkLines(viewer, viewer->checkpoints[checkpoint], line - checkpoint * VIEWER_INDEX_STRIDE, syn, inComment);
+}
+
+off_t   ViewerGetLineOffset(FileViewer* viewer, size_t line)
+{
+    return viewerSeekLine(viewer, line, NULL, NULL);
+}
+
+/******* window paging ********/
+
+void    ViewerLoadWindow(FileViewer* viewer, TextBuffer* tbuf, size_t firstLine)
+{
+    TextBufferFree(tbuf);
+
+    if (firstLine > viewer->numberofLines)
+        firstLine = viewer->numberofLines;
+
+    viewer->firstLine = firstLine;
+
+    bool inComment = false;
+    off_t position = viewerSeekLine(viewer, firstLine, tbuf->syntax, &inComment);
+    size_t loadedBytes = 0;
+
+    char* line = NULL;
+    size_t lineSize = 0;
+    size_t lineCapacity = 0;
+    bool lineStarted = false;
+
+    ssize_t readSize;
+    while (tbuf->numberofTextRows < VIEWER_WINDOW_LINES && loadedBytes < VIEWER_MEMORY_BUDGET &&
+           (readSize = pread(viewer->file, viewer->readBuffer, VIEWER_READ_CHUNK, position)) > 0)
+    {
+        char* start = viewer->readBuffer;
+        char* end = viewer->readBuffer + readSize;
+
+        while (start < end && tbuf->numberofTextRows < VIEWER_WINDOW_LINES && loadedBytes < VIEWER_MEMORY_BUDGET)
+        {
+            char* newline = memchr(start, '\n', end - start);
+            size_t length = (newline != NULL) ? (size_t)(newline - start) : (size_t)(end - start);
+
+            if (lineSize + length > VIEWER_MEMORY_BUDGET)
+                length = (lineSize < VIEWER_MEMORY_BUDGET) ? VIEWER_MEMORY_BUDGET - lineSize : 0;
+
+            if (lineSize + length > lineCapacity)
+            {
+                lineCapacity = (lineSize + length) * 2;
+                char* temp = realloc(line, lineCapacity);
+                if (temp == NULL)
+                    die("realloc");
+                line = temp;
+            }
+
+            memcpy(&line[lineSize], start, length);
+            lineSize += length;
+            lineStarted = true;
+
+            if (newline == NULL)
+            {
+                start = end;
+                break;
+            }
+
+            while (lineSize > 0 && line[lineSize - 1] == '\r')
+                lineSize--;
+
+            TextBufferInsertTextRow(tbuf, tbuf->numberofTextRows, line, lineSize);
+            loadedBytes += lineSize;
+            lineSize = 0;
+            lineStarted = false;
+            start = newline + 1;
+        }
+
+        position += start - viewer->readBuffer;
+    }
+
+    if (lineStarted && tbuf->numberofTextRows < VIEWER_WINDOW_LINES && loadedBytes < VIEWER_MEMORY_BUDGET)
+        TextBufferInsertTextRow(tbuf, tbuf->numberofTextRows, line, lineSize);
+
+    free(line);
+
+    // a block comment opened above the window carries into its first row
+    if (tbuf->numberofTextRows > 0)
+    {
+        tbuf->textRow[0].incomingComment = inComment;
+        TextBufferUpdateSyntax(tbuf, 0);
+    }
+}
+
+bool    ViewerSyncWindow(FileViewer* viewer, TextBuffer* tbuf, size_t* cursorY, size_t* rowOffset, size_t margin)
+{
+    if (!ViewerIsActive(viewer))
+        return false;
+
+    size_t windowEnd = viewer->firstLine + tbuf->numberofTextRows;
+    bool nearTop = viewer->firstLine > 0 && *cursorY < margin;
+    bool nearBottom = windowEnd < viewer->numberofLines && *cursorY + margin >= tbuf->numberofTextRows;
+
+    if (!nearTop && !nearBottom)
+        return false;
+
+    size_t absoluteCursor = viewer->firstLine + *cursorY;
+    size_t absoluteOffset = viewer->firstLine + *rowOffset;
+
+    size_t firstLine = (absoluteCursor > VIEWER_WINDOW_LINES / 2) ? absoluteCursor - VIEWER_WINDOW_LINES / 2 : 0;
+    ViewerLoadWindow(viewer, tbuf, firstLine);
+
+    if (absoluteCursor >= viewer->firstLine + tbuf->numberofTextRows && absoluteCursor < viewer->numberofLines)
+    {
+        firstLine = (absoluteCursor > margin) ? absoluteCursor - margin : 0;
+        ViewerLoadWindow(viewer, tbuf, firstLine);
+
+        if (absoluteCursor >= viewer->firstLine + tbuf->numberofTextRows)
+            ViewerLoadWindow(viewer, tbuf, absoluteCursor);
+    }
+
+    *cursorY = absoluteCursor - viewer->firstLine;
+    *rowOffset = (absoluteOffset > viewer->firstLine) ? absoluteOffset - viewer->firstLine : 0;
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef VIEWER_H
+#define VIEWER_H
+
+#include "buffer.h"
+#include "cache.h"
+
+/******* read-only windowed view of files too large to load ********/
+
+#define VIEWER_SIZE_THRESHOLD    (256L * 1024 * 1024)
+#define VIEWER_INDEX_STRIDE      1024
+#define VIEWER_WINDOW_LINES      4096
+#define VIEWER_MEMORY_BUDGET     (16L * 1024 * 1024)
+#define VIEWER_READ_CHUNK        (1024 * 1024)
+
+typedef struct
+{
+    int       file;
+    off_t     fileSize;
+    off_t*    checkpoints;
+    size_t    numberofCheckpoints;
+    size_t    checkpointCapacity;
+    size_t    numberofLines;
+    size_t    firstLine;
+    char*     readBuffer;
+    bool      lineOpen;
+    bool*     commentStates;
+    size_t    numberofStates;
+    uint64_t  stateSyntax;
+    char*     path;
+    char*     cachePath;
+    off_t     cachedSize;
+    size_t    cachedStates;
+
+} FileViewer;
+
+#define FILE_VIEWER_INIT { -1, 0, NULL, 0, 0, 0, 0, NULL, false, NULL, 0, 0, NULL, NULL, 0, 0 }
+
+bool    ViewerIsActive(FileViewer* viewer);
+
+int     ViewerOpen(FileViewer* viewer, const char* filename);
+
+void    ViewerClose(FileViewer* viewer);
+
+void    ViewerIndexChunk(FileViewer* viewer, const char* data, size_t size);
+
+off_t   ViewerGetLineOffset(FileViewer* viewer, size_t line);
+
+void    ViewerLoadWindow(FileViewer* viewer, TextBuffer* tbuf, size_t firstLine);
+
+bool    ViewerSyncWindow(FileViewer* viewer, TextBuffer* tbuf, size_t* cursorY, size_t* rowOffset, size_t margin);
+
+#endif // VIEWER_H
@@ -0,0 +1,232 @@
+#include "wrap.h"
+
+/******* laying out one row over visual lines ********/
+
+// walks the row until the character at column or the start of line, a character that would cross the edge opens the next line
+static size_t wrapLayout(TextRow* row, size_t width, size_t column, size_t line, size_t* lineStart)
+{
+    TextRowEnsureRender(row);
+
+    size_t current = 0, start = 0, x = 0, index = 0;
+    while (current < line)
+    {
+        // past the end the cursor still takes a column of its own
+        size_t charLength = 1, charWidth = 1;
+        if (index < row->renderSize)
+        {
+            unsigned int codepoint;
+            charLength = Utf8Decode(&row->render[index], row->renderSize - index, &codepoint);
+            charWidth = (charLength == 1) ? 1 : Utf8CharWidth(codepoint);
+        }
+
+        if (x + charWidth > start + width && x > start)
+        {
+            current++;
+            start = x;
+            continue;
+        }
+
+        if (x >= column || index >= row->renderSize)
+            break;
+
+        x += charWidth;
+        index += charLength;
+    }
+
+    *lineStart = start;
+    return current;
+}
+
+size_t  WrapIndexRowLines(TextRow* row, size_t width)
+{
+    // rows of single byte characters never need to move one to the next line
+    if (row->render != NULL && row->renderSize == row->renderWidth)
+        return row->renderWidth / width + 1;
+
+    size_t start;
+    return wrapLayout(row, width, SIZE_MAX, SIZE_MAX, &start) + 1;
+}
+
+size_t  WrapIndexLineStart(TextRow* row, size_t width, size_t line)
+{
+    if (row->render != NULL && row->renderSize == row->renderWidth)
+        return ((line < row->renderWidth / width) ? line : row->renderWidth / width) * width;
+
+    size_t start;
+    wrapLayout(row, width, SIZE_MAX, line, &start);
+    return start;
+}
+
+size_t  WrapIndexLocate(TextRow* row, size_t width, size_t column, size_t* x)
+{
+    if (row->render != NULL && row->renderSize == row->renderWidth)
+    {
+        *x = column % width;
+        return column / width;
+    }
+
+    size_t start;
+    size_t line = wrapLayout(row, width, column, SIZE_MAX, &start);
+    *x = column - start;
+    return line;
+}
+
+/******* Fenwick tree over the visual line count of each row ********/
+
+void    WrapIndexFree(WrapIndex* wrap)
+{
+    free(wrap->tree);
+    free(wrap->lines);
+    wrap->tree = NULL;
+    wrap->lines = NULL;
+    wrap->numberofRows = 0;
+    wrap->capacity = 0;
+    wrap->isStale = true;
+}
+
+void    WrapIndexInvalidate(WrapIndex* wrap)
+{
+    wrap->isStale = true;
+}
+
+static void wrapReserve(WrapIndex* wrap, size_t numberofRows)
+{
+    if (numberofRows <= wrap->capacity && wrap->tree != NULL)
+        return;
+
+    size_t capacity = (wrap->capacity > 0) ? wrap->capacity : 1024;
+    while (capacity < numberofRows)
+        capacity *= 2;
+
+    size_t* tree = realloc(wrap->tree, sizeof(size_t) * (capacity + 1));
+    size_t* lines = realloc(wrap->lines, sizeof(size_t) * capacity);
+    if (tree == NULL || lines == NULL)
+        die("realloc");
+
+    wrap->tree = tree;
+    wrap->lines = lines;
+    wrap->capacity = capacity;
+}
+
+// rebuilds the tree from row first on, nodes that only cover earlier rows are already right
+static void wrapRebuild(WrapIndex* wrap, size_t first)
+{
+    size_t numberofRows = wrap->numberofRows;
+    wrap->tree[0] = 0;
+    for (size_t i = first + 1; i <= numberofRows; i++)
+        wrap->tree[i] = wrap->lines[i - 1];
+
+    for (size_t i = first; i > 0; i -= i & -i)
+    {
+        size_t parent = i + (i & -i);
+        if (parent <= numberofRows)
+            wrap->tree[parent] += wrap->tree[i];
+    }
+
+    for (size_t i = first + 1; i <= numberofRows; i++)
+    {
+        size_t parent = i + (i & -i);
+        if (parent <= numberofRows)
+            wrap->tree[parent] += wrap->tree[i];
+    }
+}
+
+void    WrapIndexSync(WrapIndex* wrap, TextBuffer* tbuf, size_t width)
+{
+    if (width == 0)
+        width = 1;
+
+    if (!wrap->isStale && wrap->width == width && wrap->numberofRows == tbuf->numberofTextRows)
+        return;
+
+    wrapReserve(wrap, tbuf->numberofTextRows);
+    wrap->numberofRows = tbuf->numberofTextRows;
+    wrap->width = width;
+    wrap->isStale = false;
+
+    for (size_t i = 0; i < wrap->numberofRows; i++)
+        wrap->lines[i] = WrapIndexRowLines(&tbuf->textRow[i], width);
+
+    wrapRebuild(wrap, 0);
+}
+
+void    WrapIndexUpdateRow(WrapIndex* wrap, TextBuffer* tbuf, size_t index)
+{
+    if (wrap->isStale || index >= wrap->numberofRows || index >= tbuf->numberofTextRows)
+        return;
+
+    size_t previous = wrap->lines[index];
+    size_t current = WrapIndexRowLines(&tbuf->textRow[index], wrap->width);
+
+    if (previous == current)
+        return;
+
+    wrap->lines[index] = current;
+    for (size_t i = index + 1; i <= wrap->numberofRows; i += i & -i)
+        wrap->tree[i] += current - previous;
+}
+
+// rows index to index + count are new in tbuf, only the tree past index is rebuilt so appends cost what they add
+void    WrapIndexInsertRows(WrapIndex* wrap, TextBuffer* tbuf, size_t index, size_t count)
+{
+    if (wrap->isStale || index > wrap->numberofRows || wrap->numberofRows + count != tbuf->numberofTextRows)
+    {
+        wrap->isStale = true;
+        return;
+    }
+
+    wrapReserve(wrap, wrap->numberofRows + count);
+    memmove(&wrap->lines[index + count], &wrap->lines[index], sizeof(size_t) * (wrap->numberofRows - index));
+    for (size_t i = 0; i < count; i++)
+        wrap->lines[index + i] = WrapIndexRowLines(&tbuf->textRow[index + i], wrap->width);
+
+    wrap->numberofRows += count;
+    wrapRebuild(wrap, index);
+}
+
+void    WrapIndexDeleteRows(WrapIndex* wrap, size_t index, size_t count)
+{
+    if (wrap->isStale || index + count > wrap->numberofRows)
+    {
+        wrap->isStale = true;
+        return;
+    }
+
+    memmove(&wrap->lines[index], &wrap->lines[index + count], sizeof(size_t) * (wrap->numberofRows - index - count));
+    wrap->numberofRows -= count;
+    wrapRebuild(wrap, index);
+}
+
+size_t  WrapIndexGetLine(WrapIndex* wrap, size_t index)
+{
+    if (index > wrap->numberofRows)
+        index = wrap->numberofRows;
+
+    size_t line = 0;
+    for (size_t i = index; i > 0; i -= i & -i)
+        line += wrap->tree[i];
+
+    return line;
+}
+
+size_t  WrapIndexFindRow(WrapIndex* wrap, size_t line, size_t* lineInRow)
+{
+    size_t step = 1;
+    while (step * 2 <= wrap->numberofRows)
+        step *= 2;
+
+    size_t index = 0;
+    for (; step > 0; step /= 2)
+    {
+        if (index + step <= wrap->numberofRows && wrap->tree[index + step] <= line)
+        {
+            index += step;
+            line -= wrap->tree[index];
+        }
+    }
+
+    if (lineInRow != NULL)
+        *lineInRow = line;
+
+    return index;
+}
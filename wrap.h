@@ -0,0 +1,44 @@
+#ifndef WRAP_H
+#define WRAP_H
+
+#include "buffer.h"
+
+/******* soft wrapping: prefix sums of visual lines per text row ********/
+
+typedef struct
+{
+    size_t*    tree;
+    size_t*    lines;
+    size_t     numberofRows;
+    size_t     capacity;
+    size_t     width;
+    bool       isEnabled;
+    bool       isStale;
+
+} WrapIndex;
+
+#define WRAP_INDEX_INIT { NULL, NULL, 0, 0, 0, false, true }
+
+size_t  WrapIndexRowLines(TextRow* row, size_t width);
+
+size_t  WrapIndexLineStart(TextRow* row, size_t width, size_t line);
+
+size_t  WrapIndexLocate(TextRow* row, size_t width, size_t column, size_t* x);
+
+void    WrapIndexFree(WrapIndex* wrap);
+
+void    WrapIndexInvalidate(WrapIndex* wrap);
+
+void    WrapIndexSync(WrapIndex* wrap, TextBuffer* tbuf, size_t width);
+
+void    WrapIndexUpdateRow(WrapIndex* wrap, TextBuffer* tbuf, size_t index);
+
+void    WrapIndexInsertRows(WrapIndex* wrap, TextBuffer* tbuf, size_t index, size_t count);
+
+void    WrapIndexDeleteRows(WrapIndex* wrap, size_t index, size_t count);
+
+size_t  WrapIndexGetLine(WrapIndex* wrap, size_t index);
+
+size_t  WrapIndexFindRow(WrapIndex* wrap, size_t line, size_t* lineInRow);
+
+#endif // WRAP_H